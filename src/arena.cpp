@@ -0,0 +1,53 @@
+#include "arena.h"
+
+#include <cstdint>
+
+using namespace std;
+
+namespace ast {
+
+namespace {
+thread_local Arena* current_arena = nullptr;
+}  // namespace
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    auto aligned = [alignment](std::byte* ptr) {
+        const auto address = reinterpret_cast<uintptr_t>(ptr);
+        return ptr + ((alignment - address % alignment) % alignment);
+    };
+
+    std::byte* result = cursor_ == nullptr ? nullptr : aligned(cursor_);
+    if (result == nullptr || result > end_ || static_cast<size_t>(end_ - result) < size) {
+        // Крупный объект получает собственный блок, чтобы не бросать недоиспользованным текущий
+        const size_t block_size = size > BLOCK_SIZE / 4 ? size : BLOCK_SIZE;
+        // new[] без скобок не обнуляет блок
+        blocks_.emplace_back(new std::byte[block_size]);
+        std::byte* block = blocks_.back().get();
+        if (block_size != BLOCK_SIZE) {
+            // Блок new[] выровнен по max_align_t. Текущий блок остаётся текущим
+            allocated_bytes_ += size;
+            return block;
+        }
+        cursor_ = block;
+        end_ = block + block_size;
+        result = cursor_;
+    }
+    cursor_ = result + size;
+    allocated_bytes_ += size;
+    return result;
+}
+
+Arena* Arena::Current() {
+    return current_arena;
+}
+
+Arena::Scope::Scope(Arena& arena)
+    : previous_(current_arena) {
+    current_arena = &arena;
+}
+
+Arena::Scope::~Scope() {
+    current_arena = previous_;
+}
+
+}  // namespace ast
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace ast {
+
+/*
+ * Арена для узлов синтаксического дерева. Память выделяется сдвигом указателя внутри крупных
+ * блоков, поэтому узлы, созданные подряд, лежат в памяти рядом, а освобождается она целиком
+ * вместе с ареной. Пока существует Arena::Scope, в арене размещаются все создаваемые узлы
+ * (см. Statement::operator new)
+ */
+class Arena {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Выделяет size байт с выравниванием alignment (степень двойки, не больше max_align_t)
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Возвращает число выделенных байт
+    [[nodiscard]] size_t GetAllocatedBytes() const {
+        return allocated_bytes_;
+    }
+
+    // Возвращает число блоков, полученных у системы
+    [[nodiscard]] size_t GetBlockCount() const {
+        return blocks_.size();
+    }
+
+    // Возвращает арену, в которой текущий поток размещает узлы, либо nullptr
+    static Arena* Current();
+
+    // Делает арену текущей для потока на время своего существования
+    class Scope {
+    public:
+        explicit Scope(Arena& arena);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+    private:
+        Arena* previous_;
+    };
+
+private:
+    std::vector<std::unique_ptr<std::byte[]>> blocks_;
+    std::byte* cursor_ = nullptr;
+    std::byte* end_ = nullptr;
+    size_t allocated_bytes_ = 0;
+};
+
+}  // namespace ast
@@ -0,0 +1,82 @@
+#include "bench_runner_p.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<std::size_t> allocated_bytes{0};
+std::atomic<std::size_t> live_bytes{0};
+std::atomic<std::size_t> peak_live_bytes{0};
+
+// Перед каждым блоком хранится его размер, чтобы operator delete мог учесть освобождённую память.
+// Размер заголовка сохраняет выравнивание, которое гарантирует malloc
+constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+void UpdatePeak(std::size_t live) {
+    std::size_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+}  // namespace
+
+std::size_t GetAllocatedBytes() {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+std::size_t GetLiveBytes() {
+    return live_bytes.load(std::memory_order_relaxed);
+}
+
+std::size_t GetPeakLiveBytes() {
+    return peak_live_bytes.load(std::memory_order_relaxed);
+}
+
+void ResetPeakLiveBytes() {
+    peak_live_bytes.store(GetLiveBytes(), std::memory_order_relaxed);
+}
+
+// Подсчитываем выделенную память, чтобы бенчмарки могли сравнивать расход памяти
+void* operator new(std::size_t size) {
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (auto* block = static_cast<unsigned char*>(std::malloc(HEADER_SIZE + size))) {
+        *reinterpret_cast<std::size_t*>(block) = size;
+        UpdatePeak(live_bytes.fetch_add(size, std::memory_order_relaxed) + size);
+        return block + HEADER_SIZE;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto* block = static_cast<unsigned char*>(ptr) - HEADER_SIZE;
+    live_bytes.fetch_sub(*reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace ast {
+void RunBenchmarks(BenchRunner& br);
+}  // namespace ast
+
+namespace parse {
+void RunBenchmarks(BenchRunner& br);
+}  // namespace parse
+
+namespace runtime {
+void RunBenchmarks(BenchRunner& br);
+}  // namespace runtime
+
+int main() {
+    BenchRunner br;
+    parse::RunBenchmarks(br);
+    runtime::RunBenchmarks(br);
+    ast::RunBenchmarks(br);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Не даёт компилятору выбросить вычисление value как неиспользуемое: адрес value уходит
+// в пустую ассемблерную вставку, которая может прочитать любую память
+template <class T>
+void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    // Запись в volatile-указатель компилятор выбросить не может
+    static const void* volatile sink;
+    sink = &value;
+#endif
+}
+
+// Возвращает суммарный объём памяти, выделенной через operator new с начала работы программы
+std::size_t GetAllocatedBytes();
+
+// Возвращает число байт, выделенных при вызове func
+template <class Func>
+std::size_t MeasureAllocatedBytes(Func func) {
+    const std::size_t before = GetAllocatedBytes();
+    func();
+    return GetAllocatedBytes() - before;
+}
+
+// Возвращает объём памяти, выделенной через operator new и ещё не освобождённой
+std::size_t GetLiveBytes();
+// Возвращает наибольший объём неосвобождённой памяти с момента вызова ResetPeakLiveBytes
+std::size_t GetPeakLiveBytes();
+void ResetPeakLiveBytes();
+
+// Возвращает, на сколько байт расход памяти во время вызова func превышал расход до него
+template <class Func>
+std::size_t MeasurePeakBytes(Func func) {
+    const std::size_t before = GetLiveBytes();
+    ResetPeakLiveBytes();
+    func();
+    return GetPeakLiveBytes() - before;
+}
+
+class BenchRunner {
+public:
+    // Выполняет func iterations раз и выводит среднее время одной итерации
+    template <class Func>
+    double Run(const std::string& name, std::size_t iterations, Func func) {
+        using namespace std::chrono;
+
+        // Прогрев: первые вызовы заполняют кэши и выделяют память
+        for (std::size_t i = 0; i < iterations / 10 + 1; ++i) {
+            func();
+        }
+
+        const auto start = steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i) {
+            func();
+        }
+        const auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start);
+
+        const double ns_per_op = static_cast<double>(elapsed.count()) / iterations;
+        std::cout << std::left << std::setw(64) << name << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(12) << ns_per_op << " ns/op" << std::endl;
+        return ns_per_op;
+    }
+};
+
+#define RUN_BENCH(br, func) \
+    std::cout << "== " #func << std::endl; \
+    func(br)
@@ -0,0 +1,123 @@
+#include "bytecode.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+
+namespace bytecode {
+
+int GetStackEffect(OpCode op, int count) {
+    switch (op) {
+        case OpCode::LoadConst:
+        case OpCode::LoadNone:
+        case OpCode::LoadLocal:
+        case OpCode::LoadLocalChecked:
+            return 1;
+        case OpCode::LoadField:
+        case OpCode::Not:
+        case OpCode::ToBool:
+        case OpCode::Jump:
+        case OpCode::Stringify:
+        case OpCode::PrintNewline:
+            return 0;
+        case OpCode::StoreField:
+        case OpCode::CompareJumpIfFalse:
+        case OpCode::CompareJumpIfTrue:
+            return -2;
+        case OpCode::CallMethod:
+            return -count;
+        case OpCode::NewInstance:
+            return 1 - count;
+        default:
+            // Бинарные операции, переходы по условию, StoreLocal, Pop, Print и Return
+            return -1;
+    }
+}
+
+const char* GetOpCodeName(OpCode op) {
+    switch (op) {
+        case OpCode::LoadConst: return "LoadConst";
+        case OpCode::LoadNone: return "LoadNone";
+        case OpCode::LoadLocal: return "LoadLocal";
+        case OpCode::LoadLocalChecked: return "LoadLocalChecked";
+        case OpCode::StoreLocal: return "StoreLocal";
+        case OpCode::LoadField: return "LoadField";
+        case OpCode::StoreField: return "StoreField";
+        case OpCode::Add: return "Add";
+        case OpCode::Sub: return "Sub";
+        case OpCode::Mult: return "Mult";
+        case OpCode::Div: return "Div";
+        case OpCode::Equal: return "Equal";
+        case OpCode::NotEqual: return "NotEqual";
+        case OpCode::Less: return "Less";
+        case OpCode::Greater: return "Greater";
+        case OpCode::LessOrEqual: return "LessOrEqual";
+        case OpCode::GreaterOrEqual: return "GreaterOrEqual";
+        case OpCode::Not: return "Not";
+        case OpCode::ToBool: return "ToBool";
+        case OpCode::Jump: return "Jump";
+        case OpCode::JumpIfFalse: return "JumpIfFalse";
+        case OpCode::JumpIfTrue: return "JumpIfTrue";
+        case OpCode::JumpIfTrueOrPop: return "JumpIfTrueOrPop";
+        case OpCode::JumpIfFalseOrPop: return "JumpIfFalseOrPop";
+        case OpCode::CompareJumpIfFalse: return "CompareJumpIfFalse";
+        case OpCode::CompareJumpIfTrue: return "CompareJumpIfTrue";
+        case OpCode::Pop: return "Pop";
+        case OpCode::Print: return "Print";
+        case OpCode::PrintNewline: return "PrintNewline";
+        case OpCode::CallMethod: return "CallMethod";
+        case OpCode::NewInstance: return "NewInstance";
+        case OpCode::Stringify: return "Stringify";
+        case OpCode::Return: return "Return";
+    }
+    return "Unknown";
+}
+
+void Disassemble(ostream& os, const Code& code) {
+    for (size_t i = 0; i < code.instructions.size(); ++i) {
+        const Instruction& instr = code.instructions[i];
+        os << setw(4) << i << ' ' << GetOpCodeName(instr.op);
+
+        switch (instr.op) {
+            case OpCode::LoadLocal:
+            case OpCode::LoadLocalChecked:
+            case OpCode::StoreLocal:
+                os << ' ' << code.locals[instr.arg];
+                break;
+            case OpCode::LoadField:
+            case OpCode::StoreField:
+                os << ' ' << code.names[instr.arg];
+                break;
+            case OpCode::CallMethod:
+                os << ' ' << code.names[instr.arg] << '/' << static_cast<int>(instr.count);
+                break;
+            case OpCode::LoadConst:
+            case OpCode::NewInstance:
+                os << " #" << instr.arg;
+                if (instr.op == OpCode::NewInstance) {
+                    os << '/' << static_cast<int>(instr.count);
+                }
+                break;
+            case OpCode::Jump:
+            case OpCode::JumpIfFalse:
+            case OpCode::JumpIfTrue:
+            case OpCode::JumpIfTrueOrPop:
+            case OpCode::JumpIfFalseOrPop:
+                os << " -> " << instr.arg;
+                break;
+            case OpCode::CompareJumpIfFalse:
+            case OpCode::CompareJumpIfTrue:
+                os << ' ' << GetOpCodeName(static_cast<OpCode>(instr.count)) << " -> " << instr.arg;
+                break;
+            case OpCode::Print:
+                os << ' ' << static_cast<int>(instr.count);
+                break;
+            default:
+                break;
+        }
+        os << '\n';
+    }
+}
+
+}  // namespace bytecode
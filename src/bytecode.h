@@ -0,0 +1,106 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bytecode {
+
+// Коды инструкций виртуальной машины Mython.
+// Машина стековая: операнды снимаются с вершины стека, результат кладётся на вершину
+enum class OpCode : std::uint8_t {
+    LoadConst,       // кладёт на стек константу constants[arg]
+    LoadNone,        // кладёт на стек None
+    LoadLocal,       // кладёт на стек значение локальной переменной в слоте arg
+    LoadLocalChecked,// то же, но проверяет, что переменной было присвоено значение
+    StoreLocal,      // снимает значение и записывает его в слот arg
+    LoadField,       // снимает объект и кладёт значение его поля names[arg]
+    StoreField,      // снимает объект и значение, присваивает полю объекта names[arg]
+    Add,
+    Sub,
+    Mult,
+    Div,
+    Equal,
+    NotEqual,
+    Less,
+    Greater,
+    LessOrEqual,
+    GreaterOrEqual,
+    Not,             // снимает значение и кладёт Bool с противоположным значением
+    ToBool,          // заменяет вершину стека на Bool с её логическим значением
+    Jump,            // переходит к инструкции arg
+    JumpIfFalse,     // снимает значение и переходит к инструкции arg, если оно ложно
+    JumpIfTrue,      // снимает значение и переходит к инструкции arg, если оно истинно
+    JumpIfTrueOrPop, // если вершина истинна, переходит к arg, иначе снимает её
+    JumpIfFalseOrPop,// если вершина ложна, переходит к arg, иначе снимает её
+    // Снимают два значения, сравнивают их операцией count (от Equal до GreaterOrEqual)
+    // и переходят к arg, если результат ложен (истинен). Bool для результата не создаётся
+    CompareJumpIfFalse,
+    CompareJumpIfTrue,
+    Pop,             // снимает значение с вершины стека
+    Print,           // снимает и выводит аргумент print, а если count не 0 - и пробел после него
+    PrintNewline,    // завершает строку, выведенную print
+    CallMethod,      // снимает count аргументов и объект, вызывает метод names[arg]
+    NewInstance,     // снимает count аргументов и создаёт экземпляр класса constants[arg]
+    Stringify,       // заменяет вершину стека на результат str()
+    Return,          // снимает значение и завершает выполнение кода
+};
+
+// Инструкция: код операции, счётчик (аргументы вызова, пробел после значения print) либо операция сравнения
+// (CompareJumpIfFalse, CompareJumpIfTrue), номер кэша и операнд
+struct Instruction {
+    OpCode op;
+    std::uint8_t count = 0;
+    // Номер кэша места обращения к полю (LoadField, StoreField) или вызова метода (CallMethod, NewInstance)
+    std::uint16_t cache = 0;
+    std::uint32_t arg = 0;
+};
+
+// Скомпилированный фрагмент программы: тело метода либо код верхнего уровня
+struct Code {
+    std::vector<Instruction> instructions;
+    std::vector<runtime::ObjectHolder> constants;
+    // Имена полей и методов, к которым код обращается динамически
+    std::vector<runtime::Symbol> names;
+    // Имена локальных переменных по номерам слотов. В методах слот 0 занимает self
+    std::vector<runtime::Symbol> locals;
+    // Слоты формальных параметров метода в порядке их объявления
+    std::vector<std::uint32_t> param_slots;
+    // Слоты, которые читаются инструкцией LoadLocalChecked. Если код содержит print, сюда входят
+    // все слоты: print выводит значение переменной, имя которой совпадает с выводимой строкой
+    std::vector<std::uint32_t> checked_locals;
+    // Максимальная глубина стека, которой достигает код
+    std::size_t max_stack = 0;
+    // Число кэшей мест обращения к полям и вызова методов. Сами кэши изменяются при выполнении,
+    // поэтому хранятся не в коде, а в состоянии выполнения (см. vm::ExecutionState)
+    std::size_t field_cache_count = 0;
+    std::size_t method_cache_count = 0;
+    // Номер кода в программе, по которому состояние выполнения находит его кэши
+    std::uint32_t id = 0;
+};
+
+// Программа, готовая к выполнению на виртуальной машине.
+// Владеет скомпилированными классами, на которые ссылаются константы кода.
+// Выполнение не изменяет программу, поэтому её можно выполнять одновременно в нескольких потоках
+struct Program {
+    std::vector<runtime::ObjectHolder> classes;
+    Code main;
+    // Число фрагментов кода программы: код верхнего уровня и тела методов.
+    // Их номера (Code::id) идут подряд от 0
+    std::uint32_t code_count = 0;
+};
+
+// Возвращает изменение глубины стека после выполнения инструкции op со счётчиком count
+int GetStackEffect(OpCode op, int count);
+
+// Возвращает имя кода операции
+const char* GetOpCodeName(OpCode op);
+
+// Выводит код в человекочитаемом виде, по одной инструкции в строке
+void Disassemble(std::ostream& os, const Code& code);
+
+}  // namespace bytecode
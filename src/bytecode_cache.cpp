@@ -0,0 +1,638 @@
+#include "bytecode_cache.h"
+
+#include "mapped_file.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <random>
+#include <unordered_map>
+
+using namespace std;
+
+namespace bytecode {
+
+using runtime::ObjectHolder;
+
+namespace {
+
+constexpr string_view CACHE_MAGIC = "MYTHONBC"sv;
+
+// Вид константы в кэше
+enum class ConstantTag : uint8_t {
+    None,
+    Number,
+    String,
+    Bool,
+    // Номер класса программы
+    Class,
+};
+
+class Writer {
+public:
+    void WriteU8(uint8_t value) {
+        data_.push_back(static_cast<char>(value));
+    }
+
+    void WriteU16(uint16_t value) {
+        WriteLittleEndian(value, 2);
+    }
+
+    void WriteU32(uint32_t value) {
+        WriteLittleEndian(value, 4);
+    }
+
+    void WriteU64(uint64_t value) {
+        WriteLittleEndian(value, 8);
+    }
+
+    void WriteSize(size_t value) {
+        if (value > numeric_limits<uint32_t>::max()) {
+            throw CacheError("Program is too large to be cached"s);
+        }
+        WriteU32(static_cast<uint32_t>(value));
+    }
+
+    void WriteString(string_view value) {
+        WriteSize(value.size());
+        data_.append(value);
+    }
+
+    void WriteBytes(string_view bytes) {
+        data_.append(bytes);
+    }
+
+    void WriteU32s(const vector<uint32_t>& values) {
+        WriteSize(values.size());
+        for (uint32_t value : values) {
+            WriteU32(value);
+        }
+    }
+
+    const string& GetData() const {
+        return data_;
+    }
+
+private:
+    void WriteLittleEndian(uint64_t value, int byte_count) {
+        for (int i = 0; i < byte_count; ++i) {
+            data_.push_back(static_cast<char>((value >> (8 * i)) & 0xFFu));
+        }
+    }
+
+    string data_;
+};
+
+class Reader {
+public:
+    explicit Reader(string_view data)
+        : data_(data) {
+    }
+
+    uint8_t ReadU8() {
+        return static_cast<uint8_t>(ReadLittleEndian(1));
+    }
+
+    uint16_t ReadU16() {
+        return static_cast<uint16_t>(ReadLittleEndian(2));
+    }
+
+    uint32_t ReadU32() {
+        return static_cast<uint32_t>(ReadLittleEndian(4));
+    }
+
+    uint64_t ReadU64() {
+        return ReadLittleEndian(8);
+    }
+
+    // Читает число элементов, каждый из которых занимает в данных не меньше min_item_size байт.
+    // Проверка не даёт повреждённому счётчику заставить загрузчик резервировать гигабайты
+    size_t ReadCount(size_t min_item_size) {
+        const size_t count = ReadU32();
+        if (count > Remaining() / min_item_size) {
+            throw CacheError("Bytecode cache is truncated"s);
+        }
+        return count;
+    }
+
+    string_view ReadBytes(size_t size) {
+        if (size > Remaining()) {
+            throw CacheError("Bytecode cache is truncated"s);
+        }
+        string_view result = data_.substr(pos_, size);
+        pos_ += size;
+        return result;
+    }
+
+    string_view ReadString() {
+        return ReadBytes(ReadU32());
+    }
+
+    vector<uint32_t> ReadU32s() {
+        vector<uint32_t> values(ReadCount(4));
+        for (uint32_t& value : values) {
+            value = ReadU32();
+        }
+        return values;
+    }
+
+    bool AtEnd() const {
+        return pos_ == data_.size();
+    }
+
+private:
+    size_t Remaining() const {
+        return data_.size() - pos_;
+    }
+
+    uint64_t ReadLittleEndian(size_t byte_count) {
+        const string_view bytes = ReadBytes(byte_count);
+        uint64_t value = 0;
+        for (size_t i = 0; i < byte_count; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    string_view data_;
+    size_t pos_ = 0;
+};
+
+void WriteHeader(Writer& writer, const SourceStamp& source) {
+    for (char ch : CACHE_MAGIC) {
+        writer.WriteU8(static_cast<uint8_t>(ch));
+    }
+    writer.WriteU32(CACHE_FORMAT_VERSION);
+    writer.WriteU64(source.size);
+    writer.WriteU64(static_cast<uint64_t>(source.modified));
+}
+
+void ReadHeader(Reader& reader, const SourceStamp& source) {
+    if (reader.ReadBytes(CACHE_MAGIC.size()) != CACHE_MAGIC) {
+        throw CacheError("File is not a Mython bytecode cache"s);
+    }
+    if (const uint32_t version = reader.ReadU32(); version != CACHE_FORMAT_VERSION) {
+        throw CacheError("Bytecode cache has format version "s + to_string(version) + ", expected "s
+                         + to_string(CACHE_FORMAT_VERSION));
+    }
+    SourceStamp stamp;
+    stamp.size = reader.ReadU64();
+    stamp.modified = static_cast<int64_t>(reader.ReadU64());
+    if (stamp != source) {
+        throw CacheError("Bytecode cache was compiled from another version of the program"s);
+    }
+}
+
+/*
+ * Имена полей, методов и переменных записываются номерами в таблице символов, которая
+ * предшествует классам и коду. Так загрузчик регистрирует каждое имя один раз, а не при
+ * каждом его упоминании
+ */
+class ProgramWriter {
+public:
+    explicit ProgramWriter(const Program& program) {
+        for (size_t i = 0; i < program.classes.size(); ++i) {
+            class_indices_[program.classes[i].TryAs<runtime::Class>()] = static_cast<uint32_t>(i);
+        }
+    }
+
+    void Write(Writer& output, const Program& program) {
+        writer_.WriteSize(program.classes.size());
+        for (const ObjectHolder& holder : program.classes) {
+            WriteClass(*holder.TryAs<runtime::Class>());
+        }
+        WriteCode(program.main);
+
+        output.WriteSize(symbols_.size());
+        for (runtime::Symbol symbol : symbols_) {
+            output.WriteString(symbol.GetName());
+        }
+        output.WriteBytes(writer_.GetData());
+    }
+
+private:
+    void WriteSymbol(runtime::Symbol symbol) {
+        auto [it, inserted] = symbol_indices_.emplace(symbol, static_cast<uint32_t>(symbols_.size()));
+        if (inserted) {
+            symbols_.push_back(symbol);
+        }
+        writer_.WriteU32(it->second);
+    }
+
+    void WriteSymbols(const vector<runtime::Symbol>& symbols) {
+        writer_.WriteSize(symbols.size());
+        for (runtime::Symbol symbol : symbols) {
+            WriteSymbol(symbol);
+        }
+    }
+
+    void WriteClass(const runtime::Class& cls) {
+        writer_.WriteString(cls.GetName());
+        // Номер родителя на единицу больше его индекса, 0 означает отсутствие родителя
+        writer_.WriteU32(cls.GetParent() == nullptr ? 0 : GetClassIndex(*cls.GetParent()) + 1);
+        writer_.WriteSize(cls.GetMethods().size());
+        for (const runtime::Method& method : cls.GetMethods()) {
+            const auto* function = dynamic_cast<const vm::Function*>(method.body.get());
+            if (function == nullptr) {
+                throw CacheError("Method "s + method.name.GetName() + " is not compiled to bytecode"s);
+            }
+            WriteSymbol(method.name);
+            WriteSymbols(method.formal_params);
+            WriteCode(function->GetCode());
+        }
+    }
+
+    void WriteCode(const Code& code) {
+        writer_.WriteSize(code.instructions.size());
+        for (const Instruction& instr : code.instructions) {
+            writer_.WriteU8(static_cast<uint8_t>(instr.op));
+            writer_.WriteU8(instr.count);
+            writer_.WriteU16(instr.cache);
+            writer_.WriteU32(instr.arg);
+        }
+
+        writer_.WriteSize(code.constants.size());
+        for (const ObjectHolder& constant : code.constants) {
+            WriteConstant(constant);
+        }
+        WriteSymbols(code.names);
+        WriteSymbols(code.locals);
+        writer_.WriteU32s(code.param_slots);
+        writer_.WriteU32s(code.checked_locals);
+        writer_.WriteSize(code.field_cache_count);
+        writer_.WriteSize(code.method_cache_count);
+    }
+
+    void WriteConstant(const ObjectHolder& constant) {
+        switch (constant.GetKind()) {
+            case runtime::Kind::None:
+                writer_.WriteU8(static_cast<uint8_t>(ConstantTag::None));
+                break;
+            case runtime::Kind::Number:
+                writer_.WriteU8(static_cast<uint8_t>(ConstantTag::Number));
+                writer_.WriteU32(static_cast<uint32_t>(constant.TryAs<runtime::Number>()->GetValue()));
+                break;
+            case runtime::Kind::String:
+                writer_.WriteU8(static_cast<uint8_t>(ConstantTag::String));
+                writer_.WriteString(constant.TryAs<runtime::String>()->GetValue());
+                break;
+            case runtime::Kind::Bool:
+                writer_.WriteU8(static_cast<uint8_t>(ConstantTag::Bool));
+                writer_.WriteU8(constant.TryAs<runtime::Bool>()->GetValue() ? 1 : 0);
+                break;
+            case runtime::Kind::Class:
+                writer_.WriteU8(static_cast<uint8_t>(ConstantTag::Class));
+                writer_.WriteU32(GetClassIndex(*constant.TryAs<runtime::Class>()));
+                break;
+            default:
+                throw CacheError("Constant of this type can't be cached"s);
+        }
+    }
+
+    uint32_t GetClassIndex(const runtime::Class& cls) const {
+        const auto it = class_indices_.find(&cls);
+        if (it == class_indices_.end()) {
+            throw CacheError("Class "s + cls.GetName() + " does not belong to the program"s);
+        }
+        return it->second;
+    }
+
+    Writer writer_;
+    unordered_map<const runtime::Class*, uint32_t> class_indices_;
+    unordered_map<runtime::Symbol, uint32_t> symbol_indices_;
+    vector<runtime::Symbol> symbols_;
+};
+
+class ProgramReader {
+public:
+    explicit ProgramReader(Reader& reader)
+        : reader_(reader) {
+    }
+
+    Program Read() {
+        symbols_.resize(reader_.ReadCount(4));
+        for (runtime::Symbol& symbol : symbols_) {
+            symbol = runtime::Symbol{reader_.ReadString()};
+        }
+
+        Program program;
+        // Класс может ссылаться на родителя и на классы, записанные раньше него
+        const size_t class_count = reader_.ReadCount(12);
+        program.classes.reserve(class_count);
+        for (size_t i = 0; i < class_count; ++i) {
+            program.classes.push_back(ReadClass(program.classes));
+        }
+        program.main = ReadCode(program.classes);
+        program.code_count = code_count_;
+        return program;
+    }
+
+private:
+    ObjectHolder ReadClass(const vector<ObjectHolder>& classes) {
+        string name(reader_.ReadString());
+        const runtime::Class* parent = nullptr;
+        if (const uint32_t parent_number = reader_.ReadU32(); parent_number != 0) {
+            parent = GetClass(classes, parent_number - 1);
+        }
+
+        vector<runtime::Method> methods(reader_.ReadCount(12));
+        for (runtime::Method& method : methods) {
+            method.name = ReadSymbol();
+            method.formal_params = ReadSymbols();
+            Code code = ReadCode(classes);
+            // Слот 0 метода занимает self, а параметров столько, сколько слотов для них
+            if (code.locals.empty() || code.param_slots.size() != method.formal_params.size()) {
+                throw CacheError("Bytecode cache is corrupted"s);
+            }
+            method.body = make_unique<vm::Function>(std::move(code));
+        }
+        return ObjectHolder::Own(runtime::Class(std::move(name), std::move(methods), parent));
+    }
+
+    Code ReadCode(const vector<ObjectHolder>& classes) {
+        Code code;
+        code.instructions.resize(reader_.ReadCount(8));
+        for (Instruction& instr : code.instructions) {
+            instr.op = static_cast<OpCode>(reader_.ReadU8());
+            instr.count = reader_.ReadU8();
+            instr.cache = reader_.ReadU16();
+            instr.arg = reader_.ReadU32();
+        }
+
+        code.constants.resize(reader_.ReadCount(1));
+        for (ObjectHolder& constant : code.constants) {
+            constant = ReadConstant(classes);
+        }
+        code.names = ReadSymbols();
+        code.locals = ReadSymbols();
+        code.param_slots = reader_.ReadU32s();
+        code.checked_locals = reader_.ReadU32s();
+        code.field_cache_count = ReadCacheCount();
+        code.method_cache_count = ReadCacheCount();
+        code.id = code_count_++;
+
+        Validate(code);
+        return code;
+    }
+
+    runtime::Symbol ReadSymbol() {
+        const uint32_t index = reader_.ReadU32();
+        if (index >= symbols_.size()) {
+            throw CacheError("Bytecode cache refers to an unknown name"s);
+        }
+        return symbols_[index];
+    }
+
+    vector<runtime::Symbol> ReadSymbols() {
+        vector<runtime::Symbol> symbols(reader_.ReadCount(4));
+        for (runtime::Symbol& symbol : symbols) {
+            symbol = ReadSymbol();
+        }
+        return symbols;
+    }
+
+    // Номер кэша в инструкции занимает 16 бит
+    size_t ReadCacheCount() {
+        const size_t count = reader_.ReadU32();
+        if (count > size_t{numeric_limits<uint16_t>::max()} + 1) {
+            throw CacheError("Bytecode cache is corrupted"s);
+        }
+        return count;
+    }
+
+    ObjectHolder ReadConstant(const vector<ObjectHolder>& classes) {
+        switch (static_cast<ConstantTag>(reader_.ReadU8())) {
+            case ConstantTag::None:
+                return {};
+            case ConstantTag::Number:
+                return ObjectHolder::Own(runtime::Number(static_cast<int>(reader_.ReadU32())));
+            case ConstantTag::String:
+                return ObjectHolder::Own(runtime::String(string(reader_.ReadString())));
+            case ConstantTag::Bool:
+                return ObjectHolder::Own(runtime::Bool(reader_.ReadU8() != 0));
+            case ConstantTag::Class:
+                return ObjectHolder::Share(*GetClass(classes, reader_.ReadU32()));
+        }
+        throw CacheError("Bytecode cache contains a constant of unknown type"s);
+    }
+
+    static runtime::Class* GetClass(const vector<ObjectHolder>& classes, uint32_t index) {
+        if (index >= classes.size()) {
+            throw CacheError("Bytecode cache refers to an unknown class"s);
+        }
+        return classes[index].TryAs<runtime::Class>();
+    }
+
+    // Возвращает число значений, которые инструкция снимает со стека либо читает на его вершине
+    static int GetStackInputs(const Instruction& instr) {
+        switch (instr.op) {
+            case OpCode::LoadConst:
+            case OpCode::LoadNone:
+            case OpCode::LoadLocal:
+            case OpCode::LoadLocalChecked:
+            case OpCode::Jump:
+            case OpCode::PrintNewline:
+                return 0;
+            case OpCode::StoreField:
+            case OpCode::Add:
+            case OpCode::Sub:
+            case OpCode::Mult:
+            case OpCode::Div:
+            case OpCode::Equal:
+            case OpCode::NotEqual:
+            case OpCode::Less:
+            case OpCode::Greater:
+            case OpCode::LessOrEqual:
+            case OpCode::GreaterOrEqual:
+            case OpCode::CompareJumpIfFalse:
+            case OpCode::CompareJumpIfTrue:
+                return 2;
+            case OpCode::CallMethod:
+                return instr.count + 1;
+            case OpCode::NewInstance:
+                return instr.count;
+            default:
+                return 1;
+        }
+    }
+
+    // Проверяет, что операнды инструкций не выходят за пределы таблиц кода и что код можно
+    // безопасно выполнить: переходы ведут вперёд внутри кода (циклов в Mython нет), выполнение
+    // не проходит за последнюю инструкцию, стек не опустошается сверх меры, а в каждую инструкцию
+    // все пути приходят с одной глубиной стека. Попутно вычисляет наибольшую глубину стека
+    static void Validate(Code& code) {
+        auto check = [](bool condition) {
+            if (!condition) {
+                throw CacheError("Bytecode cache is corrupted"s);
+            }
+        };
+
+        const size_t size = code.instructions.size();
+        for (size_t i = 0; i < size; ++i) {
+            const Instruction& instr = code.instructions[i];
+            switch (instr.op) {
+                case OpCode::LoadConst:
+                    check(instr.arg < code.constants.size());
+                    break;
+                case OpCode::NewInstance:
+                    check(instr.arg < code.constants.size()
+                          && code.constants[instr.arg].GetKind() == runtime::Kind::Class
+                          && instr.cache < code.method_cache_count);
+                    break;
+                case OpCode::LoadLocal:
+                case OpCode::LoadLocalChecked:
+                case OpCode::StoreLocal:
+                    check(instr.arg < code.locals.size());
+                    break;
+                case OpCode::LoadField:
+                case OpCode::StoreField:
+                    check(instr.arg < code.names.size() && instr.cache < code.field_cache_count);
+                    break;
+                case OpCode::CallMethod:
+                    check(instr.arg < code.names.size() && instr.cache < code.method_cache_count);
+                    break;
+                case OpCode::Jump:
+                case OpCode::JumpIfFalse:
+                case OpCode::JumpIfTrue:
+                case OpCode::JumpIfTrueOrPop:
+                case OpCode::JumpIfFalseOrPop:
+                    check(instr.arg > i && instr.arg < size);
+                    break;
+                case OpCode::CompareJumpIfFalse:
+                case OpCode::CompareJumpIfTrue:
+                    check(instr.arg > i && instr.arg < size
+                          && instr.count >= static_cast<uint8_t>(OpCode::Equal)
+                          && instr.count <= static_cast<uint8_t>(OpCode::GreaterOrEqual));
+                    break;
+                default:
+                    check(instr.op <= OpCode::Return);
+                    break;
+            }
+        }
+
+        // Переходы ведут только вперёд, поэтому глубина стека перед инструкцией известна
+        // к тому времени, как до неё доходит проход. -1 - инструкция пока недостижима
+        vector<int> depths(size, -1);
+        auto reach = [&depths, &check, size](size_t target, int depth) {
+            check(target < size);
+            check(depths[target] == -1 || depths[target] == depth);
+            depths[target] = depth;
+        };
+        check(size != 0);
+        depths[0] = 0;
+        code.max_stack = 0;
+        for (size_t i = 0; i < size; ++i) {
+            const int depth = depths[i];
+            if (depth == -1) {
+                continue;
+            }
+            const Instruction& instr = code.instructions[i];
+            check(depth >= GetStackInputs(instr));
+            const int after = depth + GetStackEffect(instr.op, instr.count);
+            code.max_stack = max(code.max_stack, static_cast<size_t>(max(depth, after)));
+            switch (instr.op) {
+                case OpCode::Return:
+                    break;
+                case OpCode::Jump:
+                    reach(instr.arg, depth);
+                    break;
+                case OpCode::JumpIfTrueOrPop:
+                case OpCode::JumpIfFalseOrPop:
+                    // При переходе значение остаётся на стеке
+                    reach(instr.arg, depth);
+                    reach(i + 1, after);
+                    break;
+                case OpCode::JumpIfFalse:
+                case OpCode::JumpIfTrue:
+                case OpCode::CompareJumpIfFalse:
+                case OpCode::CompareJumpIfTrue:
+                    reach(instr.arg, after);
+                    reach(i + 1, after);
+                    break;
+                default:
+                    reach(i + 1, after);
+                    break;
+            }
+        }
+
+        auto is_local = [&code](uint32_t slot) {
+            return slot < code.locals.size();
+        };
+        check(all_of(code.param_slots.begin(), code.param_slots.end(), is_local)
+              && all_of(code.checked_locals.begin(), code.checked_locals.end(), is_local));
+    }
+
+    Reader& reader_;
+    vector<runtime::Symbol> symbols_;
+    uint32_t code_count_ = 0;
+};
+
+}  // namespace
+
+SourceStamp GetSourceStamp(const string& path) {
+    SourceStamp stamp;
+    stamp.size = filesystem::file_size(path);
+    stamp.modified = static_cast<int64_t>(filesystem::last_write_time(path).time_since_epoch().count());
+    return stamp;
+}
+
+void SaveProgram(ostream& output, const Program& program, const SourceStamp& source) {
+    Writer writer;
+    WriteHeader(writer, source);
+    ProgramWriter{program}.Write(writer, program);
+    output.write(writer.GetData().data(), static_cast<streamsize>(writer.GetData().size()));
+}
+
+Program LoadProgram(string_view data, const SourceStamp& source) {
+    Reader reader(data);
+    ReadHeader(reader, source);
+    Program program = ProgramReader{reader}.Read();
+    if (!reader.AtEnd()) {
+        throw CacheError("Bytecode cache has trailing data"s);
+    }
+    return program;
+}
+
+string GetCachePath(const string& source_path) {
+    return source_path + "c"s;
+}
+
+optional<Program> LoadCacheFile(const string& cache_path, const SourceStamp& source) {
+    error_code error;
+    const auto cache_time = filesystem::last_write_time(cache_path, error);
+    if (error || cache_time.time_since_epoch().count() < source.modified) {
+        return nullopt;
+    }
+    try {
+        const parse::MappedFile file(cache_path);
+        return LoadProgram(file.GetContents(), source);
+    } catch (const runtime_error&) {
+        // Повреждённый или устаревший кэш заменит заново скомпилированная программа
+        return nullopt;
+    }
+}
+
+bool SaveCacheFile(const string& cache_path, const Program& program, const SourceStamp& source) {
+    // У каждого процесса свой временный файл, а переименование заменяет кэш атомарно
+    const string temp_path = cache_path + ".tmp"s + to_string(random_device{}());
+    try {
+        {
+            ofstream output(temp_path, ios::binary | ios::trunc);
+            SaveProgram(output, program, source);
+            if (!output.flush()) {
+                throw CacheError("Can't write "s + temp_path);
+            }
+        }
+        filesystem::rename(temp_path, cache_path);
+        return true;
+    } catch (const exception&) {
+        error_code error;
+        filesystem::remove(temp_path, error);
+        return false;
+    }
+}
+
+}  // namespace bytecode
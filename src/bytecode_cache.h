@@ -0,0 +1,63 @@
+#pragma once
+
+#include "bytecode.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace bytecode {
+
+struct CacheError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Версия формата кэша. Её нужно увеличивать при любом изменении формата, набора
+// кодов операций или смысла полей Instruction и Code: кэш другой версии не загружается
+inline constexpr std::uint32_t CACHE_FORMAT_VERSION = 3;
+
+// Размер и время изменения исходного файла, из которого скомпилирована программа
+struct SourceStamp {
+    std::uint64_t size = 0;
+    // Время изменения в единицах std::filesystem::file_time_type
+    std::int64_t modified = 0;
+
+    bool operator==(const SourceStamp& other) const {
+        return size == other.size && modified == other.modified;
+    }
+    bool operator!=(const SourceStamp& other) const {
+        return !(*this == other);
+    }
+};
+
+// Возвращает размер и время изменения файла path.
+// Выбрасывает std::filesystem::filesystem_error, если файл недоступен
+SourceStamp GetSourceStamp(const std::string& path);
+
+/*
+ * Записывает программу в двоичном формате: заголовок с версией формата и source, таблица имён,
+ * классы (родитель раньше наследника) и код верхнего уровня. Имена и константы-классы
+ * записываются номерами, кэши мест вызова - только количеством. Числа записываются
+ * в порядке little-endian
+ */
+void SaveProgram(std::ostream& output, const Program& program, const SourceStamp& source);
+
+// Восстанавливает программу, записанную SaveProgram. Выбрасывает CacheError, если данные
+// повреждены, записаны в другой версии формата либо получены не из файла с отметкой source
+Program LoadProgram(std::string_view data, const SourceStamp& source);
+
+// Возвращает путь к файлу кэша для программы из файла source_path
+std::string GetCachePath(const std::string& source_path);
+
+// Загружает программу из файла кэша cache_path, если он не старше исходного файла
+// и получен из его текущей версии. Иначе возвращает std::nullopt
+std::optional<Program> LoadCacheFile(const std::string& cache_path, const SourceStamp& source);
+
+// Записывает программу в файл кэша. Файл заменяется целиком, поэтому параллельно запущенный
+// интерпретатор не прочтёт его наполовину записанным. Возвращает false, если записать не удалось
+bool SaveCacheFile(const std::string& cache_path, const Program& program, const SourceStamp& source);
+
+}  // namespace bytecode
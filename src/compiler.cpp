@@ -0,0 +1,495 @@
+#include "compiler.h"
+
+#include "vm.h"
+
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace bytecode {
+
+using runtime::ObjectHolder;
+
+namespace {
+
+const runtime::Symbol SELF{"self"sv};
+
+using CompareFn = bool (*)(const ObjectHolder&, const ObjectHolder&, runtime::Context&);
+
+// Результат анализа присваиваний: каким слотам гарантированно присвоено значение
+struct AssignmentState {
+    vector<bool> assigned;
+    // Код после return недостижим, в нём любая переменная считается присвоенной
+    bool unreachable = false;
+};
+
+// Собирает инструкции, константы и имена одного фрагмента кода.
+// Попутно назначает локальным переменным слоты и отслеживает, каким из них гарантированно
+// присвоено значение, чтобы проверять на присваивание только сомнительные чтения
+class CodeBuilder {
+public:
+    size_t Emit(OpCode op, size_t arg = 0, size_t count = 0) {
+        using namespace std::literals;
+        if (count > numeric_limits<uint8_t>::max()) {
+            throw CompileError("Too many arguments in a single call or print"s);
+        }
+        code_.instructions.push_back(
+            {op, static_cast<uint8_t>(count), 0, static_cast<uint32_t>(arg)});
+        depth_ += GetStackEffect(op, static_cast<int>(count));
+        code_.max_stack = max(code_.max_stack, static_cast<size_t>(depth_));
+        return code_.instructions.size() - 1;
+    }
+
+    // Направляет переход, записанный инструкцией jump, на следующую инструкцию
+    void PatchJump(size_t jump) {
+        code_.instructions[jump].arg = static_cast<uint32_t>(code_.instructions.size());
+    }
+
+    size_t AddConstant(ObjectHolder value) {
+        code_.constants.push_back(std::move(value));
+        return code_.constants.size() - 1;
+    }
+
+    size_t AddName(runtime::Symbol name) {
+        auto [it, inserted] = name_indices_.emplace(name, code_.names.size());
+        if (inserted) {
+            code_.names.push_back(name);
+        }
+        return it->second;
+    }
+
+    // Возвращает слот локальной переменной name, при необходимости выделяя новый
+    size_t AddLocal(runtime::Symbol name) {
+        auto [it, inserted] = local_indices_.emplace(name, code_.locals.size());
+        if (inserted) {
+            code_.locals.push_back(name);
+            state_.assigned.push_back(false);
+        }
+        return it->second;
+    }
+
+    void MarkAssigned(size_t slot) {
+        state_.assigned[slot] = true;
+    }
+
+    // Объявляет формальный параметр метода. Параметры гарантированно получают значения
+    void AddParam(runtime::Symbol name) {
+        size_t slot = AddLocal(name);
+        code_.param_slots.push_back(static_cast<uint32_t>(slot));
+        MarkAssigned(slot);
+    }
+
+    void EmitLoadLocal(runtime::Symbol name) {
+        size_t slot = AddLocal(name);
+        if (state_.unreachable || state_.assigned[slot]) {
+            Emit(OpCode::LoadLocal, slot);
+            return;
+        }
+        Emit(OpCode::LoadLocalChecked, slot);
+        if (checked_.insert(slot).second) {
+            code_.checked_locals.push_back(static_cast<uint32_t>(slot));
+        }
+    }
+
+    void EmitStoreLocal(runtime::Symbol name) {
+        size_t slot = AddLocal(name);
+        Emit(OpCode::StoreLocal, slot);
+        state_.assigned[slot] = true;
+    }
+
+    // Отмечает, что print может прочитать любую переменную по имени, даже ещё не присвоенную
+    void MarkLocalsReadByName() {
+        locals_read_by_name_ = true;
+    }
+
+    void MarkUnreachable() {
+        state_.unreachable = true;
+    }
+
+    const AssignmentState& GetState() const {
+        return state_;
+    }
+
+    void SetState(AssignmentState state) {
+        // Слоты, выделенные в другой ветке, в этой ветке значения не получили
+        state.assigned.resize(code_.locals.size(), false);
+        state_ = std::move(state);
+    }
+
+    // Объединяет состояние после текущей ветки с состоянием после ветки other:
+    // переменная присвоена, только если ей присвоено значение в обеих ветках
+    void MergeState(const AssignmentState& other) {
+        if (other.unreachable) {
+            return;
+        }
+        if (state_.unreachable) {
+            SetState(other);
+            return;
+        }
+        for (size_t slot = 0; slot < state_.assigned.size(); ++slot) {
+            state_.assigned[slot] = state_.assigned[slot] && slot < other.assigned.size()
+                                    && other.assigned[slot];
+        }
+    }
+
+    // Добавляет инструкцию LoadField или StoreField с собственным кэшем
+    void EmitFieldAccess(OpCode op, runtime::Symbol name) {
+        size_t instr = Emit(op, AddName(name));
+        code_.instructions[instr].cache = NextCacheIndex(code_.field_cache_count++);
+    }
+
+    // Добавляет вызов метода name с собственным кэшем
+    void EmitCallMethod(runtime::Symbol name, size_t arg_count) {
+        AddMethodCache(Emit(OpCode::CallMethod, AddName(name), arg_count));
+    }
+
+    // Добавляет создание экземпляра класса из константы class_const.
+    // Кэш вызова нужен для поиска метода __init__
+    void EmitNewInstance(size_t class_const, size_t arg_count) {
+        AddMethodCache(Emit(OpCode::NewInstance, class_const, arg_count));
+    }
+
+    Code Build() {
+        if (locals_read_by_name_) {
+            for (size_t slot = 0; slot < code_.locals.size(); ++slot) {
+                if (checked_.insert(slot).second) {
+                    code_.checked_locals.push_back(static_cast<uint32_t>(slot));
+                }
+            }
+        }
+        return std::move(code_);
+    }
+
+private:
+    void AddMethodCache(size_t instr) {
+        code_.instructions[instr].cache = NextCacheIndex(code_.method_cache_count++);
+    }
+
+    static uint16_t NextCacheIndex(size_t cache_count) {
+        using namespace std::literals;
+        if (cache_count > numeric_limits<uint16_t>::max()) {
+            throw CompileError("Too many field accesses or calls in a single method"s);
+        }
+        return static_cast<uint16_t>(cache_count);
+    }
+
+    Code code_;
+    int depth_ = 0;
+    unordered_map<runtime::Symbol, size_t> name_indices_;
+    unordered_map<runtime::Symbol, size_t> local_indices_;
+    unordered_set<size_t> checked_;
+    bool locals_read_by_name_ = false;
+    AssignmentState state_;
+};
+
+class Compiler {
+public:
+    explicit Compiler(Program& program)
+        : program_(program) {
+    }
+
+    void CompileProgram(const ast::Statement& root) {
+        CodeBuilder builder;
+        CompileStatement(root, builder);
+        builder.Emit(OpCode::LoadNone);
+        builder.Emit(OpCode::Return);
+        program_.main = BuildCode(builder);
+    }
+
+private:
+    // Завершает код и присваивает ему очередной номер в программе
+    Code BuildCode(CodeBuilder& builder) {
+        Code code = builder.Build();
+        code.id = program_.code_count++;
+        return code;
+    }
+
+    // Компилирует инструкцию, не оставляющую значений на стеке
+    void CompileStatement(const ast::Statement& node, CodeBuilder& builder) {
+        if (!TryCompileStatement(node, builder)) {
+            CompileExpression(node, builder);
+            builder.Emit(OpCode::Pop);
+        }
+    }
+
+    bool TryCompileStatement(const ast::Statement& node, CodeBuilder& builder) {
+        if (const auto* compound = dynamic_cast<const ast::Compound*>(&node)) {
+            for (const auto& stmt : compound->GetStatements()) {
+                CompileStatement(*stmt, builder);
+            }
+        } else if (const auto* program = dynamic_cast<const ast::Program*>(&node)) {
+            CompileStatement(program->GetBody(), builder);
+        } else if (const auto* assign = dynamic_cast<const ast::Assignment*>(&node)) {
+            CompileExpression(assign->GetValue(), builder);
+            builder.EmitStoreLocal(assign->GetVarName());
+        } else if (const auto* field = dynamic_cast<const ast::FieldAssignment*>(&node)) {
+            CompileExpression(field->GetValue(), builder);
+            CompileExpression(field->GetObject(), builder);
+            builder.EmitFieldAccess(OpCode::StoreField, field->GetFieldName());
+        } else if (const auto* print = dynamic_cast<const ast::Print*>(&node)) {
+            // Каждый аргумент и пробел за ним выводятся до вычисления следующего аргумента,
+            // как при обходе дерева
+            auto args = print->GetArgs();
+            for (size_t i = 0; i < args.size(); ++i) {
+                CompileExpression(*args[i], builder);
+                builder.Emit(OpCode::Print, 0, i + 1 < args.size() ? 1 : 0);
+            }
+            builder.Emit(OpCode::PrintNewline);
+            builder.MarkLocalsReadByName();
+        } else if (const auto* if_else = dynamic_cast<const ast::IfElse*>(&node)) {
+            vector<size_t> jumps_to_else;
+            CompileCondition(if_else->GetCondition(), false, jumps_to_else, builder);
+            AssignmentState before_if = builder.GetState();
+            CompileStatement(if_else->GetIfBody(), builder);
+            AssignmentState after_if = builder.GetState();
+            builder.SetState(std::move(before_if));
+            if (const ast::Statement* else_body = if_else->GetElseBody()) {
+                size_t jump_to_end = builder.Emit(OpCode::Jump);
+                PatchJumps(jumps_to_else, builder);
+                CompileStatement(*else_body, builder);
+                builder.PatchJump(jump_to_end);
+            } else {
+                PatchJumps(jumps_to_else, builder);
+            }
+            builder.MergeState(after_if);
+        } else if (const auto* ret = dynamic_cast<const ast::Return*>(&node)) {
+            CompileExpression(ret->GetStatement(), builder);
+            builder.Emit(OpCode::Return);
+            builder.MarkUnreachable();
+        } else if (const auto* cls_def = dynamic_cast<const ast::ClassDefinition*>(&node)) {
+            const auto& cls = static_cast<const runtime::Class&>(*cls_def->GetClass());
+            builder.Emit(OpCode::LoadConst, AddClassConstant(cls, builder));
+            builder.EmitStoreLocal(cls.GetName());
+        } else if (const auto* body = dynamic_cast<const ast::MethodBody*>(&node)) {
+            CompileStatement(body->GetBody(), builder);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Компилирует выражение, оставляющее на стеке ровно одно значение
+    void CompileExpression(const ast::Statement& node, CodeBuilder& builder) {
+        using namespace std::literals;
+
+        if (const auto* num = dynamic_cast<const ast::NumericConst*>(&node)) {
+            builder.Emit(OpCode::LoadConst,
+                         builder.AddConstant(ObjectHolder::Own(runtime::Number(num->GetValue()))));
+        } else if (const auto* str = dynamic_cast<const ast::StringConst*>(&node)) {
+            builder.Emit(OpCode::LoadConst,
+                         builder.AddConstant(ObjectHolder::Own(runtime::String(str->GetValue()))));
+        } else if (const auto* boolean = dynamic_cast<const ast::BoolConst*>(&node)) {
+            builder.Emit(OpCode::LoadConst,
+                         builder.AddConstant(ObjectHolder::Own(runtime::Bool(boolean->GetValue()))));
+        } else if (dynamic_cast<const ast::None*>(&node)) {
+            builder.Emit(OpCode::LoadNone);
+        } else if (const auto* var = dynamic_cast<const ast::VariableValue*>(&node)) {
+            vector<runtime::Symbol> ids = var->GetDottedIds();
+            builder.EmitLoadLocal(ids.front());
+            for (size_t i = 1; i < ids.size(); ++i) {
+                builder.EmitFieldAccess(OpCode::LoadField, ids[i]);
+            }
+        } else if (const auto* call = dynamic_cast<const ast::MethodCall*>(&node)) {
+            CompileExpression(call->GetObject(), builder);
+            for (const auto& arg : call->GetArgs()) {
+                CompileExpression(*arg, builder);
+            }
+            builder.EmitCallMethod(call->GetMethodName(), call->GetArgs().size());
+        } else if (const auto* new_inst = dynamic_cast<const ast::NewInstance*>(&node)) {
+            for (const auto& arg : new_inst->GetArgs()) {
+                CompileExpression(*arg, builder);
+            }
+            builder.EmitNewInstance(AddClassConstant(new_inst->GetClass(), builder),
+                                    new_inst->GetArgs().size());
+        } else if (const auto* stringify = dynamic_cast<const ast::Stringify*>(&node)) {
+            CompileExpression(stringify->GetArgument(), builder);
+            builder.Emit(OpCode::Stringify);
+        } else if (const auto* not_op = dynamic_cast<const ast::Not*>(&node)) {
+            CompileExpression(not_op->GetArgument(), builder);
+            builder.Emit(OpCode::Not);
+        } else if (const auto* or_op = dynamic_cast<const ast::Or*>(&node)) {
+            // Правый операнд вычисляется, только если левый ложен
+            CompileExpression(or_op->GetLhs(), builder);
+            builder.Emit(OpCode::ToBool);
+            size_t jump_to_end = builder.Emit(OpCode::JumpIfTrueOrPop);
+            CompileExpression(or_op->GetRhs(), builder);
+            builder.Emit(OpCode::ToBool);
+            builder.PatchJump(jump_to_end);
+        } else if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&node)) {
+            OpCode op = GetComparisonOpCode(*comparison);
+            CompileBinary(*comparison, op, builder);
+        } else if (const auto* add = dynamic_cast<const ast::Add*>(&node)) {
+            CompileBinary(*add, OpCode::Add, builder);
+        } else if (const auto* sub = dynamic_cast<const ast::Sub*>(&node)) {
+            CompileBinary(*sub, OpCode::Sub, builder);
+        } else if (const auto* mult = dynamic_cast<const ast::Mult*>(&node)) {
+            CompileBinary(*mult, OpCode::Mult, builder);
+        } else if (const auto* div = dynamic_cast<const ast::Div*>(&node)) {
+            CompileBinary(*div, OpCode::Div, builder);
+        } else if (const auto* and_op = dynamic_cast<const ast::And*>(&node)) {
+            // Правый операнд вычисляется, только если левый истинен
+            CompileExpression(and_op->GetLhs(), builder);
+            builder.Emit(OpCode::ToBool);
+            size_t jump_to_end = builder.Emit(OpCode::JumpIfFalseOrPop);
+            CompileExpression(and_op->GetRhs(), builder);
+            builder.Emit(OpCode::ToBool);
+            builder.PatchJump(jump_to_end);
+        } else if (const auto* assign = dynamic_cast<const ast::Assignment*>(&node)) {
+            // Присваивание возвращает присвоенное значение
+            CompileStatement(*assign, builder);
+            builder.EmitLoadLocal(assign->GetVarName());
+        } else if (TryCompileStatement(node, builder)) {
+            builder.Emit(OpCode::LoadNone);
+        } else {
+            throw CompileError("Unsupported statement type"s);
+        }
+    }
+
+    /*
+     * Компилирует условие в переходы: если его логическое значение равно jump_when, выполняется
+     * переход, номер инструкции которого добавляется в jumps, иначе выполнение продолжается.
+     * Логические операции вычисляются сокращённо, а сравнения сразу выполняют переход,
+     * поэтому объекты Bool для промежуточных результатов не создаются
+     */
+    void CompileCondition(const ast::Statement& node, bool jump_when, vector<size_t>& jumps,
+                          CodeBuilder& builder) {
+        if (const auto* not_op = dynamic_cast<const ast::Not*>(&node)) {
+            CompileCondition(not_op->GetArgument(), !jump_when, jumps, builder);
+        } else if (const auto* and_op = dynamic_cast<const ast::And*>(&node)) {
+            if (!jump_when) {
+                CompileCondition(and_op->GetLhs(), false, jumps, builder);
+                CompileCondition(and_op->GetRhs(), false, jumps, builder);
+            } else {
+                vector<size_t> jumps_past;
+                CompileCondition(and_op->GetLhs(), false, jumps_past, builder);
+                CompileCondition(and_op->GetRhs(), true, jumps, builder);
+                PatchJumps(jumps_past, builder);
+            }
+        } else if (const auto* or_op = dynamic_cast<const ast::Or*>(&node)) {
+            if (jump_when) {
+                CompileCondition(or_op->GetLhs(), true, jumps, builder);
+                CompileCondition(or_op->GetRhs(), true, jumps, builder);
+            } else {
+                vector<size_t> jumps_past;
+                CompileCondition(or_op->GetLhs(), true, jumps_past, builder);
+                CompileCondition(or_op->GetRhs(), false, jumps, builder);
+                PatchJumps(jumps_past, builder);
+            }
+        } else if (const auto* comparison = dynamic_cast<const ast::Comparison*>(&node)) {
+            const OpCode op = GetComparisonOpCode(*comparison);
+            CompileExpression(comparison->GetLhs(), builder);
+            CompileExpression(comparison->GetRhs(), builder);
+            jumps.push_back(builder.Emit(jump_when ? OpCode::CompareJumpIfTrue : OpCode::CompareJumpIfFalse,
+                                         0, static_cast<size_t>(op)));
+        } else {
+            CompileExpression(node, builder);
+            jumps.push_back(builder.Emit(jump_when ? OpCode::JumpIfTrue : OpCode::JumpIfFalse));
+        }
+    }
+
+    static void PatchJumps(const vector<size_t>& jumps, CodeBuilder& builder) {
+        for (size_t jump : jumps) {
+            builder.PatchJump(jump);
+        }
+    }
+
+    void CompileBinary(const ast::BinaryOperation& node, OpCode op, CodeBuilder& builder) {
+        CompileExpression(node.GetLhs(), builder);
+        CompileExpression(node.GetRhs(), builder);
+        builder.Emit(op);
+    }
+
+    static OpCode GetComparisonOpCode(const ast::Comparison& node) {
+        using namespace std::literals;
+
+        const CompareFn* cmp = node.GetComparator().target<CompareFn>();
+        if (cmp != nullptr) {
+            if (*cmp == &runtime::Equal) {
+                return OpCode::Equal;
+            }
+            if (*cmp == &runtime::NotEqual) {
+                return OpCode::NotEqual;
+            }
+            if (*cmp == &runtime::Less) {
+                return OpCode::Less;
+            }
+            if (*cmp == &runtime::Greater) {
+                return OpCode::Greater;
+            }
+            if (*cmp == &runtime::LessOrEqual) {
+                return OpCode::LessOrEqual;
+            }
+            if (*cmp == &runtime::GreaterOrEqual) {
+                return OpCode::GreaterOrEqual;
+            }
+        }
+        throw CompileError("Unsupported comparator"s);
+    }
+
+    size_t AddClassConstant(const runtime::Class& cls, CodeBuilder& builder) {
+        return builder.AddConstant(ObjectHolder::Share(GetCompiledClass(cls)));
+    }
+
+    // Возвращает копию класса cls с методами, скомпилированными в байт-код
+    runtime::Class& GetCompiledClass(const runtime::Class& cls) {
+        if (auto it = compiled_classes_.find(&cls); it != compiled_classes_.end()) {
+            return *it->second;
+        }
+
+        const runtime::Class* parent = nullptr;
+        if (cls.GetParent() != nullptr) {
+            parent = &GetCompiledClass(*cls.GetParent());
+        }
+
+        vector<runtime::Method> methods;
+        methods.reserve(cls.GetMethods().size());
+        for (const runtime::Method& method : cls.GetMethods()) {
+            methods.push_back({method.name, method.formal_params,
+                               make_unique<vm::Function>(CompileMethod(method))});
+        }
+
+        program_.classes.push_back(
+            ObjectHolder::Own(runtime::Class(cls.GetName(), std::move(methods), parent)));
+        auto* compiled = program_.classes.back().TryAs<runtime::Class>();
+        compiled_classes_[&cls] = compiled;
+        return *compiled;
+    }
+
+    Code CompileMethod(const runtime::Method& method) {
+        CodeBuilder builder;
+        // Метод видит только self и свои параметры, поэтому все его имена - локальные.
+        // self всегда занимает слот 0
+        builder.MarkAssigned(builder.AddLocal(SELF));
+        for (runtime::Symbol param : method.formal_params) {
+            builder.AddParam(param);
+        }
+
+        const auto* body = dynamic_cast<const ast::Statement*>(method.body.get());
+        if (body == nullptr) {
+            throw CompileError("Method "s + method.name.GetName() + " has no syntax tree to compile"s);
+        }
+        if (const auto* method_body = dynamic_cast<const ast::MethodBody*>(body)) {
+            CompileStatement(method_body->GetBody(), builder);
+            builder.Emit(OpCode::LoadNone);
+        } else {
+            CompileExpression(*body, builder);
+        }
+        builder.Emit(OpCode::Return);
+        return BuildCode(builder);
+    }
+
+    Program& program_;
+    unordered_map<const runtime::Class*, runtime::Class*> compiled_classes_;
+};
+
+}  // namespace
+
+Program Compile(const ast::Statement& program) {
+    Program result;
+    Compiler{result}.CompileProgram(program);
+    return result;
+}
+
+}  // namespace bytecode
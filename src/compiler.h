@@ -0,0 +1,19 @@
+#pragma once
+
+#include "bytecode.h"
+#include "statement.h"
+
+#include <stdexcept>
+
+namespace bytecode {
+
+struct CompileError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Компилирует дерево, построенное ParseProgram, в байт-код.
+// Классы программы пересоздаются с методами, скомпилированными в байт-код,
+// поэтому результат не зависит от времени жизни дерева
+Program Compile(const ast::Statement& program);
+
+}  // namespace bytecode
@@ -0,0 +1,208 @@
+#include "fold.h"
+
+#include <limits>
+#include <optional>
+#include <utility>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::ObjectHolder;
+
+namespace {
+
+bool IsConstant(const Statement& node) {
+    return dynamic_cast<const NumericConst*>(&node) != nullptr
+        || dynamic_cast<const StringConst*>(&node) != nullptr
+        || dynamic_cast<const BoolConst*>(&node) != nullptr
+        || dynamic_cast<const None*>(&node) != nullptr;
+}
+
+// Возвращает true, если значением выражения может быть только число.
+// Операции -, * и / либо возвращают число, либо выбрасывают исключение
+bool IsNumeric(const Statement& node) {
+    return dynamic_cast<const NumericConst*>(&node) != nullptr
+        || dynamic_cast<const Sub*>(&node) != nullptr
+        || dynamic_cast<const Mult*>(&node) != nullptr
+        || dynamic_cast<const Div*>(&node) != nullptr;
+}
+
+// Парсер записывает унарный минус как умножение на -1
+bool IsNegation(const Statement& node) {
+    const auto* mult = dynamic_cast<const Mult*>(&node);
+    if (mult == nullptr) {
+        return false;
+    }
+    const auto* factor = dynamic_cast<const NumericConst*>(&mult->GetRhs());
+    return factor != nullptr && factor->GetValue().GetValue() == -1;
+}
+
+// Возвращает значение константы
+ObjectHolder GetConstantValue(const Statement& node) {
+    if (const auto* number = dynamic_cast<const NumericConst*>(&node)) {
+        return ObjectHolder::Own(number->GetValue());
+    }
+    if (const auto* str = dynamic_cast<const StringConst*>(&node)) {
+        return ObjectHolder::Own(runtime::String(str->GetValue()));
+    }
+    if (const auto* boolean = dynamic_cast<const BoolConst*>(&node)) {
+        return ObjectHolder::Own(boolean->GetValue());
+    }
+    return {};
+}
+
+// Вычисляет значение выражения над константами
+ObjectHolder Evaluate(Statement& node) {
+    runtime::Closure closure;
+    runtime::DummyContext context;
+    return node.Execute(closure, context);
+}
+
+unique_ptr<Statement> MakeConstant(const ObjectHolder& value) {
+    switch (value.GetKind()) {
+        case runtime::Kind::Number:
+            return make_unique<NumericConst>(*value.TryAs<runtime::Number>());
+        case runtime::Kind::String:
+            return make_unique<StringConst>(*value.TryAs<runtime::String>());
+        case runtime::Kind::Bool:
+            return make_unique<BoolConst>(*value.TryAs<runtime::Bool>());
+        case runtime::Kind::None:
+            return make_unique<None>();
+        default:
+            return nullptr;
+    }
+}
+
+// Забирает у узла его дочерние узлы
+vector<unique_ptr<Statement>> TakeChildren(Statement& node) {
+    vector<unique_ptr<Statement>> children;
+    node.ForEachChild([&children](unique_ptr<Statement>& child) {
+        children.push_back(std::move(child));
+    });
+    return children;
+}
+
+class ConstantFolder {
+public:
+    FoldStats Fold(unique_ptr<Statement>& root) {
+        Visit(root);
+        return stats_;
+    }
+
+private:
+    // Дочерние узлы сворачиваются раньше родителя, поэтому выражение из констант
+    // сворачивается целиком за один проход
+    void Visit(unique_ptr<Statement>& node) {
+        node->ForEachChild(visit_);
+        if (auto* definition = dynamic_cast<ClassDefinition*>(node.get())) {
+            VisitMethods(*definition);
+        }
+        if (auto folded = TryFold(*node)) {
+            Replace(node, std::move(folded));
+            ++stats_.folded;
+        } else if (auto simplified = TrySimplifyNegation(*node)) {
+            Replace(node, std::move(simplified));
+            ++stats_.simplified_negations;
+        }
+    }
+
+    void VisitMethods(ClassDefinition& definition) {
+        const auto* cls = definition.GetClass().TryAs<runtime::Class>();
+        for (const runtime::Method& method : cls->GetMethods()) {
+            if (auto* body = dynamic_cast<MethodBody*>(method.body.get())) {
+                body->ForEachChild(visit_);
+            }
+        }
+    }
+
+    static void Replace(unique_ptr<Statement>& node, unique_ptr<Statement> replacement) {
+        DestroyTree(std::exchange(node, std::move(replacement)));
+    }
+
+    static unique_ptr<Statement> TryFold(Statement& node) {
+        if (const auto* binary = dynamic_cast<const BinaryOperation*>(&node)) {
+            // Результат or определён истинным левым аргументом, правый не вычисляется
+            if (dynamic_cast<const Or*>(binary) != nullptr && IsConstant(binary->GetLhs())
+                && runtime::IsTrue(GetConstantValue(binary->GetLhs()))) {
+                return make_unique<BoolConst>(runtime::Bool(true));
+            }
+            if (!IsConstant(binary->GetLhs()) || !IsConstant(binary->GetRhs())
+                || IsOverflowingDivision(*binary)) {
+                return nullptr;
+            }
+        } else if (const auto* unary = dynamic_cast<const UnaryOperation*>(&node)) {
+            if (!IsConstant(unary->GetArgument())) {
+                return nullptr;
+            }
+        } else {
+            return nullptr;
+        }
+
+        try {
+            return MakeConstant(Evaluate(node));
+        } catch (const runtime_error&) {
+            // Ошибку выбросит сама операция при выполнении программы
+            return nullptr;
+        }
+    }
+
+    // Деление INT_MIN на -1 не определено, его результат нельзя вычислить заранее
+    static bool IsOverflowingDivision(const BinaryOperation& node) {
+        if (dynamic_cast<const Div*>(&node) == nullptr) {
+            return false;
+        }
+        const auto* lhs = dynamic_cast<const NumericConst*>(&node.GetLhs());
+        const auto* rhs = dynamic_cast<const NumericConst*>(&node.GetRhs());
+        return lhs != nullptr && rhs != nullptr && rhs->GetValue().GetValue() == -1
+            && lhs->GetValue().GetValue() == numeric_limits<int>::min();
+    }
+
+    // Отрицание снимается, только если его аргумент заведомо число: иначе умножение
+    // на -1 выбросило бы исключение, которое должно сохраниться
+    static unique_ptr<Statement> TrySimplifyNegation(Statement& node) {
+        const auto* binary = dynamic_cast<const BinaryOperation*>(&node);
+        if (binary == nullptr) {
+            return nullptr;
+        }
+
+        if (IsNegation(node) && IsNegation(binary->GetLhs())
+            && IsNumeric(static_cast<const Mult&>(binary->GetLhs()).GetLhs())) {
+            // --x -> x
+            auto children = TakeChildren(node);
+            return std::move(TakeChildren(*children[0])[0]);
+        }
+
+        const bool is_add = dynamic_cast<const Add*>(&node) != nullptr;
+        if ((!is_add && dynamic_cast<const Sub*>(&node) == nullptr) || !IsNumeric(binary->GetLhs())
+            || !IsNegation(binary->GetRhs())
+            || !IsNumeric(static_cast<const Mult&>(binary->GetRhs()).GetLhs())) {
+            return nullptr;
+        }
+        // a + -b -> a - b, a - -b -> a + b
+        auto children = TakeChildren(node);
+        auto rhs = std::move(TakeChildren(*children[1])[0]);
+        if (is_add) {
+            return make_unique<Sub>(std::move(children[0]), std::move(rhs));
+        }
+        return make_unique<Add>(std::move(children[0]), std::move(rhs));
+    }
+
+    FoldStats stats_;
+    const Statement::ChildVisitor visit_ = [this](unique_ptr<Statement>& child) {
+        Visit(child);
+    };
+};
+
+}  // namespace
+
+FoldStats FoldConstants(unique_ptr<Statement>& root) {
+    // Новые константы размещаются рядом с остальными узлами программы
+    optional<Arena::Scope> arena_scope;
+    if (auto* program = dynamic_cast<Program*>(root.get())) {
+        arena_scope.emplace(program->GetArena());
+    }
+    return ConstantFolder{}.Fold(root);
+}
+
+}  // namespace ast
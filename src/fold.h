@@ -0,0 +1,25 @@
+#pragma once
+
+#include "statement.h"
+
+#include <memory>
+
+namespace ast {
+
+// Сведения о работе FoldConstants
+struct FoldStats {
+    // Число операций, которые были вычислены заранее и заменены константами
+    size_t folded = 0;
+    // Число упрощённых отрицаний: --x заменяется на x, a - -b на a + b, a + -b на a - b
+    size_t simplified_negations = 0;
+};
+
+/*
+ * Сворачивает константные выражения в дереве с корнем root, включая тела методов классов.
+ * Арифметика, конкатенация строк, сравнения, not, or и str над константами вычисляются
+ * один раз, а не при каждом выполнении. Операция, вычисление которой завершается ошибкой
+ * (например, деление на 0), остаётся в дереве и выбросит ту же ошибку при выполнении
+ */
+FoldStats FoldConstants(std::unique_ptr<Statement>& root);
+
+}  // namespace ast
@@ -0,0 +1,217 @@
+#include "gc.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+thread_local CycleCollector* current_collector = nullptr;
+
+}  // namespace
+
+CycleCollector::CycleCollector(Options options)
+    : options_(options) {
+}
+
+CycleCollector::~CycleCollector() {
+    Collect();
+    for (const auto& generation : generations_) {
+        for (ClassInstance* instance : generation) {
+            instance->collector_link_.collector = nullptr;
+        }
+    }
+}
+
+void CycleCollector::Track(ClassInstance& instance) {
+    auto& young = generations_[YOUNG];
+    instance.collector_link_.collector = this;
+    instance.collector_link_.generation = YOUNG;
+    instance.collector_link_.index = young.size();
+    young.push_back(&instance);
+
+    ++allocations_;
+    if (options_.threshold == 0 || allocations_ < options_.threshold) {
+        return;
+    }
+    const auto enough_growth = [this](size_t growth) {
+        return static_cast<double>(growth) >= static_cast<double>(survivors_) * options_.survivor_ratio;
+    };
+    if (!options_.generational) {
+        if (enough_growth(allocations_)) {
+            Collect();
+        }
+    } else if (young_collections_since_full_ + 1 >= options_.full_collection_interval
+               && enough_growth(generations_[OLD].size() - std::min(survivors_, generations_[OLD].size()))) {
+        Collect();
+    } else {
+        CollectYoung();
+    }
+}
+
+void CycleCollector::Untrack(ClassInstance& instance) {
+    auto& generation = generations_[instance.collector_link_.generation];
+    const size_t index = instance.collector_link_.index;
+    ClassInstance* last = generation.back();
+    generation[index] = last;
+    last->collector_link_.index = index;
+    generation.pop_back();
+    instance.collector_link_.collector = nullptr;
+}
+
+void CycleCollector::Promote() {
+    auto& young = generations_[YOUNG];
+    auto& old = generations_[OLD];
+    for (ClassInstance* instance : young) {
+        instance->collector_link_.generation = OLD;
+        instance->collector_link_.index = old.size();
+        old.push_back(instance);
+    }
+    young.clear();
+}
+
+size_t CycleCollector::Collect() {
+    if (collecting_) {
+        return 0;
+    }
+    collecting_ = true;
+    const auto start = chrono::steady_clock::now();
+
+    Promote();
+    const size_t collected = Sweep(OLD);
+    survivors_ = generations_[OLD].size();
+    young_collections_since_full_ = 0;
+
+    RecordPause(chrono::steady_clock::now() - start);
+    collecting_ = false;
+    return collected;
+}
+
+size_t CycleCollector::CollectYoung() {
+    if (collecting_) {
+        return 0;
+    }
+    collecting_ = true;
+    const auto start = chrono::steady_clock::now();
+
+    const size_t collected = Sweep(YOUNG);
+    Promote();
+    ++young_collections_since_full_;
+    ++stats_.young_collections;
+
+    RecordPause(chrono::steady_clock::now() - start);
+    collecting_ = false;
+    return collected;
+}
+
+void CycleCollector::RecordPause(chrono::steady_clock::duration duration) {
+    const auto pause = chrono::duration_cast<chrono::nanoseconds>(duration);
+    ++stats_.collections;
+    stats_.total_pause += pause;
+    stats_.max_pause = max(stats_.max_pause, pause);
+    stats_.last_pause = pause;
+    allocations_ = 0;
+}
+
+size_t CycleCollector::Sweep(size_t generation) {
+    const vector<ClassInstance*>& objects = generations_[generation];
+
+    // Вызывает visit для каждого экземпляра поколения, которым владеет поле instance
+    auto for_each_tracked_field = [this, generation](const ClassInstance& instance, auto visit) {
+        auto visit_holder = [this, generation, &visit](const ObjectHolder& field) {
+            if (field.IsOwner() && field.GetKind() == Kind::ClassInstance) {
+                const auto& link = static_cast<const ClassInstance&>(*field.Get()).collector_link_;
+                if (link.collector == this && link.generation == generation) {
+                    visit(link.index);
+                }
+            }
+        };
+        if (instance.dictionary_) {
+            for (const auto& [name, field] : *instance.dictionary_) {
+                visit_holder(field);
+            }
+        } else {
+            for (const ObjectHolder& field : instance.slots_) {
+                visit_holder(field);
+            }
+        }
+    };
+
+    // Ссылки извне: счётчик ссылок за вычетом ссылок из полей объектов поколения. Ссылки
+    // из других поколений остаются внешними
+    const size_t count = objects.size();
+    vector<size_t> external_refs(count);
+    for (size_t i = 0; i < count; ++i) {
+        external_refs[i] = objects[i]->GetRefCount();
+    }
+    for (const ClassInstance* instance : objects) {
+        for_each_tracked_field(*instance, [&external_refs](size_t target) {
+            --external_refs[target];
+        });
+    }
+
+    vector<bool> reachable(count);
+    vector<size_t> pending;
+    for (size_t i = 0; i < count; ++i) {
+        if (external_refs[i] != 0) {
+            reachable[i] = true;
+            pending.push_back(i);
+        }
+    }
+    while (!pending.empty()) {
+        const size_t i = pending.back();
+        pending.pop_back();
+        for_each_tracked_field(*objects[i], [&reachable, &pending](size_t target) {
+            if (!reachable[target]) {
+                reachable[target] = true;
+                pending.push_back(target);
+            }
+        });
+    }
+
+    // Значения полей недостижимых объектов переносятся в released, а поля становятся None.
+    // Перенос не меняет счётчики, поэтому до очистки released ни один объект не освобождается
+    // и objects не меняется. Классы объектов сборщику не нужны и к этому времени могут быть удалены
+    vector<ObjectHolder> released;
+    size_t collected = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (reachable[i]) {
+            continue;
+        }
+        ClassInstance& instance = *objects[i];
+        ++collected;
+        stats_.reclaimed_bytes += sizeof(ClassInstance) + instance.slots_.capacity() * sizeof(ObjectHolder);
+        if (instance.dictionary_) {
+            const Closure& fields = *instance.dictionary_;
+            stats_.reclaimed_bytes += sizeof(Closure) + fields.bucket_count() * sizeof(void*)
+                                      + fields.size() * (sizeof(Closure::value_type) + sizeof(void*));
+            for (auto& [name, field] : *instance.dictionary_) {
+                released.push_back(std::move(field));
+            }
+        } else {
+            move(instance.slots_.begin(), instance.slots_.end(), back_inserter(released));
+        }
+    }
+    released.clear();
+
+    stats_.collected_objects += collected;
+    return collected;
+}
+
+CycleCollector* CycleCollector::Current() {
+    return current_collector;
+}
+
+CycleCollector::Scope::Scope(CycleCollector& collector)
+    : previous_(current_collector) {
+    current_collector = &collector;
+}
+
+CycleCollector::Scope::~Scope() {
+    current_collector = previous_;
+}
+
+}  // namespace runtime
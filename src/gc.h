@@ -0,0 +1,146 @@
+#pragma once
+
+#include "runtime.h"
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace runtime {
+
+// Статистика работы сборщика циклов
+struct GcStats {
+    // Число выполненных сборок, в том числе сборок только молодого поколения
+    size_t collections = 0;
+    size_t young_collections = 0;
+    // Число удалённых объектов, ссылавшихся друг на друга по кругу
+    size_t collected_objects = 0;
+    // Оценка освобождённой памяти: сами объекты, их слоты и словари полей
+    size_t reclaimed_bytes = 0;
+    // Суммарная, наибольшая и последняя длительность сборки. На время сборки программа
+    // останавливается
+    std::chrono::nanoseconds total_pause{0};
+    std::chrono::nanoseconds max_pause{0};
+    std::chrono::nanoseconds last_pause{0};
+};
+
+/*
+ * Сборщик циклических ссылок между экземплярами классов. Счётчики ссылок не освобождают
+ * объекты, которые ссылаются друг на друга через поля, например узел дерева и его родителя.
+ *
+ * Пока существует CycleCollector::Scope, сборщик отслеживает экземпляры, которые поток
+ * помещает в кучу (ObjectHolder::Own). Сборка работает как в CPython: из счётчика ссылок
+ * каждого объекта вычитаются ссылки из полей других отслеживаемых объектов. Объекты, у которых
+ * что-то осталось, достижимы извне, например из переменных или стека виртуальной машины,
+ * как и всё, что достижимо из них по полям. Поля остальных объектов очищаются, и счётчики
+ * ссылок освобождают их.
+ *
+ * Сборке не нужно сканировать корни (переменные, кадры виртуальной машины, константы программы)
+ * и перехватывать записи в поля: ссылки из них уже учтены в счётчиках ссылок.
+ * Невладеющие ссылки (ObjectHolder::Share) объект не удерживают, как и без сборщика.
+ *
+ * В режиме поколений (Options::generational) новые объекты попадают в молодое поколение,
+ * а пережившие его сборку переходят в старое. Автоматическая сборка обходит только молодое
+ * поколение, считая ссылки из старых объектов внешними, и лишь каждая full_collection_interval
+ * сборка обходит всю кучу. Большинство объектов живёт недолго, поэтому сборки не обходят
+ * раз за разом долгоживущие объекты. Циклы, проходящие через старое поколение, собираются
+ * полной сборкой.
+ *
+ * Сборщик и его объекты используются одним потоком (см. ObjectHolder)
+ */
+class CycleCollector {
+public:
+    struct Options {
+        // Сборка запускается, когда с предыдущей сборки отслеживается столько новых объектов.
+        // 0 отключает автоматическую сборку
+        size_t threshold = 1000;
+        // Полная сборка запускается, только если новые объекты (в режиме поколений - объекты,
+        // перешедшие в старое поколение) составляют не меньше такой доли объектов, переживших
+        // предыдущую полную сборку. Это не даёт многократно обходить долгоживущие объекты
+        double survivor_ratio = 0.25;
+        // Разделять объекты на молодое и старое поколения
+        bool generational = false;
+        // В режиме поколений полной сборкой может стать только каждая такая автоматическая сборка
+        size_t full_collection_interval = 10;
+    };
+
+    CycleCollector() = default;
+    explicit CycleCollector(Options options);
+    CycleCollector(const CycleCollector&) = delete;
+    CycleCollector& operator=(const CycleCollector&) = delete;
+
+    // Собирает оставшиеся циклы и перестаёт отслеживать уцелевшие объекты
+    ~CycleCollector();
+
+    // Удаляет недостижимые циклы во всей куче и возвращает число удалённых объектов
+    size_t Collect();
+    // Удаляет недостижимые циклы из объектов молодого поколения, а уцелевшие объекты переводит
+    // в старое. Возвращает число удалённых объектов
+    size_t CollectYoung();
+
+    [[nodiscard]] const GcStats& GetStats() const {
+        return stats_;
+    }
+
+    // Возвращает число отслеживаемых объектов
+    [[nodiscard]] size_t GetTrackedCount() const {
+        return generations_[YOUNG].size() + generations_[OLD].size();
+    }
+    // Возвращает число объектов молодого поколения
+    [[nodiscard]] size_t GetYoungCount() const {
+        return generations_[YOUNG].size();
+    }
+
+    [[nodiscard]] const Options& GetOptions() const {
+        return options_;
+    }
+    void SetOptions(Options options) {
+        options_ = options;
+    }
+
+    // Возвращает сборщик, которому текущий поток передаёт новые объекты, либо nullptr
+    static CycleCollector* Current();
+
+    // Делает сборщик текущим для потока на время своего существования
+    class Scope {
+    public:
+        explicit Scope(CycleCollector& collector);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+    private:
+        CycleCollector* previous_;
+    };
+
+private:
+    friend class ObjectHolder;
+    friend class ClassInstance;
+
+    static constexpr size_t YOUNG = 0;
+    static constexpr size_t OLD = 1;
+
+    // Начинает отслеживать объект, только что помещённый в кучу
+    void Track(ClassInstance& instance);
+    void Untrack(ClassInstance& instance);
+    // Переводит объекты молодого поколения в старое
+    void Promote();
+    // Удаляет недостижимые циклы из объектов поколения generation
+    size_t Sweep(size_t generation);
+    // Учитывает в статистике сборку, длившуюся duration
+    void RecordPause(std::chrono::steady_clock::duration duration);
+
+    Options options_;
+    // Объекты молодого и старого поколений. Вне режима поколений объекты переходят
+    // в старое поколение только перед полной сборкой
+    std::vector<ClassInstance*> generations_[2];
+    // Число объектов, отслеживаемых с предыдущей сборки, число переживших предыдущую полную
+    // сборку и число сборок молодого поколения после неё
+    size_t allocations_ = 0;
+    size_t survivors_ = 0;
+    size_t young_collections_since_full_ = 0;
+    bool collecting_ = false;
+    GcStats stats_;
+};
+
+}  // namespace runtime
@@ -1,7 +1,10 @@
 #include "lexer.h"
+#include "scan.h"
 
 #include <algorithm>
+#include <array>
 #include <charconv>
+#include <cstdint>
 #include <unordered_map>
 
 using namespace std;
@@ -75,100 +78,250 @@ namespace parse {
 		return os << "Unknown token :("sv;
 	}
 
-	Lexer::Lexer(std::istream& input) {
+	namespace {
+
+		struct Keyword {
+			std::string_view text;
+			Token token;
+		};
+
+		// Ключевые слова и составные операторы, которые CreateToken отличает от идентификаторов
+		constexpr Keyword KEYWORDS[] = {
+			{ "class"sv, token_type::Class{} },
+			{ "def"sv, token_type::Def{} },
+			{ "True"sv, token_type::True{} },
+			{ "False"sv, token_type::False{} },
+			{ "None"sv, token_type::None{} },
+			{ "if"sv, token_type::If{} },
+			{ "else"sv, token_type::Else{} },
+			{ "and"sv, token_type::And{} },
+			{ "or"sv, token_type::Or{} },
+			{ "not"sv, token_type::Not{} },
+			{ "print"sv, token_type::Print{} },
+			{ "return"sv, token_type::Return{} },
+			{ "=="sv, token_type::Eq{} },
+			{ "<="sv, token_type::LessOrEq{} },
+			{ ">="sv, token_type::GreaterOrEq{} },
+			{ "!="sv, token_type::NotEq{} },
+		};
+
+		constexpr size_t KEYWORD_TABLE_SIZE = 32;
+		// Самые короткие ключевые слова — «if» и «==», самое длинное — «return»
+		constexpr size_t MIN_KEYWORD_SIZE = 2;
+		constexpr size_t MAX_KEYWORD_SIZE = 6;
+
+		// Совершенная для KEYWORDS хеш-функция: первый и последний символы вместе с длиной
+		// различают все ключевые слова. Отсутствие коллизий проверяется при компиляции
+		constexpr size_t KeywordHash(std::string_view word) {
+			return (static_cast<unsigned char>(word.front()) + static_cast<unsigned char>(word.back()) * 26u
+				+ word.size()) % KEYWORD_TABLE_SIZE;
+		}
+
+		constexpr uint64_t CharAt(std::string_view word, size_t pos) {
+			return static_cast<unsigned char>(word[pos]);
+		}
+
+		// Возвращают 2 и 4 символа слова word, начиная с позиции pos, упакованные в одно число.
+		// Компилятор объединяет такие побайтовые чтения в одно чтение из памяти
+		constexpr uint64_t Load2Chars(std::string_view word, size_t pos) {
+			return CharAt(word, pos) | CharAt(word, pos + 1) << 8;
+		}
+
+		constexpr uint64_t Load4Chars(std::string_view word, size_t pos) {
+			return CharAt(word, pos) | CharAt(word, pos + 1) << 8 | CharAt(word, pos + 2) << 16
+				| CharAt(word, pos + 3) << 24;
+		}
+
+		// Упаковывает слово длиной от 2 до 8 символов в одно число, чтобы сравнивать слова одной
+		// операцией. Начало и конец слова перекрываются и вместе покрывают все его символы,
+		// поэтому слова одной длины упаковываются в разные числа
+		constexpr uint64_t PackWord(std::string_view word) {
+			if (word.size() >= 4) {
+				return Load4Chars(word, 0) | Load4Chars(word, word.size() - 4) << 32;
+			}
+			return Load2Chars(word, 0) | Load2Chars(word, word.size() - 2) << 16;
+		}
+
+		struct KeywordSlot {
+			// Упакованное ключевое слово, хеш которого равен номеру ячейки, либо 0
+			uint64_t packed_word = 0;
+			// Длина ключевого слова. Позволяет отбросить большинство идентификаторов без упаковки
+			size_t size = 0;
+			const Token* token = nullptr;
+		};
+
+		constexpr std::array<KeywordSlot, KEYWORD_TABLE_SIZE> MakeKeywordTable() {
+			std::array<KeywordSlot, KEYWORD_TABLE_SIZE> table{};
+			for (const Keyword& keyword : KEYWORDS) {
+				KeywordSlot& slot = table[KeywordHash(keyword.text)];
+				if (slot.token != nullptr) {
+					// При вычислении на этапе компиляции исключение превращается в ошибку компиляции
+					throw std::logic_error("Keyword hash collision");
+				}
+				slot = { PackWord(keyword.text), keyword.text.size(), &keyword.token };
+			}
+			return table;
+		}
+
+		constexpr std::array<KeywordSlot, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = MakeKeywordTable();
+
+	}  // namespace
+
+	const Token* FindKeyword(std::string_view word) {
+		if (word.size() < MIN_KEYWORD_SIZE || word.size() > MAX_KEYWORD_SIZE) {
+			return nullptr;
+		}
+		const KeywordSlot& slot = KEYWORD_TABLE[KeywordHash(word)];
+		if (slot.size != word.size()) {
+			return nullptr;
+		}
+		return slot.packed_word == PackWord(word) ? slot.token : nullptr;
+	}
+
+	Lexer::Lexer(std::istream& input) : input_(&input) {
+		ReadLine();
+	}
+
+	Lexer::Lexer(std::string_view source) : source_(source) {
+		ReadLine();
+	}
 
-		std::string buffer;
+	bool Lexer::ReadChar(char& ch) {
+		const auto code = input_->get();
+		if (code == std::istream::traits_type::eof()) {
+			return false;
+		}
+		ch = static_cast<char>(code);
+		return true;
+	}
+
+	bool Lexer::ReadRawLine(std::string_view& line) {
+
+		if (input_ == nullptr) {
+			return ReadSourceLine(line);
+		}
+
+		line_.clear();
+		size_t line_size = 0;
 		bool is_string_now = false;
-		char type_quote;
+		bool is_escaped = false;
+		char type_quote = 0;
+		bool line_ended = false;
 
-		while (input) {
-			char s = input.get();
-			if (buffer.empty() && s == '\n') {
+		char ch;
+		while (ReadChar(ch)) {
+			if (line_size == 0 && ch == '\n') {
 				continue;
 			}
 
-			if (is_string_now) {
-
-				if (s == '\\') {
-					char next_s = input.get();
-
-					switch (next_s) {
-					case 'n':
-						buffer.push_back('\n');
-						break;
-					case 't':
-						buffer.push_back('\t');
-						break;
-					case '\\':
-						buffer.push_back('\\');
-						break;
-					case 'r':
-						buffer.push_back('\r');
-						break;
-					case '"':
-						buffer.push_back('"');
-						break;
-					case '\'':
-						buffer.push_back('\'');
-						break;
-					default:
-						break;
-					}
-					continue;
+			if (!is_string_now && ch == '\n') {
+				line_ended = true;
+				break;
+			}
+			if (!is_string_now && ch == '#') {
+				while (ReadChar(ch) && ch != '\n') {
+				}
+				if (line_size != 0) {
+					line_ended = true;
+					break;
 				}
+				continue;
+			}
 
-				buffer.push_back(s);
-				if (s == type_quote) {
+			line_.push_back(ch);
+			++line_size;
+
+			if (is_string_now) {
+				if (is_escaped) {
+					is_escaped = false;
+				}
+				else if (ch == '\\') {
+					is_escaped = true;
+				}
+				else if (ch == type_quote) {
 					is_string_now = false;
-					type_quote = 0;
 				}
 			}
-			else if (s == '\'' || s == '\"') {
+			else if (ch == '\'' || ch == '\"') {
 				is_string_now = true;
-				type_quote = s;
-				buffer.push_back(s);
+				type_quote = ch;
 			}
-			else if (s == '\n') {
-				ParseString(buffer);
-				tokens_set_.push_back(token_type::Newline{});
-				buffer.clear();
+		}
+
+		line = line_;
+		return line_ended;
+	}
+
+	bool Lexer::ReadSourceLine(std::string_view& line) {
+
+		const size_t size = source_.size();
+		size_t pos = source_pos_;
+
+		// Пропускаем пустые строки и строки, начинающиеся с комментария
+		while (pos < size && (source_[pos] == '\n' || source_[pos] == '#')) {
+			pos = source_[pos] == '#' ? FindFirstOf(source_, pos, '\n', '\n', '\n', '\n') : pos + 1;
+		}
+
+		// Символы строки идут в source_ подряд: комментарий и перевод строки её завершают.
+		// Внутри строковой константы они относятся к её значению
+		const size_t line_start = pos;
+		while (pos < size) {
+			pos = FindFirstOf(source_, pos, '\n', '#', '\'', '"');
+			if (pos == size) {
+				break;
 			}
-			else if (s == '#') {
-				if (!buffer.empty()) {
-					ParseString(buffer);
-					tokens_set_.push_back(token_type::Newline{});
-					buffer.clear();
-				}
-				if (input) {
-					char cm = input.get();
-					while (input && cm != '\n') {
-						cm = input.get();
-					}
-				}
+			const char ch = source_[pos];
+			if (ch == '\n') {
+				line = source_.substr(line_start, pos - line_start);
+				source_pos_ = pos + 1;
+				return true;
 			}
-			else {
-				if (!input) {
-					ParseString(buffer);
-					buffer.clear();
+			if (ch == '#') {
+				line = source_.substr(line_start, pos - line_start);
+				const size_t comment_end = FindFirstOf(source_, pos, '\n', '\n', '\n', '\n');
+				source_pos_ = std::min(comment_end + 1, size);
+				return true;
+			}
+
+			// Ищем закрывающую кавычку, перескакивая экранированные символы
+			++pos;
+			while (pos < size) {
+				pos = FindFirstOf(source_, pos, ch, '\\', ch, ch);
+				if (pos == size) {
 					break;
 				}
-				buffer.push_back(s);
+				if (source_[pos] == ch) {
+					++pos;
+					break;
+				}
+				pos = std::min(pos + 2, size);
 			}
-
 		}
 
-		if (!buffer.empty()) {
-			ParseString(buffer);
+		line = source_.substr(line_start, size - line_start);
+		source_pos_ = size;
+		return false;
+	}
+
+	void Lexer::ReadLine() {
+
+		// Все токены предыдущей строки уже прочитаны, поэтому её данные больше не нужны
+		unescaped_strings_.clear();
+
+		std::string_view line;
+		const bool line_ended = ReadRawLine(line);
+		ParseString(line);
+		if (line_ended) {
+			tokens_set_.push_back(token_type::Newline{});
+			return;
 		}
 
+		// Предыдущие строки всегда завершаются токеном Newline, поэтому его нужно добавить,
+		// только если последняя строка программы не закончилась переводом строки
 		if (!tokens_set_.empty()) {
-			const Token& last_token = tokens_set_.back();
-			if (!last_token.Is<token_type::Newline>()) {
-				tokens_set_.push_back(token_type::Newline{});
-			}
+			tokens_set_.push_back(token_type::Newline{});
 		}
 
-
 		while (pos_new_line_ > 0) {
 			tokens_set_.push_back(token_type::Dedent{});
 			indents_--;
@@ -176,62 +329,17 @@ namespace parse {
 		}
 
 		tokens_set_.push_back(token_type::Eof{});
-
+		input_finished_ = true;
 	}
 
-	void Lexer::CreateToken(std::string& buffer) {
+	void Lexer::CreateToken(std::string_view buffer) {
 
 		if (buffer.empty()) {
 			return;
 		}
 
-		if (buffer == "class"s) {
-			tokens_set_.push_back(Token(token_type::Class{}));
-		}
-		else if (buffer == "def"s) {
-			tokens_set_.push_back(Token(token_type::Def{}));
-		}
-		else if (buffer == "True"s) {
-			tokens_set_.push_back(Token(token_type::True{}));
-		}
-		else if (buffer == "False"s) {
-			tokens_set_.push_back(Token(token_type::False{}));
-		}
-		else if (buffer == "None"s) {
-			tokens_set_.push_back(Token(token_type::None{}));
-		}
-		else if (buffer == "if"s) {
-			tokens_set_.push_back(Token(token_type::If{}));
-		}
-		else if (buffer == "else"s) {
-			tokens_set_.push_back(Token(token_type::Else{}));
-		}
-		else if (buffer == "and"s) {
-			tokens_set_.push_back(Token(token_type::And{}));
-		}
-		else if (buffer == "or"s) {
-			tokens_set_.push_back(Token(token_type::Or{}));
-		}
-		else if (buffer == "not"s) {
-			tokens_set_.push_back(Token(token_type::Not{}));
-		}
-		else if (buffer == "print"s) {
-			tokens_set_.push_back(Token(token_type::Print{}));
-		}
-		else if (buffer == "=="s) {
-			tokens_set_.push_back(Token(token_type::Eq{}));
-		}
-		else if (buffer == "<="s) {
-			tokens_set_.push_back(Token(token_type::LessOrEq{}));
-		}
-		else if (buffer == ">="s) {
-			tokens_set_.push_back(Token(token_type::GreaterOrEq{}));
-		}
-		else if (buffer == "!="s) {
-			tokens_set_.push_back(Token(token_type::NotEq{}));
-		}
-		else if (buffer == "return"s) {
-			tokens_set_.push_back(Token(token_type::Return{}));
+		if (const Token* keyword = FindKeyword(buffer)) {
+			tokens_set_.push_back(*keyword);
 		}
 		else {
 			char first_symbol = buffer[0];
@@ -239,10 +347,11 @@ namespace parse {
 				tokens_set_.push_back(Token(token_type::Id{ buffer }));
 			}
 			else if (is_digit(buffer)) {
-				tokens_set_.push_back(Token(token_type::Number{ std::stoi(buffer) }));
-			}
-			else if (first_symbol == '\"' || first_symbol == '\'') {
-				tokens_set_.push_back(Token(token_type::String{ std::string(buffer.begin() + 1, buffer.end() - 1) }));
+				int value = 0;
+				if (std::from_chars(buffer.data(), buffer.data() + buffer.size(), value).ec != std::errc{}) {
+					throw LexerError("Number "s + std::string(buffer) + " is out of range"s);
+				}
+				tokens_set_.push_back(Token(token_type::Number{ value }));
 			}
 			else {
 				for (char ch : buffer) {
@@ -252,110 +361,121 @@ namespace parse {
 		}
 	}
 
-	void Lexer::ParseString(std::string& buffer) {
+	void Lexer::ParseString(std::string_view line) {
 
-		std::string substr;
+		// Лексема, которая накапливается в данный момент, — это подстрока line
+		size_t token_start = 0;
+		size_t token_size = 0;
 		int spaces = 0;
-		int position = -1;
-		bool is_string_now = false;
-		char type_quote;
-
-		for (size_t i = 0; i < buffer.size(); ++i) {
-			char ch = buffer[i];
-			position++;
 
-			if (is_string_now) {
-
-				if (ch == '\\') {
-					char next_ch = buffer[i + 1];
-
-					switch (next_ch) {
-					case 'n':
-						buffer.push_back('\n');
-						break;
-					case 't':
-						buffer.push_back('\t');
-						break;
-					case '\\':
-						buffer.push_back('\\');
-						break;
-					case 'r':
-						buffer.push_back('\r');
-						break;
-					case '"':
-						buffer.push_back('"');
-						break;
-					case '\'':
-						buffer.push_back('\'');
-						break;
-					default:
-						break;
-					}
-					continue;
-				}
-
-				substr.push_back(ch);
-				if (ch == type_quote) {
-					is_string_now = false;
-					type_quote = 0;
-				}
+		auto create_token = [&] {
+			if (token_size != 0) {
+				CreateToken(line.substr(token_start, token_size));
+				token_size = 0;
 			}
-			else if (ch == '\'' || ch == '\"') {
-				if (i < (buffer.size() - 1)) {
-					char next_ch = buffer[i + 1];
-					if (next_ch != '\\') {
-						is_string_now = true;
-						type_quote = ch;
-					}
+		};
+
+		for (size_t i = 0; i < line.size(); ++i) {
+			char ch = line[i];
+			const int position = static_cast<int>(i);
+
+			if (ch == '\'' || ch == '\"') {
+				create_token();
+				size_t end = FindFirstOf(line, i + 1, ch, '\\', ch, ch);
+				bool has_escapes = false;
+				while (end < line.size() && line[end] != ch) {
+					has_escapes = true;
+					end = FindFirstOf(line, end + 2, ch, '\\', ch, ch);
 				}
-
-				substr.push_back(ch);
+				if (end >= line.size()) {
+					throw LexerError("Unterminated string literal"s);
+				}
+				AddStringToken(line.substr(i + 1, end - i - 1), has_escapes);
+				i = end;
 			}
 			else if (is_math_symbol(ch)) {
-				if (!substr.empty()) {
-					CreateToken(substr);
-					substr.clear();
-				}
+				create_token();
 				tokens_set_.push_back(token_type::Char{ ch });
 			}
-			else if (ch == ' ' && substr.size() == 0) {
-				spaces++;
-			}
-			else if (ch == ' ' && substr.size() != 0) {
-				CreateToken(substr);
-				substr.clear();
+			else if (ch == ' ') {
+				// Пробелы считаются, чтобы определить отступ строки: он равен их числу,
+				// если до позиции лексемы других символов нет
+				create_token();
+				const size_t spaces_end = FindFirstNot(line, i, ' ');
+				spaces += static_cast<int>(spaces_end - i);
+				i = spaces_end - 1;
 			}
 			else if (ch == ':' || ch == '(' || ch == ')' || ch == ',' || ch == '.') {
-				if (substr.size() != 0) {
-					CreateToken(substr);
-					substr.clear();
-				}
+				create_token();
 				tokens_set_.push_back(token_type::Char{ ch });
 			}
 			else {
-				if (substr.empty() && InsertIndent(spaces, position)) {
+				if (token_size == 0 && InsertIndent(spaces, position)) {
 					while ((position - pos_new_line_) > 0) {
 						tokens_set_.push_back(token_type::Indent{});
 						indents_++;
 						UpdatePosNewLine();
 					}
 				}
-				else if (substr.empty() && InsertDedent(spaces, position)) {
+				else if (token_size == 0 && InsertDedent(spaces, position)) {
 					while ((pos_new_line_ - position) > 0) {
 						tokens_set_.push_back(token_type::Dedent{});
 						indents_--;
 						UpdatePosNewLine();
 					}
 				}
-				substr.push_back(ch);
+				if (token_size == 0) {
+					token_start = i;
+				}
+				token_size++;
 			}
 
 		}
 
-		if (!substr.empty()) {
-			CreateToken(substr);
+		create_token();
+
+	}
+
+	void Lexer::AddStringToken(std::string_view literal, bool has_escapes) {
+
+		if (!has_escapes) {
+			tokens_set_.push_back(token_type::String{ literal });
+			return;
 		}
 
+		std::string& value = unescaped_strings_.emplace_back();
+		value.reserve(literal.size());
+		for (size_t i = 0; i < literal.size(); ++i) {
+			if (literal[i] != '\\') {
+				value.push_back(literal[i]);
+				continue;
+			}
+
+			// Строка не может заканчиваться одиночной обратной косой чертой: она экранировала бы кавычку
+			switch (literal[++i]) {
+			case 'n':
+				value.push_back('\n');
+				break;
+			case 't':
+				value.push_back('\t');
+				break;
+			case '\\':
+				value.push_back('\\');
+				break;
+			case 'r':
+				value.push_back('\r');
+				break;
+			case '"':
+				value.push_back('"');
+				break;
+			case '\'':
+				value.push_back('\'');
+				break;
+			default:
+				break;
+			}
+		}
+		tokens_set_.push_back(token_type::String{ value });
 	}
 
 	bool Lexer::InsertIndent(int spaces, int position) {
@@ -377,30 +497,27 @@ namespace parse {
 	}
 
 	const Token& Lexer::CurrentToken() const {
-		if (tokens_set_.empty()) {
-			throw std::logic_error("Not implemented"s);
-		}
-		return tokens_set_[curr_token_];
-
+		return tokens_set_.front();
 	}
 
 	Token Lexer::NextToken() {
-		if (tokens_set_.empty()) {
-			throw std::logic_error("Not implemented"s);
+		// Eof остаётся текущим токеном при повторных вызовах
+		if (input_finished_ && tokens_set_.size() == 1) {
+			return tokens_set_.front();
 		}
-		if (tokens_set_.size() == curr_token_ + 1) {
-			return token_type::Eof{};
+		tokens_set_.pop_front();
+		if (tokens_set_.empty()) {
+			ReadLine();
 		}
-		curr_token_++;
-		return tokens_set_[curr_token_];
+		return tokens_set_.front();
 	}
 
 	bool is_alpha(char ch) {
 		return std::isalpha(static_cast<unsigned char>(ch));
 	}
 
-	bool is_digit(const std::string& str) {
-		return str.find_first_not_of("0123456789") == std::string::npos;
+	bool is_digit(std::string_view str) {
+		return str.find_first_not_of("0123456789"sv) == std::string_view::npos;
 	}
 
 	bool is_math_symbol(char ch) {
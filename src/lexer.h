@@ -1,23 +1,29 @@
 #pragma once
 
 #include <cctype>
+#include <deque>
 #include <iosfwd>
 #include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 namespace parse {
 
+    /*
+     * Значения идентификаторов и строковых констант ссылаются на текст программы либо на
+     * буфер лексера и действительны, пока лексер не перешёл к следующей строке программы
+     */
     namespace token_type {
         struct Number {  // Лексема «число»
             int value;   // число
         };
 
-        struct Id {             // Лексема «идентификатор»
-            std::string value;  // Имя идентификатора
+        struct Id {                  // Лексема «идентификатор»
+            std::string_view value;  // Имя идентификатора
         };
 
         struct Char {    // Лексема «символ»
@@ -25,7 +31,7 @@ namespace parse {
         };
 
         struct String {  // Лексема «строковая константа»
-            std::string value;
+            std::string_view value;
         };
 
         struct Class {};    // Лексема «class»
@@ -87,9 +93,19 @@ namespace parse {
         using std::runtime_error::runtime_error;
     };
 
+    /*
+     * Лексер читает программу по мере запроса токенов: очередная логическая строка программы
+     * разбирается, только когда парсер дошёл до её начала. Поэтому в памяти хранятся лишь токены
+     * текущей строки, а источник программы должен существовать, пока используется лексер
+     */
     class Lexer {
     public:
+        // Читает программу из потока. Каждая строка программы копируется в буфер лексера
         explicit Lexer(std::istream& input);
+        // Читает программу, целиком находящуюся в памяти (например, в отображённом в память файле).
+        // Идентификаторы и строковые константы ссылаются прямо на source; копируются только
+        // строковые константы с escape-последовательностями
+        explicit Lexer(std::string_view source);
 
         // Возвращает ссылку на текущий токен или token_type::Eof, если поток токенов закончился
         [[nodiscard]] const Token& CurrentToken() const;
@@ -148,21 +164,47 @@ namespace parse {
         }
 
     private:
-        // Реализуйте приватную часть самостоятельно
-        std::vector<Token> tokens_set_;
+        // Поток, из которого читается программа, либо nullptr, если программа находится в source_
+        std::istream* input_ = nullptr;
+        std::string_view source_;
+        size_t source_pos_ = 0;
+        // Текущая строка программы, прочитанная из потока input_
+        std::string line_;
+        // Строковые константы текущей строки после замены escape-последовательностей.
+        // В deque ссылки на уже добавленные строки не меняются
+        std::deque<std::string> unescaped_strings_;
+        // Ещё не прочитанные парсером токены текущей строки. Первый из них — текущий токен
+        std::deque<Token> tokens_set_;
         size_t indents_ = 0;
         int pos_new_line_ = indents_ * 2;
-        size_t curr_token_ = 0;
-
-        void CreateToken(std::string& buffer);
-        void ParseString(std::string& buffer);
+        // Программа прочитана до конца, и в tokens_set_ добавлены завершающие токены
+        bool input_finished_ = false;
+
+        // Читает следующий символ программы из потока. Возвращает false, если поток закончился
+        bool ReadChar(char& ch);
+        // Читает следующую непустую логическую строку программы без перевода строки и комментария.
+        // Возвращает false, если программа закончилась, не дойдя до конца строки
+        bool ReadRawLine(std::string_view& line);
+        // То же для программы в памяти: ищет границы строки векторными функциями из scan.h
+        bool ReadSourceLine(std::string_view& line);
+        // Читает следующую логическую строку и добавляет её токены в tokens_set_.
+        // В конце программы добавляет завершающие токены вплоть до Eof
+        void ReadLine();
+        void CreateToken(std::string_view buffer);
+        void ParseString(std::string_view line);
+        // Добавляет токен строковой константы, заменяя в ней escape-последовательности
+        void AddStringToken(std::string_view literal, bool has_escapes);
         bool InsertIndent(int spaces, int position);
         bool InsertDedent(int spaces, int position);
         void UpdatePosNewLine();
 
     };
 
+    // Возвращает токен ключевого слова или составного оператора word (например, «class» или «==»)
+    // либо nullptr, если word не является ключевым словом. Работает за O(1) без выделения памяти
+    const Token* FindKeyword(std::string_view word);
+
     bool is_alpha(char ch);
-    bool is_digit(const std::string& str);
+    bool is_digit(std::string_view str);
     bool is_math_symbol(char ch);
 }  // namespace parse
\ No newline at end of file
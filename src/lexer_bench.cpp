@@ -0,0 +1,225 @@
+#include "bench_runner_p.h"
+#include "lexer.h"
+#include "scan.h"
+
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace parse {
+
+namespace {
+
+// Возвращает программу из line_count строк с присваиваниями, вызовами и выводом
+string MakeProgram(size_t line_count) {
+    string program;
+    for (size_t i = 0; i < line_count; i += 4) {
+        const string var = "value"s + to_string(i);
+        program += "class Item"s + to_string(i) + ":\n"s;
+        program += "  def get(n):\n"s;
+        program += "    return n * 2 + 'text' # comment\n"s;
+        program += var + " = Item"s + to_string(i) + "().get(" + to_string(i) + ")\nprint "s + var + ", 'done'\n"s;
+    }
+    return program;
+}
+
+// Читает все токены лексера и возвращает их количество
+size_t LexAll(Lexer& lexer) {
+    size_t token_count = 1;
+    while (!lexer.CurrentToken().Is<token_type::Eof>()) {
+        lexer.NextToken();
+        ++token_count;
+    }
+    return token_count;
+}
+
+// Лексер читает токены по мере надобности, поэтому расход памяти не должен расти вместе с программой.
+// Из потока каждая строка копируется в буфер лексера, а программу в памяти лексер не копирует
+void BenchLexer(BenchRunner& br) {
+    for (size_t line_count : {1'000, 10'000, 100'000}) {
+        const string program = MakeProgram(line_count);
+        const string suffix = " "s + to_string(line_count) + " lines"s;
+
+        const double stream_ns = br.Run("lex from stream,"s + suffix, 5, [&] {
+            istringstream input(program);
+            Lexer lexer(input);
+            DoNotOptimize(LexAll(lexer));
+        });
+        const double memory_ns = br.Run("lex from memory,"s + suffix, 5, [&] {
+            Lexer lexer{string_view(program)};
+            DoNotOptimize(LexAll(lexer));
+        });
+
+        istringstream input(program);
+        size_t token_count = 0;
+        const size_t stream_peak = MeasurePeakBytes([&] {
+            Lexer lexer(input);
+            token_count = LexAll(lexer);
+        });
+        const size_t memory_peak = MeasurePeakBytes([&] {
+            Lexer lexer{string_view(program)};
+            DoNotOptimize(LexAll(lexer));
+        });
+        cout << "  "s << token_count << " tokens; ns/token: stream "s << stream_ns / token_count
+             << ", memory "s << memory_ns / token_count << "; peak memory: stream "s << stream_peak
+             << " bytes, memory "s << memory_peak << " bytes"s << endl;
+    }
+}
+
+// Текст, почти все слова которого — ключевые слова, а остальные — похожие на них идентификаторы
+const string KEYWORD_CORPUS = R"(class Printer(Base):
+  def print_if(value, other):
+    if not value and other or True != False:
+      return None
+    else:
+      print value, other, classic, define, returned, nothing, android, origin
+    if value == other or value <= 1 and other >= 2:
+      return True
+    return False
+)"s;
+
+void BenchKeywords(BenchRunner& br) {
+    string corpus;
+    for (int i = 0; i < 1000; ++i) {
+        corpus += KEYWORD_CORPUS;
+    }
+    Lexer counter{string_view(corpus)};
+    const size_t token_count = LexAll(counter);
+
+    const double ns = br.Run("lex keyword-dense corpus"s, 20, [&] {
+        Lexer lexer{string_view(corpus)};
+        DoNotOptimize(LexAll(lexer));
+    });
+    cout << "  "s << token_count << " tokens, "s << ns / token_count << " ns/token"s << endl;
+}
+
+// Прежний способ распознавания ключевых слов: последовательное сравнение со всеми словами
+const Token* FindKeywordByComparison(string_view word) {
+    static const Token class_token = token_type::Class{}, def_token = token_type::Def{},
+                       true_token = token_type::True{}, false_token = token_type::False{},
+                       none_token = token_type::None{}, if_token = token_type::If{},
+                       else_token = token_type::Else{}, and_token = token_type::And{},
+                       or_token = token_type::Or{}, not_token = token_type::Not{},
+                       print_token = token_type::Print{}, eq_token = token_type::Eq{},
+                       less_or_eq_token = token_type::LessOrEq{},
+                       greater_or_eq_token = token_type::GreaterOrEq{},
+                       not_eq_token = token_type::NotEq{}, return_token = token_type::Return{};
+
+    if (word == "class"sv) return &class_token;
+    if (word == "def"sv) return &def_token;
+    if (word == "True"sv) return &true_token;
+    if (word == "False"sv) return &false_token;
+    if (word == "None"sv) return &none_token;
+    if (word == "if"sv) return &if_token;
+    if (word == "else"sv) return &else_token;
+    if (word == "and"sv) return &and_token;
+    if (word == "or"sv) return &or_token;
+    if (word == "not"sv) return &not_token;
+    if (word == "print"sv) return &print_token;
+    if (word == "=="sv) return &eq_token;
+    if (word == "<="sv) return &less_or_eq_token;
+    if (word == ">="sv) return &greater_or_eq_token;
+    if (word == "!="sv) return &not_eq_token;
+    if (word == "return"sv) return &return_token;
+    return nullptr;
+}
+
+// Сравнивает распознавание отдельных слов корпуса без остальной работы лексера
+void BenchKeywordLookup(BenchRunner& br) {
+    vector<string_view> words;
+    for (size_t begin = 0; begin < KEYWORD_CORPUS.size();) {
+        const size_t end = KEYWORD_CORPUS.find_first_of(" \n(),:"sv, begin);
+        if (end != begin) {
+            words.push_back(string_view(KEYWORD_CORPUS).substr(begin, end - begin));
+        }
+        if (end == string::npos) {
+            break;
+        }
+        begin = end + 1;
+    }
+
+    // Обе функции вызываются через указатель, чтобы компилятор не вынес поиск из цикла замера
+    using Finder = const Token* (*)(string_view);
+    auto lookup_all = [&words](Finder volatile find) {
+        size_t keyword_count = 0;
+        for (string_view word : words) {
+            keyword_count += find(word) != nullptr;
+        }
+        return keyword_count;
+    };
+    const double chain_ns = br.Run("classify corpus words, if-else chain"s, 200'000, [&] {
+        DoNotOptimize(lookup_all(FindKeywordByComparison));
+    });
+    const double table_ns = br.Run("classify corpus words, perfect hash"s, 200'000, [&] {
+        DoNotOptimize(lookup_all(FindKeyword));
+    });
+    cout << "  "s << words.size() << " words, "s << lookup_all(FindKeyword) << " keywords; ns/word: chain "s
+         << chain_ns / words.size() << ", perfect hash "s << table_ns / words.size() << endl;
+}
+
+// Программа с глубокими отступами, длинными строковыми константами и комментариями:
+// на таком тексте лексер большую часть времени ищет границы, а не разбирает лексемы
+string MakeScanHeavyProgram(size_t line_count) {
+    const string indent(32, ' ');
+    const string text(120, 'x');
+    string program = "class Report:\n  def render(self):\n"s;
+    for (size_t i = 0; i < line_count; ++i) {
+        program += indent + "print '"s + text + "', \"escaped \\\" "s + text + "\"  # "s + text + "\n"s;
+    }
+    return program;
+}
+
+// Сравнивает пропускную способность поиска символов и всего лексера с разными наборами инструкций
+void BenchScanner(BenchRunner& br) {
+    const string program = MakeScanHeavyProgram(2'000);
+    const string spaces(1 << 20, ' ');
+    const double megabyte = 1 << 20;
+    auto throughput = [&](size_t bytes, double ns) {
+        return bytes / megabyte / (ns / 1e9);
+    };
+
+    const ScanIsa detected = GetScanIsa();
+    double scalar_lexer_mbs = 0;
+    for (ScanIsa isa : {ScanIsa::Scalar, ScanIsa::Sse2, ScanIsa::Avx2}) {
+        if (!IsScanIsaSupported(isa)) {
+            cout << "  "s << GetScanIsaName(isa) << " is not supported"s << endl;
+            continue;
+        }
+        SetScanIsa(isa);
+        const string suffix = ", "s + GetScanIsaName(isa);
+
+        const double skip_ns = br.Run("skip 1 MiB of spaces"s + suffix, 50, [&] {
+            DoNotOptimize(FindFirstNot(spaces, 0, ' '));
+        });
+        const double find_ns = br.Run("find quote in 1 MiB"s + suffix, 50, [&] {
+            DoNotOptimize(FindFirstOf(spaces, 0, '\n', '#', '\'', '"'));
+        });
+        const double lex_ns = br.Run("lex scan-heavy program"s + suffix, 20, [&] {
+            Lexer lexer{string_view(program)};
+            DoNotOptimize(LexAll(lexer));
+        });
+
+        const double lexer_mbs = throughput(program.size(), lex_ns);
+        if (isa == ScanIsa::Scalar) {
+            scalar_lexer_mbs = lexer_mbs;
+        }
+        cout << "  MB/s: skip spaces "s << throughput(spaces.size(), skip_ns) << ", find quote "s
+             << throughput(spaces.size(), find_ns) << ", lexer "s << lexer_mbs << " ("s
+             << lexer_mbs / scalar_lexer_mbs << "x scalar)"s << endl;
+    }
+    SetScanIsa(detected);
+}
+
+}  // namespace
+
+void RunBenchmarks(BenchRunner& br) {
+    RUN_BENCH(br, parse::BenchLexer);
+    RUN_BENCH(br, parse::BenchKeywords);
+    RUN_BENCH(br, parse::BenchKeywordLookup);
+    RUN_BENCH(br, parse::BenchScanner);
+}
+
+}  // namespace parse
@@ -1,4 +1,5 @@
 #include "lexer.h"
+#include "scan.h"
 #include "test_runner_p.h"
 
 #include <sstream>
@@ -351,6 +352,127 @@ abc#
         ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
     }
 }
+
+void TestStreaming() {
+    istringstream is("class A:\n  def f():\n    return 1\nx = 'a b'\n"s);
+    Lexer lexer(is);
+
+    // Следующая строка читается из потока, только когда парсер доходит до неё
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
+    ASSERT_EQUAL(is.tellg(), streampos(9));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"A"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(is.tellg(), streampos(9));
+
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(is.tellg(), streampos(20));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"f"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'('}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{')'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Number{1}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Dedent{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"a b"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+void TestSourceInMemory() {
+    const string source = "name = 'plain' + \"it\\'s\\n\"\nprint name"s;
+    Lexer lexer{string_view(source)};
+
+    auto points_into_source = [&source](string_view value) {
+        return value.data() >= source.data() && value.data() + value.size() <= source.data() + source.size();
+    };
+
+    // Идентификаторы и строки без escape-последовательностей не копируются
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Id{"name"s}));
+    ASSERT(points_into_source(lexer.CurrentToken().As<token_type::Id>().value));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'='}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"plain"s}));
+    ASSERT(points_into_source(lexer.CurrentToken().As<token_type::String>().value));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{'+'}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"it's\n"s}));
+    ASSERT(!points_into_source(lexer.CurrentToken().As<token_type::String>().value));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Print{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"name"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Eof{}));
+}
+
+void TestEscapeSequences() {
+    istringstream is(R"('a\tb' "q\"x" 'it\'s' 'back\\slash' 'x # y')"s);
+    Lexer lexer(is);
+
+    ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::String{"a\tb"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"q\"x"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"it's"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"back\\slash"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{"x # y"s}));
+    ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+
+    istringstream unterminated("x = 'abc"s);
+    ASSERT_THROWS(Lexer{unterminated}, LexerError);
+}
+
+void TestScanner() {
+    const ScanIsa detected = GetScanIsa();
+    for (ScanIsa isa : {ScanIsa::Scalar, ScanIsa::Sse2, ScanIsa::Avx2}) {
+        if (!IsScanIsaSupported(isa)) {
+            continue;
+        }
+        SetScanIsa(isa);
+
+        // Искомый символ стоит в начале, внутри и в конце блока, а также в недочитанном остатке
+        for (size_t size : {0U, 1U, 15U, 16U, 17U, 31U, 32U, 33U, 70U}) {
+            const string spaces(size, ' ');
+            ASSERT_EQUAL(FindFirstNot(spaces, 0, ' '), size);
+            ASSERT_EQUAL(FindFirstOf(spaces, 0, '#', '\n', '\'', '"'), size);
+            for (size_t pos = 0; pos < size; ++pos) {
+                string text = spaces;
+                text[pos] = '#';
+                ASSERT_EQUAL(FindFirstNot(text, 0, ' '), pos);
+                ASSERT_EQUAL(FindFirstOf(text, 0, '\n', '#', '\n', '\n'), pos);
+                ASSERT_EQUAL(FindFirstOf(text, pos + 1, '\n', '#', '\n', '\n'), size);
+            }
+        }
+
+        // Лексер получает одни и те же токены при любом наборе инструкций
+        const string indent(40, ' ');
+        const string literal(50, 'a');
+        const string source = "class A:\n" + indent + "def f():\n" + indent + "  return '" + literal
+                              + "\\'' # comment " + literal + "\n"s;
+        Lexer lexer{string_view(source)};
+        ASSERT_EQUAL(lexer.CurrentToken(), Token(token_type::Class{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Id{"A"s}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        for (size_t i = 0; i < indent.size() / 2; ++i) {
+            ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+        }
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Def{}));
+        lexer.NextToken();
+        lexer.NextToken();
+        lexer.NextToken();
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Char{':'}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Indent{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Return{}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::String{literal + "'"}));
+        ASSERT_EQUAL(lexer.NextToken(), Token(token_type::Newline{}));
+    }
+    SetScanIsa(detected);
+}
 }  // namespace
 
 void RunOpenLexerTests(TestRunner& tr) {
@@ -367,6 +489,10 @@ void RunOpenLexerTests(TestRunner& tr) {
     RUN_TEST(tr, parse::TestMythonProgram);
     RUN_TEST(tr, parse::TestAlwaysEmitsNewlineAtTheEndOfNonemptyLine);
     RUN_TEST(tr, parse::TestCommentsAreIgnored);
+    RUN_TEST(tr, parse::TestStreaming);
+    RUN_TEST(tr, parse::TestSourceInMemory);
+    RUN_TEST(tr, parse::TestEscapeSequences);
+    RUN_TEST(tr, parse::TestScanner);
 }
 
 }  // namespace parse
\ No newline at end of file
@@ -1,10 +1,19 @@
+#include "bytecode_cache.h"
+#include "compiler.h"
+#include "fold.h"
+#include "gc.h"
 #include "lexer.h"
+#include "mapped_file.h"
 #include "parse.h"
 #include "runtime.h"
 #include "statement.h"
+#include "vm.h"
 //#include "test_runner_p.h"
 
+#include <charconv>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 using namespace std;
 
@@ -21,16 +30,151 @@ using namespace std;
 //}  // namespace runtime
 //
 //void TestParseProgram(TestRunner& tr);
+//
+//namespace vm {
+//void RunVmTests(TestRunner& tr);
+//}
 
 namespace {
 
-void RunMythonProgram(istream& input, ostream& output) {
-    parse::Lexer lexer(input);
+// Способ выполнения программы
+enum class Engine {
+    // Обход синтаксического дерева. Эталонный режим для сравнения с виртуальной машиной
+    Tree,
+    // Компиляция в байт-код и выполнение на виртуальной машине
+    Vm,
+};
+
+// Параметры запуска, задаваемые в командной строке
+struct Options {
+    Engine engine = Engine::Vm;
+    // Вывести в stderr состояние кэшей мест вызова после выполнения программы
+    bool print_call_site_stats = false;
+    // Свернуть константные выражения перед выполнением
+    bool fold_constants = true;
+    // Вывести в stderr число свёрнутых выражений
+    bool print_fold_stats = false;
+    // Вывести в stderr статистику сборщика циклов после выполнения программы
+    bool print_gc_stats = false;
+    // Собирать циклы по поколениям (см. runtime::CycleCollector::Options::generational)
+    bool generational_gc = false;
+    // Хранить байт-код программы в файле <program.my>c и загружать его вместо разбора исходного
+    // текста, пока файл программы не изменится
+    bool use_cache = true;
+    runtime::OutputBuffering buffering = runtime::OutputBuffering::Full;
+    size_t buffer_size = runtime::BufferedContext::DEFAULT_BUFFER_SIZE;
+    // Файл с программой. Если он не задан, программа читается из стандартного ввода
+    string program_path;
+};
+
+unique_ptr<ast::Statement> ParseMythonProgram(parse::Lexer& lexer, const Options& options) {
     auto program = ParseProgram(lexer);
+    if (options.fold_constants) {
+        const ast::FoldStats stats = ast::FoldConstants(program);
+        if (options.print_fold_stats) {
+            cerr << "folded "sv << stats.folded << " expressions, simplified "sv
+                 << stats.simplified_negations << " negations"sv << endl;
+        }
+    }
+    return program;
+}
 
-    runtime::SimpleContext context{output};
-    runtime::Closure closure;
-    program->Execute(closure, context);
+void PrintGcStats(ostream& out, const runtime::CycleCollector& collector) {
+    const runtime::GcStats& stats = collector.GetStats();
+    out << "gc: "sv << stats.collections << " collections ("sv << stats.young_collections
+        << " young only), "sv << stats.collected_objects
+        << " objects and "sv << stats.reclaimed_bytes << " bytes reclaimed, pauses total "sv
+        << stats.total_pause.count() / 1000 << " us, max "sv << stats.max_pause.count() / 1000
+        << " us, last "sv << stats.last_pause.count() / 1000 << " us"sv << endl;
+}
+
+// Выполняет программу, собирая циклические ссылки между её объектами. Циклы, оставшиеся
+// после выполнения, собираются после удаления переменных программы
+template <typename Func>
+void RunWithCycleCollector(const Options& options, Func run) {
+    runtime::CycleCollector::Options gc_options;
+    gc_options.generational = options.generational_gc;
+    runtime::CycleCollector collector(gc_options);
+    {
+        runtime::CycleCollector::Scope scope(collector);
+        run();
+    }
+    collector.Collect();
+    if (options.print_gc_stats) {
+        PrintGcStats(cerr, collector);
+    }
+}
+
+void RunCompiledProgram(const bytecode::Program& compiled, ostream& output, const Options& options) {
+    RunWithCycleCollector(options, [&] {
+        // Если программа завершится исключением, накопленный вывод сбросит деструктор контекста
+        runtime::BufferedContext context{output, options.buffer_size, options.buffering};
+        runtime::Closure closure;
+        vm::ExecutionState state(compiled);
+        vm::Run(compiled, closure, context, state);
+        context.Flush();
+        if (options.print_call_site_stats) {
+            vm::PrintCallSiteStats(cerr, compiled, state);
+        }
+    });
+}
+
+void RunMythonProgram(parse::Lexer& lexer, ostream& output, const Options& options = {}) {
+    auto program = ParseMythonProgram(lexer, options);
+    if (options.engine == Engine::Vm) {
+        RunCompiledProgram(bytecode::Compile(*program), output, options);
+        return;
+    }
+
+    RunWithCycleCollector(options, [&] {
+        runtime::BufferedContext context{output, options.buffer_size, options.buffering};
+        runtime::Closure closure;
+        program->Execute(closure, context);
+        context.Flush();
+    });
+}
+
+// Выполняет программу из файла на виртуальной машине, по возможности загружая байт-код из кэша.
+// Кэш содержит программу со свёрнутыми константами, поэтому с --no-fold он не используется
+void RunCachedMythonProgram(const string& path, ostream& output, const Options& options) {
+    const bytecode::SourceStamp stamp = bytecode::GetSourceStamp(path);
+    const string cache_path = bytecode::GetCachePath(path);
+    if (auto cached = bytecode::LoadCacheFile(cache_path, stamp)) {
+        // Константы свернули при создании кэша, в этом запуске свёртки не было
+        if (options.print_fold_stats) {
+            cerr << "folding skipped: bytecode loaded from "sv << cache_path
+                 << ", run with --no-cache for fold statistics"sv << endl;
+        }
+        RunCompiledProgram(*cached, output, options);
+        return;
+    }
+
+    bytecode::Program compiled;
+    {
+        parse::MappedFile file(path);
+        parse::Lexer lexer(file.GetContents());
+        compiled = bytecode::Compile(*ParseMythonProgram(lexer, options));
+    }
+    // Если кэш записать не удалось, программа просто будет разобрана заново при следующем запуске
+    bytecode::SaveCacheFile(cache_path, compiled, stamp);
+    RunCompiledProgram(compiled, output, options);
+}
+
+const string_view BUFFER_SIZE_FLAG = "--buffer-size="sv;
+
+void PrintUsage() {
+    std::cerr << "Usage: mython [--engine=vm|tree] [--ic-stats] [--no-fold] [--fold-stats] [--gc-stats] [--gc-generational] [--no-cache] [--line-buffered] [--buffer-size=BYTES] [program.my]\n"sv
+              << "Without program.my the program is read from standard input"sv << std::endl;
+}
+
+// Разбирает положительное число байт. Возвращает 0, если значение некорректно
+size_t ParseBufferSize(string_view value) {
+    size_t size = 0;
+    const auto [end, error] = from_chars(value.data(), value.data() + value.size(), size);
+    if (error != errc{} || end != value.data() + value.size()) {
+        return 0;
+    }
+    return size;
 }
 
 //void TestSimplePrints() {
@@ -118,6 +262,7 @@ void RunMythonProgram(istream& input, ostream& output) {
 //    runtime::RunObjectsTests(tr);
 //    ast::RunUnitTests(tr);
 //    TestParseProgram(tr);
+//    vm::RunVmTests(tr);
 //
 //    RUN_TEST(tr, TestSimplePrints);
 //    RUN_TEST(tr, TestAssignments);
@@ -128,9 +273,54 @@ void RunMythonProgram(istream& input, ostream& output) {
 
 }  // namespace
 
-int main() {
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        string_view arg = argv[i];
+        if (arg == "--engine=tree"sv) {
+            options.engine = Engine::Tree;
+        } else if (arg == "--engine=vm"sv) {
+            options.engine = Engine::Vm;
+        } else if (arg == "--ic-stats"sv) {
+            options.print_call_site_stats = true;
+        } else if (arg == "--no-fold"sv) {
+            options.fold_constants = false;
+        } else if (arg == "--fold-stats"sv) {
+            options.print_fold_stats = true;
+        } else if (arg == "--gc-stats"sv) {
+            options.print_gc_stats = true;
+        } else if (arg == "--gc-generational"sv) {
+            options.generational_gc = true;
+        } else if (arg == "--no-cache"sv) {
+            options.use_cache = false;
+        } else if (arg == "--line-buffered"sv) {
+            options.buffering = runtime::OutputBuffering::Line;
+        } else if (arg.substr(0, BUFFER_SIZE_FLAG.size()) == BUFFER_SIZE_FLAG) {
+            options.buffer_size = ParseBufferSize(arg.substr(BUFFER_SIZE_FLAG.size()));
+            if (options.buffer_size == 0) {
+                PrintUsage();
+                return 1;
+            }
+        } else if (arg.substr(0, 2) != "--"sv && options.program_path.empty()) {
+            options.program_path = arg;
+        } else {
+            PrintUsage();
+            return 1;
+        }
+    }
+
     try {
-        RunMythonProgram(cin, cout);
+        if (options.program_path.empty()) {
+            parse::Lexer lexer(cin);
+            RunMythonProgram(lexer, cout, options);
+        } else if (options.engine == Engine::Vm && options.use_cache && options.fold_constants) {
+            RunCachedMythonProgram(options.program_path, cout, options);
+        } else {
+            // Лексер читает программу прямо из отображённого в память файла
+            parse::MappedFile file(options.program_path);
+            parse::Lexer lexer(file.GetContents());
+            RunMythonProgram(lexer, cout, options);
+        }
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
 		return 1;
@@ -0,0 +1,74 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MYTHON_HAS_MMAP 1
+#endif
+
+using namespace std;
+
+namespace parse {
+
+#ifdef MYTHON_HAS_MMAP
+
+    MappedFile::MappedFile(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Can't open "s + path + ": "s + strerror(errno));
+        }
+
+        struct stat info {};
+        if (fstat(fd, &info) != 0) {
+            const int error = errno;
+            close(fd);
+            throw std::runtime_error("Can't read "s + path + ": "s + strerror(error));
+        }
+
+        // Пустой файл отобразить нельзя, да и не нужно
+        size_ = static_cast<size_t>(info.st_size);
+        if (size_ != 0) {
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                const int error = errno;
+                close(fd);
+                throw std::runtime_error("Can't map "s + path + ": "s + strerror(error));
+            }
+            // Лексер читает программу от начала к концу
+            madvise(data, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const char*>(data);
+        }
+        close(fd);
+    }
+
+    MappedFile::~MappedFile() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+#else
+
+    MappedFile::MappedFile(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::runtime_error("Can't open "s + path);
+        }
+        contents_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        data_ = contents_.data();
+        size_ = contents_.size();
+    }
+
+    MappedFile::~MappedFile() = default;
+
+#endif
+
+}  // namespace parse
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace parse {
+
+    /*
+     * Файл с текстом программы, отображённый в память только для чтения. Лексер, созданный
+     * по GetContents(), ссылается на страницы файла и не копирует программу целиком.
+     * На платформах без mmap содержимое файла читается в память
+     */
+    class MappedFile {
+    public:
+        // Выбрасывает std::runtime_error, если файл не удалось открыть или прочитать
+        explicit MappedFile(const std::string& path);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        // Возвращает содержимое файла. Оно доступно, пока существует объект MappedFile
+        [[nodiscard]] std::string_view GetContents() const {
+            return {data_, size_};
+        }
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+        // Содержимое файла, если его не удалось отобразить в память
+        std::string contents_;
+    };
+
+}  // namespace parse
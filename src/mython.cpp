@@ -0,0 +1,112 @@
+#include "mython.h"
+
+#include "bytecode_cache.h"
+#include "compiler.h"
+#include "fold.h"
+#include "lexer.h"
+#include "mapped_file.h"
+#include "parse.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+namespace mython {
+
+Script::Script(bytecode::Program program)
+    : program_(std::move(program)) {
+}
+
+shared_ptr<const Script> Script::Compile(string_view source) {
+    parse::Lexer lexer(source);
+    auto tree = ParseProgram(lexer);
+    ast::FoldConstants(tree);
+    return make_shared<const Script>(bytecode::Compile(*tree));
+}
+
+shared_ptr<const Script> Script::Load(const string& path) {
+    const bytecode::SourceStamp stamp = bytecode::GetSourceStamp(path);
+    const string cache_path = bytecode::GetCachePath(path);
+    if (auto cached = bytecode::LoadCacheFile(cache_path, stamp)) {
+        return make_shared<const Script>(std::move(*cached));
+    }
+
+    shared_ptr<const Script> script;
+    {
+        parse::MappedFile file(path);
+        script = Compile(file.GetContents());
+    }
+    bytecode::SaveCacheFile(cache_path, script->GetProgram(), stamp);
+    return script;
+}
+
+void Script::Run(runtime::Closure& closure, runtime::Context& context) const {
+    vm::Run(program_, closure, context);
+}
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    thread_count = max<size_t>(thread_count, 1);
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this] {
+            Work();
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    has_tasks_.notify_all();
+    for (thread& worker : threads_) {
+        worker.join();
+    }
+}
+
+future<RunResult> ThreadPool::Submit(shared_ptr<const Script> script) {
+    // std::function копируемая, а packaged_task - нет
+    auto task = make_shared<packaged_task<RunResult()>>([script = std::move(script)] {
+        ostringstream output;
+        runtime::SimpleContext context(output);
+        RunResult result;
+        result.collector = make_unique<runtime::CycleCollector>();
+        runtime::CycleCollector::Scope scope(*result.collector);
+        script->Run(result.globals, context);
+        result.output = output.str();
+        result.script = script;
+        return result;
+    });
+    future<RunResult> result = task->get_future();
+    {
+        lock_guard guard(mutex_);
+        tasks_.emplace_back([task] {
+            (*task)();
+        });
+    }
+    has_tasks_.notify_one();
+    return result;
+}
+
+void ThreadPool::Work() {
+    for (;;) {
+        function<void()> task;
+        {
+            unique_lock lock(mutex_);
+            has_tasks_.wait(lock, [this] {
+                return stopping_ || !tasks_.empty();
+            });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+}  // namespace mython
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "bytecode.h"
+#include "gc.h"
+#include "runtime.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mython {
+
+/*
+ * Программа Mython, скомпилированная в байт-код для многократного выполнения.
+ * Script не изменяется после создания: его можно одновременно выполнять в нескольких потоках,
+ * если у каждого выполнения свои Closure и Context. Кэши мест вызова, которые программа
+ * заполняет при выполнении, принадлежат выполнению (см. vm::ExecutionState)
+ */
+class Script {
+public:
+    explicit Script(bytecode::Program program);
+
+    // Разбирает текст программы, сворачивает константы и компилирует её.
+    // Выбрасывает parse::LexerError, ParseError или bytecode::CompileError
+    static std::shared_ptr<const Script> Compile(std::string_view source);
+
+    // Загружает программу из файла path. Байт-код берётся из кэша рядом с файлом,
+    // пока файл не изменится (см. bytecode::LoadCacheFile)
+    static std::shared_ptr<const Script> Load(const std::string& path);
+
+    // Выполняет программу, объявляя её классы и переменные в closure.
+    // Классы, на которые ссылается closure, живут, пока существует Script
+    void Run(runtime::Closure& closure, runtime::Context& context) const;
+
+    [[nodiscard]] const bytecode::Program& GetProgram() const {
+        return program_;
+    }
+
+private:
+    bytecode::Program program_;
+};
+
+// Результат выполнения программы в пуле потоков
+struct RunResult {
+    // Программа, которой принадлежат классы объектов из globals.
+    // Объявлена первой, чтобы освобождаться после globals
+    std::shared_ptr<const Script> script;
+    // Сборщик циклов между объектами программы. Объявлен до globals, чтобы после их удаления
+    // собрать оставшиеся циклы
+    std::unique_ptr<runtime::CycleCollector> collector;
+    // Выведенный программой текст
+    std::string output;
+    // Переменные верхнего уровня после выполнения
+    runtime::Closure globals;
+};
+
+/*
+ * Пул рабочих потоков, выполняющих программы. Каждое выполнение получает собственные
+ * Closure, контекст вывода и кэши мест вызова, поэтому одна и та же программа может
+ * выполняться одновременно во всех потоках пула
+ */
+class ThreadPool {
+public:
+    // Запускает thread_count рабочих потоков (не меньше одного)
+    explicit ThreadPool(size_t thread_count = std::thread::hardware_concurrency());
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Дожидается выполнения поставленных в очередь программ и останавливает потоки
+    ~ThreadPool();
+
+    [[nodiscard]] size_t GetThreadCount() const {
+        return threads_.size();
+    }
+
+    // Ставит выполнение программы в очередь. Исключение, выброшенное при выполнении,
+    // передаётся через future
+    std::future<RunResult> Submit(std::shared_ptr<const Script> script);
+
+private:
+    void Work();
+
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_ = false;
+    std::vector<std::thread> threads_;
+};
+
+}  // namespace mython
@@ -31,7 +31,7 @@ public:
             result->AddStatement(ParseStatement());
         }
 
-        return result;
+        return make_unique<ast::Program>(std::move(result), arena_);
     }
 
 private:
@@ -66,9 +66,9 @@ private:
             lexer_.ExpectNext<TokenType::Char>('(');
 
             if (lexer_.NextToken().Is<TokenType::Id>()) {
-                m.formal_params.push_back(lexer_.Expect<TokenType::Id>().value);
+                m.formal_params.emplace_back(lexer_.Expect<TokenType::Id>().value);
                 while (lexer_.NextToken() == ',') {
-                    m.formal_params.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+                    m.formal_params.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
                 }
             }
 
@@ -76,7 +76,7 @@ private:
             lexer_.ExpectNext<TokenType::Char>(':');
             lexer_.NextToken();
 
-            m.body = std::make_unique<ast::MethodBody>(ParseSuite());  // NOLINT
+            m.body = std::make_unique<ast::MethodBody>(ParseSuite(), arena_);  // NOLINT
 
             result.push_back(std::move(m));
         }
@@ -86,13 +86,13 @@ private:
     // ClassDefinition -> Id ['(' Id ')'] : new_line indent MethodList dedent
     unique_ptr<ast::Statement> ParseClassDefinition()  // NOLINT
     {
-        string class_name = lexer_.Expect<TokenType::Id>().value;
+        string class_name(lexer_.Expect<TokenType::Id>().value);
 
         lexer_.NextToken();
 
         const runtime::Class* base_class = nullptr;
         if (lexer_.CurrentToken() == '(') {
-            auto name = lexer_.ExpectNext<TokenType::Id>().value;
+            string name(lexer_.ExpectNext<TokenType::Id>().value);
             lexer_.ExpectNext<TokenType::Char>(')');
             lexer_.NextToken();
 
@@ -124,11 +124,11 @@ private:
         return make_unique<ast::ClassDefinition>(it->second);
     }
 
-    vector<string> ParseDottedIds() {
-        vector<string> result(1, lexer_.Expect<TokenType::Id>().value);
+    vector<runtime::Symbol> ParseDottedIds() {
+        vector<runtime::Symbol> result(1, lexer_.Expect<TokenType::Id>().value);
 
         while (lexer_.NextToken() == '.') {
-            result.push_back(lexer_.ExpectNext<TokenType::Id>().value);
+            result.emplace_back(lexer_.ExpectNext<TokenType::Id>().value);
         }
 
         return result;
@@ -139,24 +139,24 @@ private:
     unique_ptr<ast::Statement> ParseAssignmentOrCall() {
         lexer_.Expect<TokenType::Id>();
 
-        vector<string> id_list = ParseDottedIds();
-        string last_name = id_list.back();
+        vector<runtime::Symbol> id_list = ParseDottedIds();
+        runtime::Symbol last_name = id_list.back();
         id_list.pop_back();
 
         if (lexer_.CurrentToken() == '=') {
             lexer_.NextToken();
 
             if (id_list.empty()) {
-                return make_unique<ast::Assignment>(std::move(last_name), ParseTest());
+                return make_unique<ast::Assignment>(last_name, ParseTest());
             }
             return make_unique<ast::FieldAssignment>(ast::VariableValue{std::move(id_list)},
-                                                     std::move(last_name), ParseTest());
+                                                     last_name, ParseTest());
         }
         lexer_.Expect<TokenType::Char>('(');
         lexer_.NextToken();
 
         if (id_list.empty()) {
-            throw ParseError("Mython doesn't support functions, only methods: "s + last_name);
+            throw ParseError("Mython doesn't support functions, only methods: "s + last_name.GetName());
         }
 
         vector<unique_ptr<ast::Statement>> args;
@@ -167,7 +167,7 @@ private:
         lexer_.NextToken();
 
         return make_unique<ast::MethodCall>(make_unique<ast::VariableValue>(std::move(id_list)),
-                                            std::move(last_name), std::move(args));
+                                            last_name, std::move(args));
     }
 
     // Expr -> Adder ['+'/'-' Adder]*
@@ -232,7 +232,7 @@ private:
             return make_unique<ast::NumericConst>(result);
         }
         if (const auto* str = lexer_.CurrentToken().TryAs<TokenType::String>()) {
-            string result = str->value;
+            string result(str->value);
             lexer_.NextToken();
             return make_unique<ast::StringConst>(std::move(result));
         }
@@ -253,7 +253,7 @@ private:
     }
 
     std::unique_ptr<ast::Statement> ParseDottedIdsInMultExpr() {
-        vector<string> names = ParseDottedIds();
+        vector<runtime::Symbol> names = ParseDottedIds();
 
         if (lexer_.CurrentToken() == '(') {
             // various calls
@@ -269,20 +269,20 @@ private:
 
             if (!names.empty()) {
                 return make_unique<ast::MethodCall>(
-                    make_unique<ast::VariableValue>(std::move(names)), std::move(method_name),
+                    make_unique<ast::VariableValue>(std::move(names)), method_name,
                     std::move(args));
             }
             if (auto it = declared_classes_.find(method_name); it != declared_classes_.end()) {
                 return make_unique<ast::NewInstance>(
                     static_cast<const runtime::Class&>(*it->second), std::move(args));  // NOLINT
             }
-            if (method_name == "str"sv) {
+            if (method_name.GetName() == "str"sv) {
                 if (args.size() != 1) {
                     throw ParseError("Function str takes exactly one argument"s);
                 }
                 return make_unique<ast::Stringify>(std::move(args.front()));
             }
-            throw ParseError("Unknown call to "s + method_name + "()"s);
+            throw ParseError("Unknown call to "s + method_name.GetName() + "()"s);
         }
         return make_unique<ast::VariableValue>(std::move(names));
     }
@@ -439,10 +439,13 @@ private:
 
     parse::Lexer& lexer_;
     runtime::Closure declared_classes_;
+    // Узлы дерева создаются в арене, которой владеют корень дерева и тела методов
+    shared_ptr<ast::Arena> arena_ = make_shared<ast::Arena>();
+    ast::Arena::Scope arena_scope_{*arena_};
 };
 
 }  // namespace
 
-unique_ptr<runtime::Executable> ParseProgram(parse::Lexer& lexer) {
+unique_ptr<ast::Statement> ParseProgram(parse::Lexer& lexer) {
     return Parser{lexer}.ParseProgram();
 }
\ No newline at end of file
@@ -1,3 +1,4 @@
+#include "fold.h"
 #include "lexer.h"
 #include "parse.h"
 #include "statement.h"
@@ -283,6 +284,137 @@ x = X(xh)
     ASSERT_EQUAL(xh->Fields().at("x"s).Get(), closure.at("x"s).Get());
 }
 
+void TestArenaAllocatedTree() {
+    // Длинная цепочка сложений даёт дерево глубиной в сотни тысяч узлов, и рекурсивные
+    // деструкторы переполнили бы стек
+    string program = "x = 0"s;
+    for (int i = 0; i < 200'000; ++i) {
+        program += " + 1"s;
+    }
+    program += "\n"s;
+
+    auto tree = ParseProgramFromString(program);
+    const auto* root = dynamic_cast<const ast::Program*>(tree.get());
+    ASSERT(root != nullptr);
+    ASSERT(root->GetArena().GetAllocatedBytes() > 200'000 * sizeof(ast::Add));
+    ASSERT(root->GetArena().GetBlockCount() > 1);
+    tree.reset();
+
+    // Вне парсера узлы создаются в куче
+    ASSERT(ast::Arena::Current() == nullptr);
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ast::Print print{make_unique<ast::NumericConst>(1)};
+    print.Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "1\n"s);
+}
+
+void TestMethodsOutliveTree() {
+    const string program = R"(
+class Counter:
+  def __init__():
+    self.value = 0
+
+  def inc(step):
+    self.value = self.value + step
+    return self.value
+
+)"s;
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ParseProgramFromString(program)->Execute(closure, context);
+
+    // Дерево программы уже уничтожено, но тела методов держат арену, в которой лежат их узлы
+    const auto* cls = closure.at("Counter"s).TryAs<runtime::Class>();
+    ASSERT(cls != nullptr);
+    runtime::ClassInstance counter{*cls};
+    counter.Call("__init__"s, {}, context);
+    counter.Call("inc"s, {runtime::ObjectHolder::Own(runtime::Number{2})}, context);
+    auto result = counter.Call("inc"s, {runtime::ObjectHolder::Own(runtime::Number{3})}, context);
+    ASSERT_EQUAL(result.TryAs<runtime::Number>()->GetValue(), 5);
+}
+
+void TestConstantFolding() {
+    const string program = R"(
+class Area:
+  def get():
+    return 3 * 4 + 1
+
+x = 2 * 5 + 10 / 2
+y = -5
+s = 'a' + 'b' + str(10 - 3)
+c = 1 < 2 and not 'abc' == 'abd'
+d = True or x
+area = Area()
+print x, y, s, c, d, area.get()
+)"s;
+
+    auto tree = ParseProgramFromString(program);
+    const ast::FoldStats stats = ast::FoldConstants(tree);
+    // 3 * 4 и + 1; *, / и +; -5; +, -, str и +; <, ==, not и and; or
+    ASSERT_EQUAL(stats.folded, 15U);
+    ASSERT_EQUAL(stats.simplified_negations, 0U);
+
+    const auto& body = static_cast<const ast::Compound&>(dynamic_cast<const ast::Program&>(*tree).GetBody());
+    const auto& x = dynamic_cast<const ast::Assignment&>(*body.GetStatements()[1]);
+    ASSERT_EQUAL(dynamic_cast<const ast::NumericConst&>(x.GetValue()).GetValue().GetValue(), 15);
+    const auto& y = dynamic_cast<const ast::Assignment&>(*body.GetStatements()[2]);
+    ASSERT_EQUAL(dynamic_cast<const ast::NumericConst&>(y.GetValue()).GetValue().GetValue(), -5);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "15 -5 ab7 True True 13\n"s);
+}
+
+void TestFoldingKeepsErrors() {
+    const string program = R"(
+print 'before'
+x = 1 + 2 / 0
+)"s;
+
+    auto tree = ParseProgramFromString(program);
+    // Деление на 0 остаётся в дереве, и 1 + ... тоже нельзя вычислить
+    ASSERT_EQUAL(ast::FoldConstants(tree).folded, 0U);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    try {
+        tree->Execute(closure, context);
+        ASSERT(false);
+    } catch (const runtime_error& e) {
+        ASSERT_EQUAL(string(e.what()), "Can't divide by 0"s);
+    }
+    ASSERT_EQUAL(context.output.str(), "before\n"s);
+}
+
+void TestFoldingSimplifiesNegation() {
+    const string program = R"(
+x = 3
+s = 'abc'
+a = --(x * 2)
+b = 1 - -(x * 2)
+c = x + -(x * 2)
+print a, b, c
+t = --s
+)"s;
+
+    auto tree = ParseProgramFromString(program);
+    const ast::FoldStats stats = ast::FoldConstants(tree);
+    // --s не упрощается: s может оказаться не числом, и тогда минус выбрасывает исключение
+    ASSERT_EQUAL(stats.simplified_negations, 2U);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    try {
+        tree->Execute(closure, context);
+        ASSERT(false);
+    } catch (const runtime_error&) {
+    }
+    ASSERT_EQUAL(context.output.str(), "6 7 -3\n"s);
+}
+
 }  // namespace parse
 
 void TestParseProgram(TestRunner& tr) {
@@ -296,4 +428,9 @@ void TestParseProgram(TestRunner& tr) {
     RUN_TEST(tr, parse::TestComplexLogicalExpression);
     RUN_TEST(tr, parse::TestClassicalPolymorphism);
     RUN_TEST(tr, parse::TestSelf);
+    RUN_TEST(tr, parse::TestArenaAllocatedTree);
+    RUN_TEST(tr, parse::TestMethodsOutliveTree);
+    RUN_TEST(tr, parse::TestConstantFolding);
+    RUN_TEST(tr, parse::TestFoldingKeepsErrors);
+    RUN_TEST(tr, parse::TestFoldingSimplifiesNegation);
 }
\ No newline at end of file
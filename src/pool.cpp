@@ -0,0 +1,186 @@
+#include "pool.h"
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+constexpr size_t CLASS_COUNT = Pool::MAX_SIZE / Pool::GRANULARITY;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Возвращает номер класса размеров для запроса в size байт, не превышающего MAX_SIZE
+size_t SizeClass(size_t size) {
+    return size == 0 ? 0 : (size - 1) / Pool::GRANULARITY;
+}
+
+size_t BlockSize(size_t size_class) {
+    return (size_class + 1) * Pool::GRANULARITY;
+}
+
+// Участки и свободные блоки, не принадлежащие ни одному потоку
+struct SharedState {
+    mutex lock;
+    vector<unique_ptr<std::byte[]>> chunks;
+    FreeBlock* free[CLASS_COUNT] = {};
+};
+
+SharedState& Shared() {
+    // Состояние не разрушается: объекты могут удаляться и при завершении программы
+    static auto* state = new SharedState;
+    return *state;
+}
+
+// Нарезает новый участок на блоки класса size_class и возвращает их список
+FreeBlock* CarveChunk(SharedState& state, size_t size_class) {
+    // new[] без скобок не обнуляет участок
+    state.chunks.emplace_back(new std::byte[Pool::CHUNK_SIZE]);
+    std::byte* chunk = state.chunks.back().get();
+    const size_t block_size = BlockSize(size_class);
+    FreeBlock* head = nullptr;
+    for (size_t offset = Pool::CHUNK_SIZE / block_size * block_size; offset != 0;) {
+        offset -= block_size;
+        head = new (chunk + offset) FreeBlock{head};
+    }
+    return head;
+}
+
+// Больше стольких байт свободных блоков одного класса поток у себя не держит: блоки,
+// которые освобождает не создавший их поток, иначе копились бы в его списке, а создающий
+// поток нарезал бы всё новые участки
+constexpr size_t MAX_CACHED_BYTES = 2 * Pool::CHUNK_SIZE;
+
+size_t CacheLimit(size_t size_class) {
+    return MAX_CACHED_BYTES / BlockSize(size_class);
+}
+
+// Оставляет в списке list не больше count первых блоков и возвращает остаток списка.
+// В kept записывается число оставленных блоков
+FreeBlock* CutAfter(FreeBlock* list, size_t count, size_t& kept) {
+    kept = 0;
+    if (list == nullptr || count == 0) {
+        return list;
+    }
+    FreeBlock* last = list;
+    for (kept = 1; kept < count && last->next != nullptr; ++kept) {
+        last = last->next;
+    }
+    return std::exchange(last->next, nullptr);
+}
+
+// Присоединяет непустой список list к началу списка target
+void Prepend(FreeBlock*& target, FreeBlock* list) {
+    FreeBlock* tail = list;
+    while (tail->next != nullptr) {
+        tail = tail->next;
+    }
+    tail->next = target;
+    target = list;
+}
+
+// Признак того, что кэш потока уже разрушен. Переменная тривиальна и доступна до конца потока
+thread_local bool cache_destroyed = false;
+
+// Списки свободных блоков потока и их длины. Излишек сверх CacheLimit и блоки завершившегося
+// потока переходят в SharedState
+struct ThreadCache {
+    FreeBlock* free[CLASS_COUNT] = {};
+    size_t count[CLASS_COUNT] = {};
+
+    ~ThreadCache() {
+        SharedState& state = Shared();
+        lock_guard guard(state.lock);
+        for (size_t size_class = 0; size_class < CLASS_COUNT; ++size_class) {
+            if (free[size_class] != nullptr) {
+                Prepend(state.free[size_class], free[size_class]);
+            }
+        }
+        cache_destroyed = true;
+    }
+};
+
+thread_local ThreadCache cache;
+
+}  // namespace
+
+void* Pool::Allocate(size_t size) {
+    if (size > MAX_SIZE) {
+        return ::operator new(size);
+    }
+    const size_t size_class = SizeClass(size);
+    if (!cache_destroyed) {
+        FreeBlock*& head = cache.free[size_class];
+        size_t& count = cache.count[size_class];
+        if (head == nullptr) {
+            SharedState& state = Shared();
+            lock_guard guard(state.lock);
+            // Поток забирает сразу половину допустимого запаса, чтобы реже брать блокировку
+            if (state.free[size_class] != nullptr) {
+                head = state.free[size_class];
+                state.free[size_class] = CutAfter(head, CacheLimit(size_class) / 2, count);
+            } else {
+                head = CarveChunk(state, size_class);
+                count = CHUNK_SIZE / BlockSize(size_class);
+            }
+        }
+        FreeBlock* block = head;
+        head = block->next;
+        --count;
+        return block;
+    }
+
+    SharedState& state = Shared();
+    lock_guard guard(state.lock);
+    FreeBlock*& head = state.free[size_class];
+    if (head == nullptr) {
+        head = CarveChunk(state, size_class);
+    }
+    FreeBlock* block = head;
+    head = block->next;
+    return block;
+}
+
+void Pool::Deallocate(void* ptr, size_t size) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (size > MAX_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    const size_t size_class = SizeClass(size);
+    if (!cache_destroyed) {
+        FreeBlock*& head = cache.free[size_class];
+        size_t& count = cache.count[size_class];
+        head = new (ptr) FreeBlock{head};
+        const size_t limit = CacheLimit(size_class);
+        if (++count > limit) {
+            // Излишек уходит в общий список, откуда его заберут потоки, которым не хватает блоков
+            FreeBlock* excess = CutAfter(head, limit / 2, count);
+            SharedState& state = Shared();
+            lock_guard guard(state.lock);
+            Prepend(state.free[size_class], excess);
+        }
+        return;
+    }
+
+    SharedState& state = Shared();
+    lock_guard guard(state.lock);
+    state.free[size_class] = new (ptr) FreeBlock{state.free[size_class]};
+}
+
+size_t Pool::GetChunkCount() {
+    SharedState& state = Shared();
+    lock_guard guard(state.lock);
+    return state.chunks.size();
+}
+
+}  // namespace runtime
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace runtime {
+
+/*
+ * Пул памяти для объектов, которые программа часто создаёт и удаляет, например экземпляров
+ * классов и их слотов. Запрос до MAX_SIZE байт округляется вверх до класса размеров, кратного
+ * GRANULARITY. Блок класса берётся из списка свободных блоков текущего потока, а когда список
+ * пуст - берётся из общего списка либо нарезается из участка в CHUNK_SIZE байт. Освобождённый
+ * блок попадает в список того потока, который его освободил, поэтому объект можно удалить
+ * не в том потоке, где он создан. Поток держит у себя ограниченный запас блоков каждого класса,
+ * а излишек, как и блоки завершившегося потока, отдаёт в общий список другим потокам.
+ * Участки не возвращаются системе. Запросы больше MAX_SIZE обслуживает ::operator new
+ */
+class Pool {
+public:
+    static constexpr size_t GRANULARITY = 16;
+    static constexpr size_t MAX_SIZE = 512;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    Pool() = delete;
+
+    // Выделяет size байт, выровненных по GRANULARITY (или по max_align_t для крупных блоков)
+    [[nodiscard]] static void* Allocate(size_t size);
+    // Освобождает блок, выделенный Allocate с тем же size
+    static void Deallocate(void* ptr, size_t size) noexcept;
+
+    // Возвращает число участков, полученных пулом у системы
+    [[nodiscard]] static size_t GetChunkCount();
+};
+
+// Аллокатор для стандартных контейнеров, берущий память из Pool
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& /*other*/) noexcept {  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+    }
+
+    [[nodiscard]] T* allocate(size_t n) {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(Pool::Allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        Pool::Deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>& /*other*/) const noexcept {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>& /*other*/) const noexcept {
+        return false;
+    }
+};
+
+}  // namespace runtime
@@ -1,24 +1,122 @@
 #include "runtime.h"
 
+#include "gc.h"
+
+#include <algorithm>
 #include <cassert>
+#include <mutex>
 #include <optional>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
 
 using namespace std;
 
 namespace runtime {
 
-    ObjectHolder::ObjectHolder(std::shared_ptr<Object> data)
-        : data_(std::move(data)) {
+    namespace {
+
+        const Symbol SELF{"self"sv};
+        const Symbol STR_METHOD{"__str__"sv};
+        const Symbol EQ_METHOD{"__eq__"sv};
+        const Symbol LT_METHOD{"__lt__"sv};
+        const Symbol ADD_METHOD{"__add__"sv};
+
+        // Возвращает объект, вид которого уже проверен вызывающим кодом
+        template <typename T>
+        T& As(const ObjectHolder& object) {
+            assert(object.GetKind() == KIND_OF<T>);
+            return static_cast<T&>(*object.Get());
+        }
+
+        // Владельцы объектов сверх Object::MAX_REF_COUNT. Объект с такими владельцами может
+        // перейти в другой поток вместе с остальными значениями программы, поэтому таблица
+        // общая. К ней обращаются только объекты с заполненным счётчиком
+        struct OverflowRefs {
+            std::mutex lock;
+            std::unordered_map<const Object*, size_t> counts;
+        };
+
+        OverflowRefs& GetOverflowRefs() {
+            // Таблица не разрушается: объекты могут освобождаться и при завершении программы
+            static auto* refs = new OverflowRefs;
+            return *refs;
+        }
+
+    }  // namespace
+
+    void Object::AddOverflowRef() const {
+        OverflowRefs& refs = GetOverflowRefs();
+        std::lock_guard guard(refs.lock);
+        ++refs.counts[this];
+    }
+
+    bool Object::ReleaseOverflowRef() const noexcept {
+        OverflowRefs& refs = GetOverflowRefs();
+        std::lock_guard guard(refs.lock);
+        auto it = refs.counts.find(this);
+        if (it == refs.counts.end()) {
+            return false;
+        }
+        if (--it->second == 0) {
+            refs.counts.erase(it);
+        }
+        return true;
+    }
+
+    size_t Object::GetRefCount() const {
+        if (ref_count_ != MAX_REF_COUNT) {
+            return ref_count_;
+        }
+        OverflowRefs& refs = GetOverflowRefs();
+        std::lock_guard guard(refs.lock);
+        auto it = refs.counts.find(this);
+        return MAX_REF_COUNT + (it == refs.counts.end() ? 0 : it->second);
+    }
+
+    ObjectHolder::ObjectHolder(Object* owned)
+        : tag_(Tag::Heap) {
+        storage_.object = owned;
+        owned->ref_count_ = 1;
+        // Циклы могут образовать только экземпляры классов: остальные объекты не хранят ссылок
+        // на экземпляры
+        if (owned->GetKind() == Kind::ClassInstance) {
+            if (CycleCollector* collector = CycleCollector::Current()) {
+                collector->Track(static_cast<ClassInstance&>(*owned));
+            }
+        }
+    }
+
+    ObjectHolder::ObjectHolder(Number number)
+        : tag_(Tag::Number) {
+        new (&storage_.number) Number(number);
+    }
+
+    ObjectHolder::ObjectHolder(Bool boolean)
+        : tag_(Tag::Bool) {
+        new (&storage_.boolean) Bool(boolean);
     }
 
     void ObjectHolder::AssertIsValid() const {
-        assert(data_ != nullptr);
+        assert(tag_ != Tag::None);
     }
 
     ObjectHolder ObjectHolder::Share(Object& object) {
-        // Возвращаем невладеющий shared_ptr (его deleter ничего не делает)
-        return ObjectHolder(std::shared_ptr<Object>(&object, [](auto* /*p*/) { /* do nothing */ }));
+        ObjectHolder result;
+        result.tag_ = Tag::Shared;
+        result.storage_.object = &object;
+        return result;
+    }
+
+    ObjectHolder ObjectHolder::Retain(Object& object) {
+        if (object.ref_count_ == 0) {
+            return Share(object);
+        }
+        ObjectHolder result;
+        result.tag_ = Tag::Heap;
+        result.storage_.object = &object;
+        AddRef(object);
+        return result;
     }
 
     ObjectHolder ObjectHolder::None() {
@@ -35,131 +133,294 @@ namespace runtime {
         return Get();
     }
 
-    Object* ObjectHolder::Get() const {
-        return data_.get();
-    }
-
     ObjectHolder::operator bool() const {
-        return Get() != nullptr;
+        return tag_ != Tag::None;
     }
 
     bool IsTrue(const ObjectHolder& object) {
-        // Заглушка. Реализуйте метод самостоятельно
-        using namespace std::literals;
-        if (!object) {
-            return false;
+        switch (object.GetKind()) {
+            case Kind::String:
+                return As<String>(object).GetSize() != 0;
+            case Kind::Number:
+                return As<Number>(object).GetValue() != 0;
+            case Kind::Bool:
+                return As<Bool>(object).GetValue();
+            default:
+                return false;
         }
-
-        String* str_ptr = object.TryAs<String>();
-        if (str_ptr) {
-            return !str_ptr->GetValue().empty();
-        }
-
-        Number* num_ptr = object.TryAs<Number>();
-        if (num_ptr) {
-            return num_ptr->GetValue();
-        }
-        
-        Bool* bool_ptr = object.TryAs<Bool>();
-        if (bool_ptr) {
-            return bool_ptr->GetValue();
-        }
-
-        return false;
     }
 
     void ClassInstance::Print(std::ostream& os, Context& context) {
 
-        if (HasMethod("__str__"s, 0)) {
-            ObjectHolder str_res = Call("__str__"s, {}, context);
-            if (String* str_ptr = str_res.TryAs<String>(); str_ptr) {
-                os << str_ptr->GetValue();
-                return;
-            }
-            else if (Number* num_ptr = str_res.TryAs<Number>(); num_ptr) {
-                os << num_ptr->GetValue();
-                return;
-            }
-            else if (Bool* bool_ptr = str_res.TryAs<Bool>(); bool_ptr) {
-                os << bool_ptr->GetValue();
-                return;
+        if (HasMethod(STR_METHOD, 0)) {
+            ObjectHolder str_res = Call(STR_METHOD, {}, context);
+            switch (str_res.GetKind()) {
+                case Kind::String:
+                    os << As<String>(str_res).GetValue();
+                    return;
+                case Kind::Number:
+                    os << As<Number>(str_res).GetValue();
+                    return;
+                case Kind::Bool:
+                    os << As<Bool>(str_res).GetValue();
+                    return;
+                default:
+                    break;
             }
         }
         os << this;
     }
 
-    bool ClassInstance::HasMethod(const std::string& method, size_t argument_count) const {
+    bool ClassInstance::HasMethod(Symbol method, size_t argument_count) const {
+        return cls_ != nullptr && cls_->GetMethod(method, argument_count) != nullptr;
+    }
 
-        if (!cls_) {
-            return false;
+    const ObjectHolder* ClassInstance::FindField(Symbol name) const {
+        if (dictionary_) {
+            auto it = dictionary_->find(name);
+            return it == dictionary_->end() ? nullptr : &it->second;
         }
+        size_t slot = shape_->FindSlot(name);
+        return slot == Shape::NOT_FOUND ? nullptr : &slots_[slot];
+    }
 
-        const Method* searched_method = cls_->GetMethod(method);
+    ObjectHolder* ClassInstance::FindField(Symbol name) {
+        return const_cast<ObjectHolder*>(std::as_const(*this).FindField(name));
+    }
 
-        if (searched_method == nullptr) {
-            return false;
+    void ClassInstance::SetField(Symbol name, ObjectHolder value) {
+        if (ObjectHolder* field = FindField(name)) {
+            *field = std::move(value);
+            return;
         }
-
-        return searched_method->formal_params.size() == argument_count;
+        if (!dictionary_ && slots_.size() < Shape::MAX_FIELD_COUNT) {
+            AppendSlot(shape_->AddField(name), std::move(value));
+            return;
+        }
+        MakeDictionary();
+        dictionary_->emplace(name, std::move(value));
     }
 
     Closure& ClassInstance::Fields() {
-        return fields_;
+        MakeDictionary();
+        return *dictionary_;
     }
 
-    const Closure& ClassInstance::Fields() const {
-        return fields_;
+    Closure ClassInstance::Fields() const {
+        if (dictionary_) {
+            return *dictionary_;
+        }
+        Closure fields;
+        const auto& names = shape_->GetFieldNames();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            fields.emplace(names[i], slots_[i]);
+        }
+        return fields;
     }
 
-    ClassInstance::ClassInstance(const Class& cls) : cls_(&cls){
+    const Shape* ClassInstance::GetShape() const {
+        return shape_;
+    }
 
+    void ClassInstance::AppendSlot(const Shape* shape, ObjectHolder value) {
+        shape_ = shape;
+        slots_.push_back(std::move(value));
+        std::atomic<size_t>& expected = cls_->expected_field_count_.value;
+        size_t current = expected.load(std::memory_order_relaxed);
+        while (slots_.size() > current
+               && !expected.compare_exchange_weak(current, slots_.size(), std::memory_order_relaxed)) {
+        }
     }
 
-    ObjectHolder ClassInstance::Call(const std::string& method,
+    void ClassInstance::MakeDictionary() {
+        if (dictionary_) {
+            return;
+        }
+        dictionary_ = std::make_unique<Closure>();
+        const auto& names = shape_->GetFieldNames();
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            dictionary_->emplace(names[i], std::move(slots_[i]));
+        }
+        slots_.clear();
+        slots_.shrink_to_fit();
+        shape_ = nullptr;
+    }
+
+    ClassInstance::ClassInstance(const Class& cls) : Object(Kind::ClassInstance), cls_(&cls), shape_(cls.GetRootShape()) {
+        slots_.reserve(cls.GetExpectedFieldCount());
+
+    }
+
+    ClassInstance::~ClassInstance() {
+        if (collector_link_.collector != nullptr) {
+            collector_link_.collector->Untrack(*this);
+        }
+    }
+
+    const Class& ClassInstance::GetClass() const {
+        return *cls_;
+    }
+
+    ObjectHolder ClassInstance::Call(Symbol method,
         const std::vector<ObjectHolder>& actual_args,
         Context& context) {
 
-        if (HasMethod(method, actual_args.size())) {
-            const Method* method_for_call = cls_->GetMethod(method);
-            Closure method_closure;
-            const auto& args = method_for_call->formal_params;
-
-            for (size_t i = 0; i < actual_args.size(); ++i) {
-                method_closure[args[i]] = actual_args[i];
-            }
-            method_closure["self"s] = ObjectHolder::Share(*this);
-            auto result = method_for_call->body->Execute(method_closure, context);
-            return result;
+        if (const Method* method_for_call = cls_->GetMethod(method, actual_args.size())) {
+            return Call(*method_for_call, actual_args, context);
         }
         throw std::runtime_error("Incorrect call"s);
     }
 
-    Class::Class(std::string name, std::vector<Method> methods, const Class* parent) : name_(std::move(name)), methods_(std::move(methods)), parent_(parent) {
-    }
+    ObjectHolder ClassInstance::Call(const Method& method,
+        const std::vector<ObjectHolder>& actual_args,
+        Context& context) {
 
-    const Method* Class::GetMethod(const std::string& name) const {
+        if (method.formal_params.size() != actual_args.size()) {
+            throw std::runtime_error("Incorrect call"s);
+        }
+        Closure method_closure;
+        const auto& args = method.formal_params;
 
-        for (const Method& method : methods_) {
-            if (method.name == name) {
-                return &method;
-            }
+        for (size_t i = 0; i < actual_args.size(); ++i) {
+            method_closure[args[i]] = actual_args[i];
         }
+        // self удерживает объект, пока выполняется метод, и может быть сохранён в поле
+        method_closure[SELF] = ObjectHolder::Retain(*this);
+        return method.body->Execute(method_closure, context);
+    }
 
+    Class::Class(std::string name, std::vector<Method> methods, const Class* parent) : Object(Kind::Class), name_(std::move(name)), methods_(std::move(methods)), parent_(parent), root_shape_(std::make_unique<Shape>()) {
+        // Собственные методы перекрывают унаследованные, а таблица родителя уже содержит
+        // методы всех его предков
+        for (const Method& method : methods_) {
+            method_table_.emplace(method.name, MethodEntry{&method, method.formal_params.size()});
+        }
         if (parent_) {
-            for (const Method& method : parent_->methods_) {
-                if (method.name == name) {
-                    return &method;
-                }
-            }
+            method_table_.insert(parent_->method_table_.begin(), parent_->method_table_.end());
         }
-        
-        return nullptr;
+    }
+
+    const Method* Class::GetMethod(Symbol name) const {
+        auto it = method_table_.find(name);
+        return it == method_table_.end() ? nullptr : it->second.method;
+    }
+
+    const Method* Class::GetMethod(Symbol name, size_t argument_count) const {
+        auto it = method_table_.find(name);
+        if (it == method_table_.end() || it->second.arity != argument_count) {
+            return nullptr;
+        }
+        return it->second.method;
     }
 
     [[nodiscard]] const std::string& Class::GetName() const {
         return name_;
     }
 
+    const std::vector<Method>& Class::GetMethods() const {
+        return methods_;
+    }
+
+    const Class* Class::GetParent() const {
+        return parent_;
+    }
+
+    const Shape* Class::GetRootShape() const {
+        return root_shape_.get();
+    }
+
+    size_t Class::GetExpectedFieldCount() const {
+        return expected_field_count_.value.load(std::memory_order_relaxed);
+    }
+
+    Shape::Shape(const Shape& parent, Symbol name)
+        : field_names_(parent.field_names_), slot_by_name_(parent.slot_by_name_) {
+        slot_by_name_.emplace(name, field_names_.size());
+        field_names_.push_back(name);
+    }
+
+    size_t Shape::FindSlot(Symbol name) const {
+        auto it = slot_by_name_.find(name);
+        return it == slot_by_name_.end() ? NOT_FOUND : it->second;
+    }
+
+    const Shape* Shape::AddField(Symbol name) const {
+        std::lock_guard guard(transitions_mutex_);
+        std::unique_ptr<Shape>& next = transitions_[name];
+        if (!next) {
+            next.reset(new Shape(*this, name));
+        }
+        return next.get();
+    }
+
+    const std::vector<Symbol>& Shape::GetFieldNames() const {
+        return field_names_;
+    }
+
+    const ObjectHolder* FieldCache::Load(const ClassInstance& instance, Symbol name) {
+        if (shape_ != nullptr && instance.shape_ == shape_) {
+            return &instance.slots_[slot_];
+        }
+        const ObjectHolder* field = instance.FindField(name);
+        if (field != nullptr && instance.shape_ != nullptr) {
+            shape_ = shape_after_store_ = instance.shape_;
+            slot_ = static_cast<size_t>(field - instance.slots_.data());
+        }
+        return field;
+    }
+
+    const Method* MethodCache::Find(const Class& cls, Symbol name) {
+        if (entry_count_ > 0 && entries_[0].cls == &cls) {
+            ++stats_.monomorphic_hits;
+            return entries_[0].method;
+        }
+        for (size_t i = 1; i < entry_count_; ++i) {
+            if (entries_[i].cls == &cls) {
+                ++stats_.polymorphic_hits;
+                return entries_[i].method;
+            }
+        }
+
+        ++stats_.misses;
+        const Method* method = cls.GetMethod(name);
+        if (entry_count_ < MAX_ENTRIES) {
+            entries_[entry_count_++] = {&cls, method};
+        } else {
+            megamorphic_ = true;
+        }
+        return method;
+    }
+
+    const CallCacheStats& MethodCache::GetStats() const {
+        return stats_;
+    }
+
+    size_t MethodCache::GetEntryCount() const {
+        return entry_count_;
+    }
+
+    bool MethodCache::IsMegamorphic() const {
+        return megamorphic_;
+    }
+
+    void FieldCache::Store(ClassInstance& instance, Symbol name, ObjectHolder value) {
+        if (shape_ != nullptr && instance.shape_ == shape_) {
+            if (shape_after_store_ == shape_) {
+                instance.slots_[slot_] = std::move(value);
+            } else {
+                instance.AppendSlot(shape_after_store_, std::move(value));
+            }
+            return;
+        }
+        const Shape* shape_before_store = instance.shape_;
+        instance.SetField(name, std::move(value));
+        if (shape_before_store != nullptr && instance.shape_ != nullptr) {
+            shape_ = shape_before_store;
+            shape_after_store_ = instance.shape_;
+            slot_ = shape_after_store_->FindSlot(name);
+        }
+    }
+
     void Class::Print(ostream& os, Context& context) {
         if (!os) {
             auto& output = context.GetOutputStream();
@@ -169,47 +430,127 @@ namespace runtime {
         os << "Class " << name_;
     }
 
-    void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
-        os << (GetValue() ? "True"sv : "False"sv);
+    String::String()
+        : Object(Kind::String) {
     }
 
-    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    String::String(std::string value)
+        : Object(Kind::String), value_(std::move(value)), size_(value_.size()) {
+    }
 
-        if (!lhs && !rhs) {
-            return true;
+    String::String(const String& other)
+        : Object(other), value_(other.GetValue()), size_(other.size_) {
+    }
+
+    String::~String() {
+        if (IsRope()) {
+            ReleaseParts();
         }
+    }
 
-        if (!lhs || !rhs) {
-            throw std::runtime_error("Cannot compare objects for equality"s);
+    ObjectHolder String::Concat(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        const String& lhs_str = As<String>(lhs);
+        const String& rhs_str = As<String>(rhs);
+        const size_t size = lhs_str.size_ + rhs_str.size_;
+        if (size < MIN_ROPE_SIZE) {
+            // Части короче MIN_ROPE_SIZE всегда собраны
+            std::string value;
+            value.reserve(size);
+            value += lhs_str.value_;
+            value += rhs_str.value_;
+            return ObjectHolder::Own(String(std::move(value)));
+        }
+        if (rhs_str.size_ == 0) {
+            return lhs;
         }
+        if (lhs_str.size_ == 0) {
+            return rhs;
+        }
+        String result;
+        result.lhs_ = lhs;
+        result.rhs_ = rhs;
+        result.size_ = size;
+        return ObjectHolder::Own(std::move(result));
+    }
 
-        String* lhs_ptr_str = lhs.TryAs<String>();
-        String* rhs_ptr_str = rhs.TryAs<String>();
-        if (lhs_ptr_str && rhs_ptr_str) {
-            return lhs_ptr_str->GetValue() == rhs_ptr_str->GetValue();
+    const std::string& String::GetValue() const {
+        if (IsRope()) {
+            Flatten();
         }
+        return value_;
+    }
+
+    void String::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+        os << GetValue();
+    }
 
-        Number* lhs_ptr_num = lhs.TryAs<Number>();
-        Number* rhs_ptr_num = rhs.TryAs<Number>();
-        if (lhs_ptr_num && rhs_ptr_num) {
-            return lhs_ptr_num->GetValue() == rhs_ptr_num->GetValue();
+    void String::Flatten() const {
+        std::string value;
+        value.reserve(size_);
+        // Части обходятся слева направо без рекурсии: глубина цепочки конкатенаций не ограничена
+        std::vector<const String*> pending{this};
+        while (!pending.empty()) {
+            const String* part = pending.back();
+            pending.pop_back();
+            if (part->IsRope()) {
+                pending.push_back(&As<String>(part->rhs_));
+                pending.push_back(&As<String>(part->lhs_));
+            } else {
+                value += part->value_;
+            }
         }
+        value_ = std::move(value);
+        ReleaseParts();
+    }
 
-        Bool* lhs_ptr_bool = lhs.TryAs<Bool>();
-        Bool* rhs_ptr_bool = rhs.TryAs<Bool>();
-        if (lhs_ptr_bool && rhs_ptr_bool) {
-            return lhs_ptr_bool->GetValue() == rhs_ptr_bool->GetValue();
+    void String::ReleaseParts() const {
+        // Части, которыми владеет только эта строка, разбираются до удаления, поэтому
+        // длинная цепочка конкатенаций освобождается без рекурсии
+        std::vector<ObjectHolder> pending;
+        pending.push_back(std::move(lhs_));
+        pending.push_back(std::move(rhs_));
+        while (!pending.empty()) {
+            ObjectHolder part = std::move(pending.back());
+            pending.pop_back();
+            if (part.IsUnique()) {
+                const String& str = As<String>(part);
+                if (str.IsRope()) {
+                    pending.push_back(std::move(str.lhs_));
+                    pending.push_back(std::move(str.rhs_));
+                }
+            }
         }
+    }
 
-        ClassInstance* lhs_instance = lhs.TryAs<ClassInstance>();
-        ClassInstance* rhs_instance = rhs.TryAs<ClassInstance>();
+    void Bool::Print(std::ostream& os, [[maybe_unused]] Context& context) {
+        os << (GetValue() ? "True"sv : "False"sv);
+    }
+
+    bool Equal(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
 
-        if (!lhs_instance || !rhs_instance) {
+        const Kind kind = lhs.GetKind();
+        if (kind != rhs.GetKind()) {
             throw std::runtime_error("Cannot compare objects for equality"s);
         }
 
-        if (lhs_instance->HasMethod("__eq__"s, 1)) {
-            return IsTrue(lhs_instance->Call("__eq__"s, { ObjectHolder::Share(*rhs_instance) }, context));
+        switch (kind) {
+            case Kind::None:
+                return true;
+            case Kind::String:
+                return As<String>(lhs).GetValue() == As<String>(rhs).GetValue();
+            case Kind::Number:
+                return As<Number>(lhs).GetValue() == As<Number>(rhs).GetValue();
+            case Kind::Bool:
+                return As<Bool>(lhs).GetValue() == As<Bool>(rhs).GetValue();
+            case Kind::ClassInstance: {
+                auto& lhs_instance = As<ClassInstance>(lhs);
+                if (lhs_instance.HasMethod(EQ_METHOD, 1)) {
+                    return IsTrue(lhs_instance.Call(EQ_METHOD, { rhs }, context));
+                }
+                break;
+            }
+            default:
+                break;
         }
 
         throw std::runtime_error("Cannot compare objects for equality"s);
@@ -217,41 +558,115 @@ namespace runtime {
 
     bool Less(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
 
-        if (!lhs || !rhs) {
+        const Kind kind = lhs.GetKind();
+        if (kind != rhs.GetKind()) {
             throw std::runtime_error("Cannot compare objects for less"s);
         }
 
-        String* lhs_ptr_str = lhs.TryAs<String>();
-        String* rhs_ptr_str = rhs.TryAs<String>();
-        if (lhs_ptr_str && rhs_ptr_str) {
-            return lhs_ptr_str->GetValue() < rhs_ptr_str->GetValue();
+        switch (kind) {
+            case Kind::String:
+                return As<String>(lhs).GetValue() < As<String>(rhs).GetValue();
+            case Kind::Number:
+                return As<Number>(lhs).GetValue() < As<Number>(rhs).GetValue();
+            case Kind::Bool:
+                return As<Bool>(lhs).GetValue() < As<Bool>(rhs).GetValue();
+            case Kind::ClassInstance: {
+                auto& lhs_instance = As<ClassInstance>(lhs);
+                if (lhs_instance.HasMethod(LT_METHOD, 1)) {
+                    return IsTrue(lhs_instance.Call(LT_METHOD, { rhs }, context));
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        throw std::runtime_error("Cannot compare objects for less"s);
+    }
+
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+
+        Number* lhs_num = lhs.TryAs<Number>();
+        Number* rhs_num = rhs.TryAs<Number>();
+        if (lhs_num && rhs_num) {
+            return ObjectHolder::Own(Number(lhs_num->GetValue() + rhs_num->GetValue()));
         }
 
-        Number* lhs_ptr_num = lhs.TryAs<Number>();
-        Number* rhs_ptr_num = rhs.TryAs<Number>();
-        if (lhs_ptr_num && rhs_ptr_num) {
-            return lhs_ptr_num->GetValue() < rhs_ptr_num->GetValue();
+        if (lhs.GetKind() == Kind::String && rhs.GetKind() == Kind::String) {
+            return String::Concat(lhs, rhs);
         }
 
-        Bool* lhs_ptr_bool = lhs.TryAs<Bool>();
-        Bool* rhs_ptr_bool = rhs.TryAs<Bool>();
-        if (lhs_ptr_bool && rhs_ptr_bool) {
-            return lhs_ptr_bool->GetValue() < rhs_ptr_bool->GetValue();
+        if (ClassInstance* lhs_instance = lhs.TryAs<ClassInstance>(); lhs_instance) {
+            if (lhs_instance->HasMethod(ADD_METHOD, 1)) {
+                return lhs_instance->Call(ADD_METHOD, { rhs }, context);
+            }
+            throw std::runtime_error("lhs does not have method __add__"s);
         }
 
-        
-        ClassInstance* lhs_instance = lhs.TryAs<ClassInstance>();
-        ClassInstance* rhs_instance = rhs.TryAs<ClassInstance>();
+        throw std::runtime_error("Can't add arguments with given types"s);
+    }
 
-        if (!lhs_instance || !rhs_instance) {
-            throw std::runtime_error("Cannot compare objects for equality"s);
+    ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        Number* lhs_num = lhs.TryAs<Number>();
+        Number* rhs_num = rhs.TryAs<Number>();
+        if (lhs_num && rhs_num) {
+            return ObjectHolder::Own(Number(lhs_num->GetValue() - rhs_num->GetValue()));
         }
+        throw std::runtime_error("Can't sub given types"s);
+    }
 
-        if (lhs_instance->HasMethod("__lt__"s, 1)) {
-            return IsTrue(lhs_instance->Call("__lt__"s, { ObjectHolder::Share(*rhs_instance) }, context));
+    ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        Number* lhs_num = lhs.TryAs<Number>();
+        Number* rhs_num = rhs.TryAs<Number>();
+        if (lhs_num && rhs_num) {
+            return ObjectHolder::Own(Number(lhs_num->GetValue() * rhs_num->GetValue()));
         }
+        throw std::runtime_error("Can't multiply given types"s);
+    }
 
-        throw std::runtime_error("Cannot compare objects for less"s);
+    ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs) {
+        Number* lhs_num = lhs.TryAs<Number>();
+        Number* rhs_num = rhs.TryAs<Number>();
+        if (lhs_num && rhs_num) {
+            if (rhs_num->GetValue() == 0) {
+                throw std::runtime_error("Can't divide by 0"s);
+            }
+            return ObjectHolder::Own(Number(lhs_num->GetValue() / rhs_num->GetValue()));
+        }
+        throw std::runtime_error("Can't divide given types"s);
+    }
+
+    ObjectHolder Stringify(const ObjectHolder& object) {
+
+        switch (object.GetKind()) {
+            case Kind::String:
+                // Строки неизменяемы, поэтому str() возвращает ту же строку. Невладеющая ссылка
+                // (например, на константу) может пережить объект, поэтому строка копируется
+                if (object.IsOwner()) {
+                    return object;
+                }
+                return ObjectHolder::Own(String(As<String>(object).GetValue()));
+            case Kind::Number:
+                return ObjectHolder::Own(String(to_string(As<Number>(object).GetValue())));
+            case Kind::Bool:
+                return ObjectHolder::Own(String(As<Bool>(object).GetValue() ? "True"s : "False"s));
+            case Kind::ClassInstance: {
+                auto& instance = As<ClassInstance>(object);
+                // Вывод метода __str__ при вызове str() не попадает в программу
+                DummyContext context;
+                try {
+                    return Stringify(instance.Call(STR_METHOD, {}, context));
+                }
+                catch (...) {
+
+                }
+                std::ostringstream os;
+                os << &instance;
+                return ObjectHolder::Own(String(os.str()));
+            }
+            default:
+                return ObjectHolder::Own(String("None"s));
+        }
     }
 
     bool NotEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
@@ -270,4 +685,92 @@ namespace runtime {
         return !Less(lhs, rhs, context);
     }
 
+    BufferedContext::Buffer::Buffer(std::ostream& output, size_t size, OutputBuffering buffering)
+        : output_(output), data_(std::max<size_t>(size, 1)), buffering_(buffering) {
+        Drain();
+    }
+
+    bool BufferedContext::Buffer::Drain() {
+        if (pptr() != pbase()) {
+            output_.write(pbase(), pptr() - pbase());
+            output_.flush();
+        }
+        // В построчном режиме область записи пуста, и каждый символ проходит через overflow,
+        // который замечает конец строки
+        char* data = data_.data();
+        setp(data, buffering_ == OutputBuffering::Full ? data + data_.size() : data);
+        return static_cast<bool>(output_);
+    }
+
+    BufferedContext::Buffer::int_type BufferedContext::Buffer::overflow(int_type ch) {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return Drain() ? traits_type::not_eof(ch) : traits_type::eof();
+        }
+        if (pptr() == data_.data() + data_.size() && !Drain()) {
+            return traits_type::eof();
+        }
+
+        const char c = traits_type::to_char_type(ch);
+        *pptr() = c;
+        Advance(1);
+        if (buffering_ == OutputBuffering::Line && c == '\n' && !Drain()) {
+            return traits_type::eof();
+        }
+        return ch;
+    }
+
+    std::streamsize BufferedContext::Buffer::xsputn(const char* s, std::streamsize count) {
+        std::streamsize written = 0;
+        while (written < count) {
+            const std::streamsize space = data_.data() + data_.size() - pptr();
+            if (space == 0) {
+                if (!Drain()) {
+                    return written;
+                }
+                continue;
+            }
+            const std::streamsize chunk = std::min(space, count - written);
+            std::copy_n(s + written, chunk, pptr());
+            Advance(chunk);
+            written += chunk;
+        }
+        if (buffering_ == OutputBuffering::Line && std::find(s, s + count, '\n') != s + count) {
+            Drain();
+        }
+        return written;
+    }
+
+    void BufferedContext::Buffer::Advance(std::streamsize count) {
+        if (buffering_ == OutputBuffering::Full) {
+            pbump(static_cast<int>(count));
+            return;
+        }
+        const std::streamsize offset = pptr() - pbase() + count;
+        setp(pbase(), pbase() + offset);
+        pbump(static_cast<int>(offset));
+    }
+
+    int BufferedContext::Buffer::sync() {
+        return Drain() ? 0 : -1;
+    }
+
+    BufferedContext::BufferedContext(std::ostream& output, size_t buffer_size, OutputBuffering buffering)
+        : buffer_(output, buffer_size, buffering), stream_(&buffer_) {
+    }
+
+    BufferedContext::~BufferedContext() {
+        try {
+            buffer_.Drain();
+        }
+        catch (...) {
+            // Деструктор не должен выбрасывать исключений. Ошибку записи можно узнать, вызвав Flush
+        }
+    }
+
+    void BufferedContext::Flush() {
+        if (!stream_.flush()) {
+            throw std::runtime_error("Failed to write program output"s);
+        }
+    }
+
 }  // namespace runtime
\ No newline at end of file
@@ -1,8 +1,19 @@
 #pragma once
 
+#include "pool.h"
+#include "symbol.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -18,30 +29,253 @@ namespace runtime {
         ~Context() = default;
     };
 
-    // Базовый класс для всех объектов языка Mython
+    /*
+     * Вид объекта Mython. Хранится в самом объекте, поэтому проверка типа значения сводится
+     * к одному чтению и сравнению вместо dynamic_cast. Объекты, тип которых не выражается
+     * видом (например, вспомогательные объекты тестов), имеют вид Other
+     */
+    enum class Kind : std::uint8_t {
+        // Пустое значение (None). Объекты такого вида не бывают, его возвращает ObjectHolder
+        None,
+        Other,
+        String,
+        Number,
+        Bool,
+        Class,
+        ClassInstance,
+    };
+
+    // Базовый класс для всех объектов языка Mython.
+    // Объекты в куче размещаются в Pool, поэтому ObjectHolder::Own не обращается к malloc
     class Object {
     public:
         virtual ~Object() = default;
+
+        static void* operator new(size_t size) {
+            return Pool::Allocate(size);
+        }
+        // Виртуальный деструктор передаёт сюда размер объекта его настоящего типа
+        static void operator delete(void* ptr, size_t size) noexcept {
+            Pool::Deallocate(ptr, size);
+        }
+        static void* operator new(size_t /*size*/, void* place) noexcept {
+            return place;
+        }
+        static void operator delete(void* /*ptr*/, void* /*place*/) noexcept {
+        }
+
         // выводит в os своё представление в виде строки
         virtual void Print(std::ostream& os, Context& context) = 0;
+
+        // Возвращает вид объекта
+        [[nodiscard]] Kind GetKind() const {
+            return static_cast<Kind>(kind_);
+        }
+
+    protected:
+        Object()
+            : kind_(static_cast<std::uint8_t>(Kind::Other)), ref_count_(0) {
+        }
+        explicit Object(Kind kind)
+            : kind_(static_cast<std::uint8_t>(kind)), ref_count_(0) {
+        }
+        // Копия объекта - новый объект, на который ещё никто не ссылается
+        Object(const Object& other)
+            : kind_(other.kind_), ref_count_(0) {
+        }
+        Object& operator=(const Object& /*other*/) {
+            return *this;
+        }
+
+    private:
+        friend class ObjectHolder;
+        friend class CycleCollector;
+
+        // Наибольшее значение счётчика в объекте. Владельцы сверх него учитываются в общей
+        // таблице переполненных счётчиков, к которой обращаются только такие объекты
+        static constexpr std::uint32_t MAX_REF_COUNT = (1U << 24) - 1;
+
+        // Учитывает ещё одного владельца объекта с заполненным счётчиком
+        void AddOverflowRef() const;
+        // Снимает владельца из таблицы переполненных счётчиков. Возвращает false, если их
+        // там не осталось и владелец учтён в самом счётчике
+        bool ReleaseOverflowRef() const noexcept;
+        // Возвращает полное число владельцев объекта
+        [[nodiscard]] std::size_t GetRefCount() const;
+
+        // Вид и счётчик ссылок занимают одно 32-битное слово, поэтому значение числа
+        // следует сразу за ними и Number, хранимый внутри ObjectHolder, не увеличивается
+        std::uint32_t kind_ : 8;
+        // Число ObjectHolder, владеющих объектом. Счётчик не атомарный: объектом, созданным
+        // при выполнении программы, владеет один поток (см. ObjectHolder)
+        mutable std::uint32_t ref_count_ : 24;
+    };
+
+    // Объект-значение, хранящий значение типа T
+    template <typename T>
+    class ValueObject : public Object {
+    public:
+        ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : Object(DefaultKind()), value_(v) {
+        }
+
+        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
+            os << value_;
+        }
+
+        [[nodiscard]] const T& GetValue() const {
+            return value_;
+        }
+
+    protected:
+        ValueObject(T v, Kind kind)
+            : Object(kind), value_(v) {
+        }
+
+    private:
+        static constexpr Kind DefaultKind() {
+            if constexpr (std::is_same_v<T, int>) {
+                return Kind::Number;
+            } else {
+                return Kind::Other;
+            }
+        }
+
+        T value_;
+    };
+
+    // Числовое значение
+    using Number = ValueObject<int>;
+
+    // Логическое значение
+    class Bool : public ValueObject<bool> {
+    public:
+        Bool(bool v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            : ValueObject<bool>(v, Kind::Bool) {
+        }
+
+        void Print(std::ostream& os, Context& context) override;
     };
 
-    // Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе
+    class String;
+    class Class;
+    class ClassInstance;
+    class CycleCollector;
+
+    // Вид, который имеют все объекты типа T и его наследников. Kind::Other означает, что тип
+    // по виду не распознаётся и проверять его приходится через dynamic_cast
+    template <typename T>
+    inline constexpr Kind KIND_OF = Kind::Other;
+    template <>
+    inline constexpr Kind KIND_OF<String> = Kind::String;
+    template <>
+    inline constexpr Kind KIND_OF<Number> = Kind::Number;
+    template <>
+    inline constexpr Kind KIND_OF<Bool> = Kind::Bool;
+    template <>
+    inline constexpr Kind KIND_OF<Class> = Kind::Class;
+    template <>
+    inline constexpr Kind KIND_OF<ClassInstance> = Kind::ClassInstance;
+
+    /*
+     * Специальный класс-обёртка, предназначенный для хранения объекта в Mython-программе.
+     * Числа (Number) и логические значения (Bool), созданные через Own, хранятся прямо внутри
+     * ObjectHolder, без выделения памяти в куче и без подсчёта ссылок. Остальные объекты
+     * хранятся в куче. Указатели, возвращаемые Get и TryAs для таких чисел и логических
+     * значений, указывают внутрь ObjectHolder и действительны, пока он существует и не изменён.
+     *
+     * Объекты в куче считают владеющие ими ObjectHolder сами (см. Object), без атомарных
+     * операций, поэтому объект и все ObjectHolder, владеющие им, должны использоваться одним
+     * потоком. Передать значения другому потоку можно только целиком, когда первый поток
+     * перестал с ними работать, через синхронизацию вроде std::future (так ThreadPool
+     * возвращает результат выполнения). Объекты, которые читают несколько потоков сразу,
+     * например константы скомпилированной программы, передаются невладеющими ссылками
+     * (Share, Borrow): их копирование не изменяет счётчик
+     */
     class ObjectHolder {
     public:
         // Создаёт пустое значение
         ObjectHolder() = default;
 
+        ObjectHolder(const ObjectHolder& other)
+            : tag_(other.tag_) {
+            switch (tag_) {
+                case Tag::None:
+                    break;
+                case Tag::Heap:
+                    storage_.object = other.storage_.object;
+                    AddRef(*storage_.object);
+                    break;
+                case Tag::Shared:
+                    storage_.object = other.storage_.object;
+                    break;
+                case Tag::Number:
+                    new (&storage_.number) Number(other.storage_.number.GetValue());
+                    break;
+                case Tag::Bool:
+                    new (&storage_.boolean) Bool(other.storage_.boolean.GetValue());
+                    break;
+            }
+        }
+
+        ObjectHolder(ObjectHolder&& other) noexcept {
+            MoveFrom(other);
+        }
+
+        ObjectHolder& operator=(const ObjectHolder& other) {
+            // Копия создаётся до освобождения текущего значения: other может принадлежать
+            // объекту, которым владеет этот ObjectHolder
+            if (this != &other) {
+                ObjectHolder copy(other);
+                Reset();
+                MoveFrom(copy);
+            }
+            return *this;
+        }
+
+        ObjectHolder& operator=(ObjectHolder&& other) noexcept {
+            if (this != &other) {
+                ObjectHolder moved(std::move(other));
+                Reset();
+                MoveFrom(moved);
+            }
+            return *this;
+        }
+
+        ~ObjectHolder() {
+            Reset();
+        }
+
         // Возвращает ObjectHolder, владеющий объектом типа T
         // Тип T - конкретный класс-наследник Object.
-        // object копируется или перемещается в кучу
+        // object копируется или перемещается в кучу, а числа и логические значения -
+        // внутрь ObjectHolder
         template <typename T>
         [[nodiscard]] static ObjectHolder Own(T&& object) {
-            return ObjectHolder(std::make_shared<T>(std::forward<T>(object)));
+            using Type = std::decay_t<T>;
+            if constexpr (std::is_same_v<Type, Number>) {
+                return ObjectHolder(Number(object));
+            } else if constexpr (std::is_same_v<Type, Bool>) {
+                return ObjectHolder(Bool(object));
+            } else {
+                return ObjectHolder(static_cast<Object*>(new Type(std::forward<T>(object))));
+            }
         }
 
         // Создаёт ObjectHolder, не владеющий объектом (аналог слабой ссылки)
         [[nodiscard]] static ObjectHolder Share(Object& object);
+        // Создаёт ещё одного владельца объекта, которым уже владеют ObjectHolder, например
+        // для self внутри метода. Объект, которым никто не владеет (созданный не через Own),
+        // передаётся невладеющей ссылкой, как в Share
+        [[nodiscard]] static ObjectHolder Retain(Object& object);
+        // Возвращает невладеющую ссылку на объект из кучи либо копию числа или логического значения.
+        // Копирование результата не изменяет счётчик ссылок объекта
+        [[nodiscard]] ObjectHolder Borrow() const {
+            if (tag_ == Tag::Heap) {
+                return Share(*storage_.object);
+            }
+            return *this;
+        }
         // Создаёт пустой ObjectHolder, соответствующий значению None
         [[nodiscard]] static ObjectHolder None();
 
@@ -51,47 +285,230 @@ namespace runtime {
 
         Object* operator->() const;
 
-        [[nodiscard]] Object* Get() const;
+        [[nodiscard]] Object* Get() const {
+            switch (tag_) {
+                case Tag::Heap:
+                case Tag::Shared:
+                    return storage_.object;
+                case Tag::Number:
+                    return &storage_.number;
+                case Tag::Bool:
+                    return &storage_.boolean;
+                default:
+                    return nullptr;
+            }
+        }
+
+        // Возвращает вид хранящегося объекта либо Kind::None, если ObjectHolder пуст
+        [[nodiscard]] Kind GetKind() const {
+            switch (tag_) {
+                case Tag::Heap:
+                case Tag::Shared:
+                    return storage_.object->GetKind();
+                case Tag::Number:
+                    return Kind::Number;
+                case Tag::Bool:
+                    return Kind::Bool;
+                default:
+                    return Kind::None;
+            }
+        }
 
         // Возвращает указатель на объект типа T либо nullptr, если внутри ObjectHolder не хранится
         // объект данного типа
         template <typename T>
         [[nodiscard]] T* TryAs() const {
-            return dynamic_cast<T*>(this->Get());
+            if constexpr (std::is_same_v<T, Number>) {
+                if (tag_ == Tag::Number) {
+                    return &storage_.number;
+                }
+            } else if constexpr (std::is_same_v<T, Bool>) {
+                if (tag_ == Tag::Bool) {
+                    return &storage_.boolean;
+                }
+            }
+            if constexpr (KIND_OF<T> != Kind::Other) {
+                // Вид объекта однозначно задаёт его тип, поэтому dynamic_cast не нужен
+                if (IsPointer() && storage_.object->GetKind() == KIND_OF<T>) {
+                    return static_cast<T*>(storage_.object);
+                }
+                return nullptr;
+            } else {
+                if (IsPointer()) {
+                    return dynamic_cast<T*>(storage_.object);
+                }
+                // Непосредственно хранятся только Number и Bool, другие типы среди них не встречаются
+                if constexpr (std::is_base_of_v<T, Number> || std::is_base_of_v<T, Bool>) {
+                    return tag_ == Tag::None ? nullptr : dynamic_cast<T*>(Get());
+                } else {
+                    return nullptr;
+                }
+            }
         }
 
         // Возвращает true, если ObjectHolder не пуст
         explicit operator bool() const;
 
+        // Возвращает true, если ObjectHolder владеет объектом в куче
+        [[nodiscard]] bool IsOwner() const {
+            return tag_ == Tag::Heap;
+        }
+
+        // Возвращает true, если ObjectHolder - единственный владелец объекта в куче
+        [[nodiscard]] bool IsUnique() const {
+            return tag_ == Tag::Heap && storage_.object->ref_count_ == 1;
+        }
+
     private:
-        explicit ObjectHolder(std::shared_ptr<Object> data);
+        // Способ хранения значения
+        enum class Tag : std::uint8_t {
+            None,
+            // Объект в куче, которым ObjectHolder владеет
+            Heap,
+            // Объект, которым ObjectHolder не владеет
+            Shared,
+            Number,
+            Bool,
+        };
+
+        // Пустое хранилище инициализировано, поэтому копирование и перенос никогда не читают
+        // неинициализированную память
+        union Storage {
+            Storage()
+                : object(nullptr) {
+            }
+            ~Storage() {
+            }
+
+            Object* object;
+            Number number;
+            Bool boolean;
+        };
+
+        // Становится владельцем объекта owned, только что созданного в куче
+        explicit ObjectHolder(Object* owned);
+        explicit ObjectHolder(Number number);
+        explicit ObjectHolder(Bool boolean);
         void AssertIsValid() const;
 
-        std::shared_ptr<Object> data_;
-    };
+        [[nodiscard]] bool IsPointer() const {
+            return tag_ == Tag::Heap || tag_ == Tag::Shared;
+        }
 
-    // Объект-значение, хранящий значение типа T
-    template <typename T>
-    class ValueObject : public Object {
-    public:
-        ValueObject(T v)  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
-            : value_(v) {
+        static void AddRef(const Object& object) {
+            if (object.ref_count_ != Object::MAX_REF_COUNT) {
+                ++object.ref_count_;
+            } else {
+                object.AddOverflowRef();
+            }
         }
 
-        void Print(std::ostream& os, [[maybe_unused]] Context& context) override {
-            os << value_;
+        static void Release(Object* object) {
+            if (object->ref_count_ == Object::MAX_REF_COUNT && object->ReleaseOverflowRef()) {
+                return;
+            }
+            if (--object->ref_count_ == 0) {
+                delete object;
+            }
+        }
+        // Переносит значение other в пустой ObjectHolder, оставляя other пустым
+        void MoveFrom(ObjectHolder& other) noexcept {
+            tag_ = other.tag_;
+            switch (tag_) {
+                case Tag::None:
+                    return;
+                case Tag::Heap:
+                case Tag::Shared:
+                    // Владение переходит к этому ObjectHolder, счётчик не меняется
+                    storage_.object = other.storage_.object;
+                    other.tag_ = Tag::None;
+                    return;
+                case Tag::Number:
+                    new (&storage_.number) Number(other.storage_.number.GetValue());
+                    break;
+                case Tag::Bool:
+                    new (&storage_.boolean) Bool(other.storage_.boolean.GetValue());
+                    break;
+            }
+            other.Reset();
         }
 
-        [[nodiscard]] const T& GetValue() const {
-            return value_;
+        void Reset() noexcept {
+            switch (tag_) {
+                case Tag::None:
+                    return;
+                case Tag::Heap:
+                    Release(storage_.object);
+                    break;
+                case Tag::Shared:
+                    break;
+                case Tag::Number:
+                    storage_.number.~Number();
+                    break;
+                case Tag::Bool:
+                    storage_.boolean.~Bool();
+                    break;
+            }
+            tag_ = Tag::None;
         }
 
-    private:
-        T value_;
+        mutable Storage storage_;
+        Tag tag_ = Tag::None;
     };
 
     // Таблица символов, связывающая имя объекта с его значением
-    using Closure = std::unordered_map<std::string, ObjectHolder>;
+    using Closure = std::unordered_map<Symbol, ObjectHolder>;
+
+    /*
+     * Строковое значение. Результат конкатенации длинных строк не копирует операнды, а ссылается
+     * на них (rope). Непрерывная строка собирается при первом обращении к GetValue, например
+     * при выводе или сравнении, после чего ссылки на части освобождаются. Поэтому цепочка
+     * из n конкатенаций копирует O(общей длины) байт вместо O(n * длины)
+     */
+    class String : public Object {
+    public:
+        // Наименьшая длина результата конкатенации, который хранится частями.
+        // Более короткие строки дешевле склеить сразу
+        static constexpr size_t MIN_ROPE_SIZE = 256;
+
+        String(std::string value);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        // Копия всегда собрана и не ссылается на части оригинала
+        String(const String& other);
+        String(String&& other) noexcept = default;
+        String& operator=(const String&) = delete;
+        String& operator=(String&&) = delete;
+
+        ~String() override;
+
+        // Возвращает строку lhs + rhs. lhs и rhs должны хранить строки
+        [[nodiscard]] static ObjectHolder Concat(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+        // Возвращает содержимое строки, при необходимости собирая его из частей
+        [[nodiscard]] const std::string& GetValue() const;
+
+        // Возвращает длину строки, не собирая её
+        [[nodiscard]] size_t GetSize() const {
+            return size_;
+        }
+
+        void Print(std::ostream& os, Context& context) override;
+
+    private:
+        String();
+
+        [[nodiscard]] bool IsRope() const {
+            return static_cast<bool>(lhs_);
+        }
+
+        void Flatten() const;
+        void ReleaseParts() const;
+
+        mutable std::string value_;
+        // Части строки, которая ещё не собрана
+        mutable ObjectHolder lhs_;
+        mutable ObjectHolder rhs_;
+        size_t size_ = 0;
+    };
 
     // Проверяет, содержится ли в object значение, приводимое к True
     // Для отличных от нуля чисел, True и непустых строк возвращается true. В остальных случаях - false.
@@ -106,29 +523,55 @@ namespace runtime {
         virtual ObjectHolder Execute(Closure& closure, Context& context) = 0;
     };
 
-    // Строковое значение
-    using String = ValueObject<std::string>;
-    // Числовое значение
-    using Number = ValueObject<int>;
-
-    // Логическое значение
-    class Bool : public ValueObject<bool> {
-    public:
-        using ValueObject<bool>::ValueObject;
-
-        void Print(std::ostream& os, Context& context) override;
-    };
-
     // Метод класса
     struct Method {
         // Имя метода
-        std::string name;
+        Symbol name;
         // Имена формальных параметров метода
-        std::vector<std::string> formal_params;
+        std::vector<Symbol> formal_params;
         // Тело метода
         std::unique_ptr<Executable> body;
     };
 
+    /*
+     * Форма объекта (hidden class): имена полей в порядке их добавления.
+     * Экземпляры одного класса, получившие поля в одном и том же порядке, разделяют одну форму,
+     * а значения полей хранят в массиве слотов по индексам, которые задаёт форма.
+     * Формы образуют дерево переходов с корнем в форме без полей, которой владеет класс.
+     * Класс и его формы могут использоваться одновременно из нескольких потоков, поэтому
+     * добавление перехода защищено мьютексом
+     */
+    class Shape {
+    public:
+        // Индекс слота, возвращаемый для отсутствующего поля
+        static constexpr size_t NOT_FOUND = std::numeric_limits<size_t>::max();
+        // Наибольшее число полей, хранимых в слотах. Объект с большим числом полей
+        // переходит в словарный режим
+        static constexpr size_t MAX_FIELD_COUNT = 64;
+
+        Shape() = default;
+        Shape(const Shape&) = delete;
+        Shape& operator=(const Shape&) = delete;
+
+        // Возвращает индекс слота поля name либо NOT_FOUND
+        [[nodiscard]] size_t FindSlot(Symbol name) const;
+
+        // Возвращает форму, получаемую из текущей добавлением поля name.
+        // Переходы запоминаются, поэтому повторное добавление того же поля даёт ту же форму
+        [[nodiscard]] const Shape* AddField(Symbol name) const;
+
+        // Возвращает имена полей по номерам слотов
+        [[nodiscard]] const std::vector<Symbol>& GetFieldNames() const;
+
+    private:
+        Shape(const Shape& parent, Symbol name);
+
+        std::vector<Symbol> field_names_;
+        std::unordered_map<Symbol, size_t> slot_by_name_;
+        mutable std::mutex transitions_mutex_;
+        mutable std::unordered_map<Symbol, std::unique_ptr<Shape>> transitions_;
+    };
+
     // Класс
     class Class : public Object {
     public:
@@ -137,24 +580,67 @@ namespace runtime {
         explicit Class(std::string name, std::vector<Method> methods, const Class* parent);
 
         // Возвращает указатель на метод name или nullptr, если метод с таким именем отсутствует
-        [[nodiscard]] const Method* GetMethod(const std::string& name) const;
+        // ни в самом классе, ни в одном из его предков
+        [[nodiscard]] const Method* GetMethod(Symbol name) const;
+        // Возвращает метод name, принимающий argument_count параметров, либо nullptr
+        [[nodiscard]] const Method* GetMethod(Symbol name, size_t argument_count) const;
 
         // Возвращает имя класса
         [[nodiscard]] const std::string& GetName() const;
 
+        // Возвращает собственные методы класса (без методов родителя)
+        [[nodiscard]] const std::vector<Method>& GetMethods() const;
+
+        // Возвращает родительский класс либо nullptr
+        [[nodiscard]] const Class* GetParent() const;
+
+        // Возвращает форму экземпляров класса, ещё не имеющих полей
+        [[nodiscard]] const Shape* GetRootShape() const;
+
+        // Возвращает наибольшее число полей, которое получали экземпляры класса.
+        // Новые экземпляры сразу резервируют столько слотов
+        [[nodiscard]] size_t GetExpectedFieldCount() const;
+
         // Выводит в os строку "Class <имя класса>", например "Class cat"
         void Print(std::ostream& os, Context& context) override;
 
     private:
+        // Запись таблицы методов: метод и число его параметров
+        struct MethodEntry {
+            const Method* method;
+            size_t arity;
+        };
+
         std::string name_;
         std::vector<Method> methods_;
         const Class* parent_;
+        // Методы класса и всех его предков с учётом переопределения
+        std::unordered_map<Symbol, MethodEntry> method_table_;
+        // Счётчик, который экземпляры увеличивают из разных потоков. Перемещение копирует
+        // значение, чтобы класс оставался перемещаемым
+        struct FieldCountHint {
+            std::atomic<size_t> value{0};
+
+            FieldCountHint() = default;
+            FieldCountHint(FieldCountHint&& other) noexcept
+                : value(other.value.load(std::memory_order_relaxed)) {
+            }
+        };
+
+        std::unique_ptr<Shape> root_shape_;
+        mutable FieldCountHint expected_field_count_;
+
+        friend class ClassInstance;
     };
 
-    // Экземпляр класса
+    // Экземпляр класса. Слоты экземпляров, как и сами объекты, размещаются в Pool
     class ClassInstance : public Object {
     public:
         explicit ClassInstance(const Class& cls);
+        ClassInstance(ClassInstance&&) = default;
+        ClassInstance& operator=(ClassInstance&&) = default;
+
+        ~ClassInstance() override;
 
         /*
          * Если у объекта есть метод __str__, выводит в os результат, возвращённый этим методом.
@@ -168,20 +654,133 @@ namespace runtime {
          * Если ни сам класс, ни его родители не содержат метод method, метод выбрасывает исключение
          * runtime_error
          */
-        ObjectHolder Call(const std::string& method, const std::vector<ObjectHolder>& actual_args,
+        ObjectHolder Call(Symbol method, const std::vector<ObjectHolder>& actual_args,
+            Context& context);
+
+        // Вызывает у объекта метод method, уже найденный в его классе
+        ObjectHolder Call(const Method& method, const std::vector<ObjectHolder>& actual_args,
             Context& context);
 
         // Возвращает true, если объект имеет метод method, принимающий argument_count параметров
-        [[nodiscard]] bool HasMethod(const std::string& method, size_t argument_count) const;
+        [[nodiscard]] bool HasMethod(Symbol method, size_t argument_count) const;
+
+        // Возвращает указатель на значение поля name либо nullptr, если такого поля нет
+        [[nodiscard]] ObjectHolder* FindField(Symbol name);
+        [[nodiscard]] const ObjectHolder* FindField(Symbol name) const;
 
-        // Возвращает ссылку на Closure, содержащий поля объекта
+        // Присваивает полю name значение value, добавляя поле, если его не было
+        void SetField(Symbol name, ObjectHolder value);
+
+        /*
+         * Возвращает ссылку на Closure, содержащий поля объекта.
+         * Это медленный путь для совместимости: объект переносит поля из слотов в словарь
+         * и дальше работает в словарном режиме, без формы
+         */
         [[nodiscard]] Closure& Fields();
-        // Возвращает константную ссылку на Closure, содержащую поля объекта
-        [[nodiscard]] const Closure& Fields() const;
+        // Возвращает копию полей объекта. Объект остаётся в прежнем режиме
+        [[nodiscard]] Closure Fields() const;
+
+        // Возвращает форму объекта либо nullptr, если объект в словарном режиме
+        [[nodiscard]] const Shape* GetShape() const;
+
+        // Возвращает класс, экземпляром которого является объект
+        [[nodiscard]] const Class& GetClass() const;
 
     private:
+        friend class FieldCache;
+        friend class CycleCollector;
+
+        // Сборщик циклов, отслеживающий объект, поколение объекта и его место в списке поколения.
+        // Копия объекта - новый объект, который сборщик ещё не отслеживает
+        struct CollectorLink {
+            CycleCollector* collector = nullptr;
+            size_t generation = 0;
+            size_t index = 0;
+
+            CollectorLink() = default;
+            CollectorLink(const CollectorLink& /*other*/) {
+            }
+            CollectorLink& operator=(const CollectorLink& /*other*/) {
+                return *this;
+            }
+        };
+
+        // Добавляет полю слот, переводя объект в форму shape
+        void AppendSlot(const Shape* shape, ObjectHolder value);
+        // Переводит объект в словарный режим
+        void MakeDictionary();
+
         const Class* cls_;
-        Closure fields_;
+        // Значения полей хранятся в slots_ по индексам из shape_,
+        // а в словарном режиме - в dictionary_ (тогда shape_ равен nullptr)
+        const Shape* shape_;
+        // Слоты экземпляров одного класса резервируются одинаково и берутся из одного класса размеров пула
+        std::vector<ObjectHolder, PoolAllocator<ObjectHolder>> slots_;
+        std::unique_ptr<Closure> dictionary_;
+        CollectorLink collector_link_;
+    };
+
+    /*
+     * Кэш обращений к полю в одном месте программы (inline cache).
+     * Запоминает форму объекта, с которым работало последнее обращение, и индекс слота,
+     * так что обращение к объекту той же формы обходится без поиска поля по имени.
+     * Каждому месту чтения или записи поля нужен свой кэш
+     */
+    class FieldCache {
+    public:
+        // Возвращает указатель на значение поля name объекта instance либо nullptr
+        const ObjectHolder* Load(const ClassInstance& instance, Symbol name);
+        // Присваивает полю name объекта instance значение value
+        void Store(ClassInstance& instance, Symbol name, ObjectHolder value);
+
+    private:
+        const Shape* shape_ = nullptr;
+        // Форма объекта после записи: отличается от shape_, если запись добавляет поле
+        const Shape* shape_after_store_ = nullptr;
+        size_t slot_ = 0;
+    };
+
+    // Счётчики обращений к кэшу вызовов
+    struct CallCacheStats {
+        // Попадания в первую запись кэша
+        size_t monomorphic_hits = 0;
+        // Попадания в остальные записи
+        size_t polymorphic_hits = 0;
+        // Промахи, после которых метод искался в классе
+        size_t misses = 0;
+    };
+
+    /*
+     * Кэш вызовов метода в одном месте программы (inline cache).
+     * Запоминает пары (класс, метод) для классов объектов, у которых вызывался метод.
+     * Пока в месте вызова встречается один класс, кэш мономорфный и поиск сводится
+     * к сравнению указателей. Для нескольких классов кэш становится полиморфным и хранит
+     * до MAX_ENTRIES пар; если классов больше, кэш становится мегаморфным: новые пары
+     * не запоминаются, и вызовы для них всякий раз ищут метод в классе
+     */
+    class MethodCache {
+    public:
+        static constexpr size_t MAX_ENTRIES = 4;
+
+        // Возвращает метод name класса cls или его родителей либо nullptr
+        const Method* Find(const Class& cls, Symbol name);
+
+        [[nodiscard]] const CallCacheStats& GetStats() const;
+        // Возвращает число запомненных классов
+        [[nodiscard]] size_t GetEntryCount() const;
+        // Возвращает true, если в месте вызова встречалось больше MAX_ENTRIES классов
+        [[nodiscard]] bool IsMegamorphic() const;
+
+    private:
+        struct Entry {
+            const Class* cls = nullptr;
+            const Method* method = nullptr;
+        };
+
+        Entry entries_[MAX_ENTRIES];
+        size_t entry_count_ = 0;
+        bool megamorphic_ = false;
+        CallCacheStats stats_;
     };
 
     /*
@@ -212,6 +811,23 @@ namespace runtime {
     // Возвращает значение, противоположное Less(lhs, rhs, context)
     bool GreaterOrEqual(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
 
+    /*
+     * Возвращает сумму lhs и rhs. Поддерживается сложение чисел, строк, а также объектов,
+     * у которых есть метод __add__ с одним параметром. В остальных случаях выбрасывает runtime_error
+     */
+    ObjectHolder Add(const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context);
+    // Арифметические операции над числами. Для остальных типов выбрасывают runtime_error
+    ObjectHolder Sub(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    ObjectHolder Mult(const ObjectHolder& lhs, const ObjectHolder& rhs);
+    // Кроме того, выбрасывает runtime_error при делении на 0
+    ObjectHolder Div(const ObjectHolder& lhs, const ObjectHolder& rhs);
+
+    /*
+     * Возвращает строковое представление object (результат функции str).
+     * Для объектов вызывается метод __str__, а при его отсутствии возвращается адрес объекта
+     */
+    ObjectHolder Stringify(const ObjectHolder& object);
+
     // Контекст-заглушка, применяется в тестах.
     // В этом контексте весь вывод перенаправляется в строковый поток вывода output
     struct DummyContext : Context {
@@ -237,4 +853,64 @@ namespace runtime {
         std::ostream& output_;
     };
 
+    // Режим буферизации вывода программы
+    enum class OutputBuffering {
+        // Вывод передаётся в поток при заполнении буфера и при явном сбросе
+        Full,
+        // Вывод передаётся в поток после каждой завершённой строки. Подходит для интерактивной работы
+        Line,
+    };
+
+    /*
+     * Контекст, накапливающий вывод программы в буфере и передающий его в поток output крупными
+     * блоками. Это избавляет print от сброса потока после каждой строки. Накопленный вывод
+     * передаётся в поток при вызове Flush и при разрушении контекста, в том числе когда
+     * выполнение программы прерывается исключением
+     */
+    class BufferedContext : public runtime::Context {
+    public:
+        static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+        explicit BufferedContext(std::ostream& output, size_t buffer_size = DEFAULT_BUFFER_SIZE,
+                                 OutputBuffering buffering = OutputBuffering::Full);
+
+        BufferedContext(const BufferedContext&) = delete;
+        BufferedContext& operator=(const BufferedContext&) = delete;
+
+        ~BufferedContext();
+
+        std::ostream& GetOutputStream() override {
+            return stream_;
+        }
+
+        // Передаёт накопленный вывод в поток output и сбрасывает его.
+        // Выбрасывает runtime_error, если запись в поток не удалась
+        void Flush();
+
+    private:
+        class Buffer : public std::streambuf {
+        public:
+            Buffer(std::ostream& output, size_t size, OutputBuffering buffering);
+
+            // Передаёт накопленный вывод в поток. Возвращает false, если запись не удалась
+            bool Drain();
+
+        protected:
+            int_type overflow(int_type ch) override;
+            std::streamsize xsputn(const char* s, std::streamsize count) override;
+            int sync() override;
+
+        private:
+            // Сдвигает текущую позицию записи на count символов
+            void Advance(std::streamsize count);
+
+            std::ostream& output_;
+            std::vector<char> data_;
+            OutputBuffering buffering_;
+        };
+
+        Buffer buffer_;
+        std::ostream stream_;
+    };
+
 }  // namespace runtime
\ No newline at end of file
@@ -0,0 +1,362 @@
+#include "bench_runner_p.h"
+#include "gc.h"
+#include "runtime.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace runtime {
+
+namespace {
+
+const vector<Symbol> FIELD_NAMES = {"x"s, "y"s, "width"s, "height"s};
+
+// Заполняет поля объекта через кэши, как это делают FieldAssignment и инструкция StoreField
+void FillWithSlots(ClassInstance& instance, vector<FieldCache>& caches) {
+    for (size_t i = 0; i < FIELD_NAMES.size(); ++i) {
+        caches[i].Store(instance, FIELD_NAMES[i], ObjectHolder::Own(Number(static_cast<int>(i))));
+    }
+}
+
+// Заполняет поля объекта через словарь Fields()
+void FillWithDictionary(ClassInstance& instance) {
+    for (size_t i = 0; i < FIELD_NAMES.size(); ++i) {
+        instance.Fields()[FIELD_NAMES[i]] = ObjectHolder::Own(Number(static_cast<int>(i)));
+    }
+}
+
+// Сравнивает хранение полей в слотах формы с хранением в словаре
+void BenchInstanceFields(BenchRunner& br) {
+    Class cls("Rect"s, {}, nullptr);
+    const size_t iterations = 200'000;
+
+    vector<FieldCache> store_caches(FIELD_NAMES.size());
+    br.Run("create instance with 4 fields, slots"s, iterations, [&] {
+        ClassInstance instance(cls);
+        FillWithSlots(instance, store_caches);
+        DoNotOptimize(instance);
+    });
+    br.Run("create instance with 4 fields, dictionary"s, iterations, [&] {
+        ClassInstance instance(cls);
+        FillWithDictionary(instance);
+        DoNotOptimize(instance);
+    });
+
+    // Сами значения полей разделяются, чтобы учесть только память на хранение полей
+    const size_t instance_count = 1000;
+    auto measure_bytes = [&](auto fill) {
+        vector<ObjectHolder> instances;
+        instances.reserve(instance_count);
+        const size_t bytes = MeasureAllocatedBytes([&] {
+            for (size_t i = 0; i < instance_count; ++i) {
+                instances.push_back(ObjectHolder::Own(ClassInstance(cls)));
+                fill(*instances.back().TryAs<ClassInstance>());
+            }
+        });
+        return bytes / instance_count;
+    };
+    Number value(0);
+    // Экземпляры и слоты берутся из пула, поэтому до измерения пул заполняется, чтобы учесть
+    // только память, полученную вне пула
+    measure_bytes([](ClassInstance& instance) {
+        DoNotOptimize(instance.Fields());
+    });
+    const size_t slot_bytes = measure_bytes([&](ClassInstance& instance) {
+        for (size_t i = 0; i < FIELD_NAMES.size(); ++i) {
+            store_caches[i].Store(instance, FIELD_NAMES[i], ObjectHolder::Share(value));
+        }
+    });
+    const size_t dictionary_bytes = measure_bytes([&](ClassInstance& instance) {
+        for (Symbol name : FIELD_NAMES) {
+            instance.Fields()[name] = ObjectHolder::Share(value);
+        }
+    });
+    cout << "heap bytes outside the pool per instance with 4 fields: slots "s << slot_bytes << ", dictionary "s
+         << dictionary_bytes << endl;
+
+    ClassInstance with_slots(cls);
+    FillWithSlots(with_slots, store_caches);
+    ClassInstance with_dictionary(cls);
+    FillWithDictionary(with_dictionary);
+
+    const Symbol name = FIELD_NAMES.back();
+    FieldCache load_cache;
+    br.Run("load field, cached slot"s, iterations * 10, [&] {
+        DoNotOptimize(*load_cache.Load(with_slots, name));
+    });
+    br.Run("load field, shape lookup"s, iterations * 10, [&] {
+        DoNotOptimize(*with_slots.FindField(name));
+    });
+    br.Run("load field, dictionary"s, iterations * 10, [&] {
+        DoNotOptimize(*with_dictionary.FindField(name));
+    });
+}
+
+// Сравнивает создание и удаление объектов через пул с обращением к operator new
+void BenchInstanceChurn(BenchRunner& br) {
+    Class cls("Point"s, {}, nullptr);
+    const Symbol x = "x"s;
+    const Symbol y = "y"s;
+    const size_t iterations = 1'000'000;
+
+    FieldCache store_x;
+    FieldCache store_y;
+    br.Run("create and destroy instance with 2 fields"s, iterations, [&] {
+        ObjectHolder instance = ObjectHolder::Own(ClassInstance(cls));
+        store_x.Store(*instance.TryAs<ClassInstance>(), x, ObjectHolder::Own(Number(1)));
+        store_y.Store(*instance.TryAs<ClassInstance>(), y, ObjectHolder::Own(Number(2)));
+        DoNotOptimize(instance);
+    });
+
+    br.Run("allocate and free instance-sized block, pool"s, iterations, [] {
+        void* block = Pool::Allocate(sizeof(ClassInstance));
+        DoNotOptimize(block);
+        Pool::Deallocate(block, sizeof(ClassInstance));
+    });
+    br.Run("allocate and free instance-sized block, operator new"s, iterations, [] {
+        void* block = ::operator new(sizeof(ClassInstance));
+        DoNotOptimize(block);
+        ::operator delete(block);
+    });
+}
+
+// Сравнивает создание объектов со сборщиком циклов и без него и измеряет паузы сборки
+void BenchCycleCollection(BenchRunner& br) {
+    Class cls("Node"s, {}, nullptr);
+    const Symbol parent = "parent"s;
+    const Symbol child = "child"s;
+    const size_t iterations = 200'000;
+
+    FieldCache store_child;
+    FieldCache store_parent;
+    auto make_pair = [&] {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        ObjectHolder leaf = ObjectHolder::Own(ClassInstance(cls));
+        store_child.Store(*node.TryAs<ClassInstance>(), child, leaf);
+        store_parent.Store(*leaf.TryAs<ClassInstance>(), parent, node);
+        return node;
+    };
+
+    br.Run("create acyclic node pair, no collector"s, iterations, [&] {
+        ObjectHolder node = make_pair();
+        node.TryAs<ClassInstance>()->FindField(child)->TryAs<ClassInstance>()->SetField(parent, {});
+    });
+    {
+        CycleCollector collector;
+        CycleCollector::Scope scope(collector);
+        br.Run("create acyclic node pair, collector"s, iterations, [&] {
+            ObjectHolder node = make_pair();
+            node.TryAs<ClassInstance>()->FindField(child)->TryAs<ClassInstance>()->SetField(parent, {});
+        });
+        br.Run("create cyclic node pair, collector"s, iterations, [&] {
+            DoNotOptimize(make_pair());
+        });
+        const GcStats& stats = collector.GetStats();
+        cout << "  "s << stats.collections << " collections, "s << stats.collected_objects
+             << " objects reclaimed, max pause "s << stats.max_pause.count() << " ns"s << endl;
+    }
+
+    // Пауза растёт с числом живых объектов, которые сборка обходит
+    for (size_t live : {1'000, 100'000}) {
+        CycleCollector collector(CycleCollector::Options{0, 0.25});
+        CycleCollector::Scope scope(collector);
+        vector<ObjectHolder> roots;
+        for (size_t i = 0; i < live / 2; ++i) {
+            roots.push_back(make_pair());
+        }
+        br.Run("collect with "s + to_string(live) + " live objects"s, 10, [&] {
+            DoNotOptimize(collector.Collect());
+        });
+    }
+}
+
+// Сравнивает скорость создания короткоживущих объектов при большом числе долгоживущих:
+// только счётчики ссылок, сборщик циклов и сборщик циклов с поколениями
+void BenchGenerationalCollection(BenchRunner& br) {
+    Class cls("Node"s, {}, nullptr);
+    const Symbol link = "link"s;
+    const size_t long_lived = 100'000;
+    const size_t iterations = 1'000'000;
+
+    FieldCache store_link;
+    auto churn = [&] {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        store_link.Store(*node.TryAs<ClassInstance>(), link, node);
+    };
+    auto run = [&](const string& name, CycleCollector* collector) {
+        optional<CycleCollector::Scope> scope;
+        if (collector != nullptr) {
+            scope.emplace(*collector);
+        }
+        vector<ObjectHolder> roots;
+        for (size_t i = 0; i < long_lived; ++i) {
+            roots.push_back(ObjectHolder::Own(ClassInstance(cls)));
+        }
+        br.Run(name, iterations, churn);
+        if (collector != nullptr) {
+            const GcStats& stats = collector->GetStats();
+            cout << "  "s << stats.collections << " collections ("s << stats.young_collections
+                 << " young only), pauses total "s << stats.total_pause.count() / 1'000'000
+                 << " ms, max "s << stats.max_pause.count() / 1000 << " us"s << endl;
+        }
+    };
+
+    // Без сборщика циклы не освобождаются, поэтому объекты в этом замере их не образуют
+    br.Run("create and destroy instance, reference counting only"s, iterations, [&] {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        store_link.Store(*node.TryAs<ClassInstance>(), link, ObjectHolder::Own(Number(0)));
+    });
+    {
+        CycleCollector collector;
+        run("create self-referencing instance, cycle collector"s, &collector);
+    }
+    {
+        CycleCollector::Options options;
+        options.generational = true;
+        CycleCollector collector(options);
+        run("create self-referencing instance, generational cycle collector"s, &collector);
+    }
+}
+
+// Ищет метод, перебирая методы класса и его предков, как это делалось бы без таблицы методов
+const Method* FindInHierarchy(const Class& cls, Symbol name) {
+    for (const Class* current = &cls; current != nullptr; current = current->GetParent()) {
+        for (const Method& method : current->GetMethods()) {
+            if (method.name == name) {
+                return &method;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Время поиска метода не должно зависеть от глубины иерархии
+void BenchMethodLookup(BenchRunner& br) {
+    const size_t methods_per_class = 8;
+    const size_t iterations = 1'000'000;
+
+    for (size_t depth : {1, 5, 20}) {
+        // Каждый класс объявляет methods_per_class методов, корень - ещё и метод root
+        vector<unique_ptr<Class>> hierarchy;
+        for (size_t level = 0; level < depth; ++level) {
+            vector<Method> methods;
+            for (size_t i = 0; i < methods_per_class; ++i) {
+                methods.push_back({"method"s + to_string(level) + '_' + to_string(i), {}, nullptr});
+            }
+            if (level == 0) {
+                methods.push_back({"root"s, {}, nullptr});
+            }
+            const Class* parent = hierarchy.empty() ? nullptr : hierarchy.back().get();
+            hierarchy.push_back(make_unique<Class>("Level"s + to_string(level), move(methods), parent));
+        }
+        const Class& leaf = *hierarchy.back();
+
+        const string suffix = ", "s + to_string(depth) + " levels"s;
+        const Symbol root = "root"s;
+        br.Run("table lookup of root method"s + suffix, iterations, [&] {
+            DoNotOptimize(leaf.GetMethod(root));
+        });
+        br.Run("hierarchy walk to root method"s + suffix, iterations, [&] {
+            DoNotOptimize(FindInHierarchy(leaf, root));
+        });
+    }
+}
+
+// Арифметика и сравнения над числами не должны выделять память
+void BenchArithmetic(BenchRunner& br) {
+    DummyContext context;
+    const ObjectHolder lhs = ObjectHolder::Own(Number(40));
+    const ObjectHolder rhs = ObjectHolder::Own(Number(2));
+    const size_t iterations = 1'000'000;
+
+    auto report = [&](const string& name, auto operation) {
+        br.Run(name, iterations, operation);
+        const size_t bytes = MeasureAllocatedBytes([&] {
+            for (size_t i = 0; i < 1000; ++i) {
+                operation();
+            }
+        });
+        cout << "  allocated per op: "s << bytes / 1000 << " bytes"s << endl;
+    };
+
+    report("Add(Number, Number)"s, [&] {
+        DoNotOptimize(Add(lhs, rhs, context));
+    });
+    report("Mult(Number, Number)"s, [&] {
+        DoNotOptimize(Mult(lhs, rhs));
+    });
+    report("Less(Number, Number) to Bool"s, [&] {
+        DoNotOptimize(ObjectHolder::Own(Bool(Less(lhs, rhs, context))));
+    });
+    report("copy of a Number holder"s, [&] {
+        ObjectHolder copy = lhs;
+        DoNotOptimize(copy);
+    });
+}
+
+// Заполнение таблицы символов вызываемого метода, как в ClassInstance::Call: ключи-строки
+// хешируются и сравниваются посимвольно, интернированные имена - по указателю
+void BenchNameKeys(BenchRunner& br) {
+    const vector<string> names = {"self"s, "first_argument"s, "second_argument"s, "accumulated_result"s};
+    const vector<Symbol> symbols(names.begin(), names.end());
+    const ObjectHolder value = ObjectHolder::Own(Number(1));
+    const size_t iterations = 200'000;
+
+    br.Run("method scope with 4 names, string keys"s, iterations, [&] {
+        unordered_map<string, ObjectHolder> scope;
+        for (const string& name : names) {
+            scope[name] = value;
+        }
+        DoNotOptimize(scope.at(names.back()));
+    });
+    br.Run("method scope with 4 names, interned keys"s, iterations, [&] {
+        Closure scope;
+        for (Symbol name : symbols) {
+            scope[name] = value;
+        }
+        DoNotOptimize(scope.at(symbols.back()));
+    });
+    br.Run("intern an existing name"s, iterations, [&] {
+        DoNotOptimize(Symbol(names.back()));
+    });
+}
+
+// Строит строку из count частей по 10 байт, как цикл s = s + part, и выводит её
+void BenchStringConcatenation(BenchRunner& br) {
+    const auto part = ObjectHolder::Own(String("0123456789"s));
+    DummyContext context;
+    double previous_ns = 0;
+    for (size_t count : {10'000, 40'000}) {
+        const double ns = br.Run(to_string(count) + " concatenations and print"s, 5, [&] {
+            ObjectHolder result = ObjectHolder::Own(String(""s));
+            for (size_t i = 0; i < count; ++i) {
+                result = Add(result, part, context);
+            }
+            context.output.str({});
+            result->Print(context.output, context);
+        });
+        if (previous_ns > 0) {
+            // При квадратичной сложности четырёхкратное удлинение замедлило бы работу в 16 раз
+            cout << "  4x longer string takes "s << ns / previous_ns << "x more time"s << endl;
+        }
+        previous_ns = ns;
+    }
+}
+
+}  // namespace
+
+void RunBenchmarks(BenchRunner& br) {
+    RUN_BENCH(br, runtime::BenchInstanceFields);
+    RUN_BENCH(br, runtime::BenchInstanceChurn);
+    RUN_BENCH(br, runtime::BenchCycleCollection);
+    RUN_BENCH(br, runtime::BenchGenerationalCollection);
+    RUN_BENCH(br, runtime::BenchMethodLookup);
+    RUN_BENCH(br, runtime::BenchArithmetic);
+    RUN_BENCH(br, runtime::BenchNameKeys);
+    RUN_BENCH(br, runtime::BenchStringConcatenation);
+}
+
+}  // namespace runtime
@@ -1,7 +1,9 @@
+#include "gc.h"
 #include "runtime.h"
 #include "test_runner_p.h"
 
 #include <functional>
+#include <utility>
 
 using namespace std;
 
@@ -71,6 +73,47 @@ void TestString() {
     ASSERT_EQUAL(word.GetValue(), "hello!"s);
 }
 
+void TestStringConcatenation() {
+    DummyContext context;
+    const auto part = ObjectHolder::Own(String("0123456789"s));
+    auto result = ObjectHolder::Own(String(""s));
+    string expected;
+    ObjectHolder prefix;
+    for (int i = 0; i < 100; ++i) {
+        result = Add(result, part, context);
+        expected += "0123456789"s;
+        if (i == 50) {
+            prefix = result;
+        }
+    }
+    ASSERT_EQUAL(result.TryAs<String>()->GetSize(), 1000U);
+    ASSERT(IsTrue(result));
+
+    // Копия собрана сразу, а исходная строка - при первом обращении к содержимому
+    auto copy = ObjectHolder::Own(*result.TryAs<String>());
+    ASSERT_EQUAL(copy.TryAs<String>()->GetValue(), expected);
+    ASSERT(Equal(result, copy, context));
+    ASSERT_EQUAL(prefix.TryAs<String>()->GetValue(), expected.substr(0, 510));
+    ASSERT(Stringify(result).Get() == result.Get());
+
+    // Строка из общих частей
+    auto twice = Add(prefix, prefix, context);
+    ASSERT_EQUAL(twice.TryAs<String>()->GetValue(), expected.substr(0, 510) + expected.substr(0, 510));
+
+    // Длинная цепочка конкатенаций собирается и освобождается без переполнения стека
+    for (int i = 0; i < 1'000'000; ++i) {
+        result = Add(result, part, context);
+    }
+    ASSERT_EQUAL(result.TryAs<String>()->GetSize(), 10'001'000U);
+    auto flattened = Add(result, part, context);
+    ASSERT_EQUAL(flattened.TryAs<String>()->GetValue().size(), 10'001'010U);
+    for (int i = 0; i < 1'000'000; ++i) {
+        result = Add(result, part, context);
+    }
+    result = {};
+    ASSERT_EQUAL(prefix.TryAs<String>()->GetSize(), 510U);
+}
+
 void TestBool() {
     Bool t(true);
     ASSERT_EQUAL(t.GetValue(), true);
@@ -242,12 +285,99 @@ void TestMove() {
     }
 }
 
+void TestSharedOwnership() {
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    {
+        auto one = ObjectHolder::Own(Logger(5));
+        Object* stored = one.Get();
+        {
+            ObjectHolder two = one;
+            ObjectHolder three;
+            three = two;
+            one = {};
+            ASSERT_EQUAL(Logger::instance_count, 1);
+            ASSERT(three.Get() == stored);
+
+            // Заимствованная ссылка не продлевает жизнь объекта
+            ObjectHolder borrowed = three.Borrow();
+            ASSERT(borrowed.Get() == stored);
+            three = std::move(two);
+            three = three;  // NOLINT
+            ASSERT_EQUAL(Logger::instance_count, 1);
+        }
+        ASSERT_EQUAL(Logger::instance_count, 0);
+    }
+
+    // Копия объекта не наследует его владельцев
+    auto original = ObjectHolder::Own(String("text"s));
+    ObjectHolder copy_owner = original;
+    {
+        auto copy = ObjectHolder::Own(*original.TryAs<String>());
+        ASSERT(copy.Get() != original.Get());
+    }
+    ASSERT_EQUAL(original.TryAs<String>()->GetValue(), "text"s);
+
+    // Число хранится внутри ObjectHolder и заимствуется копированием
+    auto number = ObjectHolder::Own(Number(7));
+    ASSERT_EQUAL(number.Borrow().TryAs<Number>()->GetValue(), 7);
+}
+
+void TestRefCountOverflow() {
+    // Владельцы сверх ёмкости счётчика в объекте тоже учитываются, и объект освобождается
+    // вместе с последним из них
+    constexpr size_t owner_count = (size_t{1} << 24) + 10;
+    ASSERT_EQUAL(Logger::instance_count, 0);
+    {
+        auto one = ObjectHolder::Own(Logger(5));
+        vector<ObjectHolder> owners(owner_count, one);
+        one = {};
+        owners.resize(1);
+        ASSERT(owners.front().IsUnique());
+        ASSERT_EQUAL(Logger::instance_count, 1);
+    }
+    ASSERT_EQUAL(Logger::instance_count, 0);
+}
+
 void TestNullptr() {
     ObjectHolder oh;
     ASSERT(!oh);
     ASSERT(!oh.Get());
 }
 
+void TestKinds() {
+    ASSERT(ObjectHolder::None().GetKind() == Kind::None);
+    ASSERT(ObjectHolder::Own(Number{1}).GetKind() == Kind::Number);
+    ASSERT(ObjectHolder::Own(Bool{true}).GetKind() == Kind::Bool);
+    ASSERT(ObjectHolder::Own(String{"s"s}).GetKind() == Kind::String);
+
+    // Вид не зависит от способа хранения значения
+    Number number{2};
+    Bool boolean{false};
+    ObjectHolder shared_number = ObjectHolder::Share(number);
+    ASSERT(shared_number.GetKind() == Kind::Number);
+    ASSERT(shared_number.TryAs<Number>() == &number);
+    ASSERT(shared_number.TryAs<Bool>() == nullptr);
+    ASSERT(ObjectHolder::Share(boolean).TryAs<Bool>() == &boolean);
+
+    Class cls{"Test"s, {}, nullptr};
+    ObjectHolder cls_holder = ObjectHolder::Share(cls);
+    ASSERT(cls_holder.GetKind() == Kind::Class);
+    ASSERT(cls_holder.TryAs<Class>() == &cls);
+    ASSERT(cls_holder.TryAs<ClassInstance>() == nullptr);
+
+    ObjectHolder instance = ObjectHolder::Own(ClassInstance{cls});
+    ASSERT(instance.GetKind() == Kind::ClassInstance);
+    ASSERT(instance.TryAs<ClassInstance>() != nullptr);
+    ASSERT(instance.TryAs<String>() == nullptr);
+
+    // Типы, не имеющие собственного вида, проверяются через dynamic_cast
+    ObjectHolder logger = ObjectHolder::Own(Logger{});
+    ASSERT(logger.GetKind() == Kind::Other);
+    ASSERT(logger.TryAs<Logger>() != nullptr);
+    ASSERT(logger.TryAs<Object>() == logger.Get());
+    ASSERT(logger.TryAs<Class>() == nullptr);
+}
+
 void TestIsTrue() {
     {
         ASSERT(!IsTrue(ObjectHolder::Own(Bool{false})));
@@ -504,6 +634,43 @@ void TestClass() {
     ASSERT_EQUAL(out.str(), "Class Test"s);
 }
 
+void TestClassHierarchy() {
+    auto make_method = [](const string& name, vector<Symbol> params) {
+        return Method{name, move(params), make_unique<TestMethodBody>(nullptr)};
+    };
+
+    vector<Method> base_methods;
+    base_methods.push_back(make_method("a"s, {}));
+    base_methods.push_back(make_method("b"s, {"x"s}));
+    Class base{"Base"s, move(base_methods), nullptr};
+
+    vector<Method> middle_methods;
+    middle_methods.push_back(make_method("b"s, {"x"s, "y"s}));
+    Class middle{"Middle"s, move(middle_methods), &base};
+
+    vector<Method> leaf_methods;
+    leaf_methods.push_back(make_method("c"s, {}));
+    leaf_methods.push_back(make_method("c"s, {"x"s}));
+    Class leaf{"Leaf"s, move(leaf_methods), &middle};
+
+    // Методы находятся через любое число уровней наследования
+    ASSERT_EQUAL(leaf.GetMethod("a"s), base.GetMethod("a"s));
+    // Ближайшее переопределение перекрывает методы предков
+    ASSERT_EQUAL(leaf.GetMethod("b"s), middle.GetMethod("b"s));
+    ASSERT_EQUAL(base.GetMethod("b"s)->formal_params.size(), 1U);
+    // Из одноимённых методов класса действует первый
+    ASSERT_EQUAL(leaf.GetMethod("c"s), &leaf.GetMethods().front());
+    ASSERT(leaf.GetMethod("missing"s) == nullptr);
+
+    ASSERT_EQUAL(leaf.GetMethod("b"s, 2), middle.GetMethod("b"s));
+    ASSERT(leaf.GetMethod("b"s, 1) == nullptr);
+    ASSERT_EQUAL(leaf.GetMethod("a"s, 0), base.GetMethod("a"s));
+
+    ClassInstance instance{leaf};
+    ASSERT(instance.HasMethod("a"s, 0));
+    ASSERT(!instance.HasMethod("a"s, 1));
+}
+
 void TestClassInstance() {
     vector<Method> methods;
 
@@ -518,7 +685,7 @@ void TestClassInstance() {
     Class cls{"Test"s, move(methods), nullptr};
     ClassInstance instance{cls};
 
-    ASSERT_EQUAL(&instance.Fields(), &const_cast<const ClassInstance&>(instance).Fields());
+    ASSERT_EQUAL(instance.Fields().size(), std::as_const(instance).Fields().size());
     ASSERT(instance.HasMethod("__str__"s, 0));
 
     ostringstream out;
@@ -529,24 +696,428 @@ void TestClassInstance() {
     ASSERT_THROWS(instance.Call("missing_method"s, {}, ctx), runtime_error);
 }
 
+void TestSymbols() {
+    const string text = "counter.value"s;
+    const Symbol counter = string_view(text).substr(0, 7);
+    const Symbol value = string_view(text).substr(8);
+
+    // Одинаковые имена интернируются в одну запись таблицы
+    ASSERT(counter == Symbol("counter"s));
+    ASSERT_EQUAL(&counter.GetName(), &Symbol("counter").GetName());
+    ASSERT(counter != value);
+    ASSERT_EQUAL(value.GetName(), "value"s);
+    ASSERT_EQUAL(Symbol().GetName(), ""s);
+    ASSERT(Symbol() == Symbol(""s));
+    ASSERT_EQUAL(hash<Symbol>{}(counter), hash<Symbol>{}(Symbol("counter"sv)));
+
+    // Повторное интернирование не добавляет записей
+    const size_t count = GetInternedSymbolCount();
+    Symbol again{"counter"s};
+    ASSERT_EQUAL(GetInternedSymbolCount(), count);
+    Symbol fresh{"a name that was never interned before"s};
+    ASSERT_EQUAL(GetInternedSymbolCount(), count + 1);
+
+    // Поиск находит только интернированные имена и не пополняет таблицу
+    ASSERT(Symbol::TryFind("counter"sv) == counter);
+    ASSERT(!Symbol::TryFind("a name that is only looked up"sv));
+    ASSERT_EQUAL(GetInternedSymbolCount(), count + 1);
+
+    // Closure ищет значения и по строкам, и по символам
+    Closure closure;
+    closure["counter"s] = ObjectHolder::Own(Number{1});
+    ASSERT_EQUAL(closure.count(counter), 1U);
+    ASSERT_EQUAL(closure.at(again).TryAs<Number>()->GetValue(), 1);
+    ASSERT(closure.find(fresh) == closure.end());
+
+    ostringstream out;
+    out << counter;
+    ASSERT_EQUAL(out.str(), "counter"s);
+}
+
+void TestShapes() {
+    Class cls{"Point"s, {}, nullptr};
+    ClassInstance a{cls};
+    ClassInstance b{cls};
+    ClassInstance c{cls};
+    ASSERT_EQUAL(a.GetShape(), cls.GetRootShape());
+
+    a.SetField("x"s, ObjectHolder::Own(Number{1}));
+    a.SetField("y"s, ObjectHolder::Own(Number{2}));
+    b.SetField("x"s, ObjectHolder::Own(Number{3}));
+    b.SetField("y"s, ObjectHolder::Own(Number{4}));
+    c.SetField("y"s, ObjectHolder::Own(Number{5}));
+    c.SetField("x"s, ObjectHolder::Own(Number{6}));
+
+    // Одинаковый порядок добавления полей даёт одну форму, другой порядок - другую
+    ASSERT_EQUAL(a.GetShape(), b.GetShape());
+    ASSERT(a.GetShape() != c.GetShape());
+    ASSERT_EQUAL(a.GetShape()->GetFieldNames(), (vector<Symbol>{"x"s, "y"s}));
+    ASSERT_EQUAL(a.GetShape()->FindSlot("y"s), 1U);
+    ASSERT_EQUAL(a.GetShape()->FindSlot("z"s), Shape::NOT_FOUND);
+
+    // Перезапись поля не меняет форму
+    const Shape* shape = b.GetShape();
+    b.SetField("x"s, ObjectHolder::Own(Number{7}));
+    ASSERT_EQUAL(b.GetShape(), shape);
+    ASSERT_EQUAL(b.FindField("x"s)->TryAs<Number>()->GetValue(), 7);
+    ASSERT(b.FindField("z"s) == nullptr);
+
+    // Константный Fields() возвращает копию полей и не меняет режим объекта
+    const Closure snapshot = std::as_const(c).Fields();
+    ASSERT(c.GetShape() != nullptr);
+    ASSERT_EQUAL(snapshot.size(), 2U);
+    ASSERT_EQUAL(snapshot.at("x"s).TryAs<Number>()->GetValue(), 6);
+
+    // Fields() переводит объект в словарный режим, сохраняя значения полей
+    Closure& fields = c.Fields();
+    ASSERT(c.GetShape() == nullptr);
+    ASSERT_EQUAL(fields.size(), 2U);
+    ASSERT_EQUAL(fields.at("x"s).TryAs<Number>()->GetValue(), 6);
+    fields["z"s] = ObjectHolder::Own(Number{8});
+    ASSERT_EQUAL(c.FindField("z"s)->TryAs<Number>()->GetValue(), 8);
+    c.SetField("w"s, ObjectHolder::None());
+    ASSERT_EQUAL(c.Fields().count("w"s), 1U);
+
+    // Объект со слишком большим числом полей тоже переходит в словарный режим
+    ClassInstance big{cls};
+    for (size_t i = 0; i <= Shape::MAX_FIELD_COUNT; ++i) {
+        big.SetField("f"s + to_string(i), ObjectHolder::Own(Number{static_cast<int>(i)}));
+    }
+    ASSERT(big.GetShape() == nullptr);
+    ASSERT_EQUAL(big.FindField("f10"s)->TryAs<Number>()->GetValue(), 10);
+}
+
+void TestFieldCache() {
+    Class cls{"Point"s, {}, nullptr};
+    ClassInstance a{cls};
+    ClassInstance b{cls};
+    ClassInstance c{cls};
+
+    FieldCache store_x;
+    FieldCache store_y;
+    for (ClassInstance* instance : {&a, &b}) {
+        store_x.Store(*instance, "x"s, ObjectHolder::Own(Number{1}));
+        store_y.Store(*instance, "y"s, ObjectHolder::Own(Number{2}));
+    }
+    // Запись через кэш выполняет тот же переход формы, что и SetField
+    c.SetField("x"s, ObjectHolder::None());
+    c.SetField("y"s, ObjectHolder::None());
+    ASSERT_EQUAL(b.GetShape(), c.GetShape());
+    store_y.Store(b, "y"s, ObjectHolder::Own(Number{3}));
+    ASSERT_EQUAL(b.GetShape(), c.GetShape());
+
+    FieldCache load_y;
+    ASSERT_EQUAL(load_y.Load(a, "y"s)->TryAs<Number>()->GetValue(), 2);
+    ASSERT_EQUAL(load_y.Load(b, "y"s)->TryAs<Number>()->GetValue(), 3);
+
+    // Кэш не путает объекты других форм и объекты в словарном режиме
+    ClassInstance d{cls};
+    d.SetField("y"s, ObjectHolder::Own(Number{4}));
+    ASSERT_EQUAL(load_y.Load(d, "y"s)->TryAs<Number>()->GetValue(), 4);
+    (void)a.Fields();
+    ASSERT_EQUAL(load_y.Load(a, "y"s)->TryAs<Number>()->GetValue(), 2);
+    store_y.Store(a, "y"s, ObjectHolder::Own(Number{5}));
+    ASSERT_EQUAL(a.Fields().at("y"s).TryAs<Number>()->GetValue(), 5);
+}
+
+void TestMethodCache() {
+    auto make_methods = [] {
+        vector<Method> methods;
+        methods.push_back({"f"s, {}, make_unique<TestMethodBody>([](Closure&, Context&) {
+                               return ObjectHolder::None();
+                           })});
+        return methods;
+    };
+    Class base{"Base"s, make_methods(), nullptr};
+    Class derived{"Derived"s, {}, &base};
+    vector<unique_ptr<Class>> others;
+    for (size_t i = 0; i < MethodCache::MAX_ENTRIES; ++i) {
+        others.push_back(make_unique<Class>("Other"s + to_string(i), make_methods(), nullptr));
+    }
+
+    MethodCache cache;
+    ASSERT_EQUAL(cache.Find(base, "f"s), base.GetMethod("f"s));
+    ASSERT_EQUAL(cache.Find(base, "f"s), base.GetMethod("f"s));
+    ASSERT_EQUAL(cache.GetEntryCount(), 1U);
+    ASSERT_EQUAL(cache.GetStats().monomorphic_hits, 1U);
+    ASSERT_EQUAL(cache.GetStats().misses, 1U);
+
+    // Метод родителя запоминается для класса-наследника
+    ASSERT_EQUAL(cache.Find(derived, "f"s), base.GetMethod("f"s));
+    ASSERT_EQUAL(cache.Find(derived, "f"s), base.GetMethod("f"s));
+    ASSERT_EQUAL(cache.GetEntryCount(), 2U);
+    ASSERT_EQUAL(cache.GetStats().polymorphic_hits, 1U);
+    ASSERT(!cache.IsMegamorphic());
+
+    // Классы сверх MAX_ENTRIES не запоминаются, но методы находятся
+    for (const auto& other : others) {
+        ASSERT_EQUAL(cache.Find(*other, "f"s), other->GetMethod("f"s));
+    }
+    ASSERT(cache.IsMegamorphic());
+    ASSERT_EQUAL(cache.GetEntryCount(), MethodCache::MAX_ENTRIES);
+    ASSERT_EQUAL(cache.Find(*others.back(), "f"s), others.back()->GetMethod("f"s));
+    ASSERT_EQUAL(cache.GetStats().misses, 2U + others.size() + 1U);
+
+    // Отсутствие метода тоже запоминается
+    MethodCache missing;
+    ASSERT(missing.Find(base, "g"s) == nullptr);
+    ASSERT(missing.Find(base, "g"s) == nullptr);
+    ASSERT_EQUAL(missing.GetStats().monomorphic_hits, 1U);
+}
+
+void TestPool() {
+    // Освобождённый блок снова выдаётся запросу того же класса размеров
+    void* block = Pool::Allocate(40);
+    Pool::Deallocate(block, 40);
+    ASSERT_EQUAL(Pool::Allocate(48), block);
+    Pool::Deallocate(block, 48);
+
+    // Экземпляры, создаваемые и удаляемые в цикле, не требуют новых участков
+    Class cls("Point"s, {}, nullptr);
+    ObjectHolder warmup = ObjectHolder::Own(ClassInstance(cls));
+    warmup.TryAs<ClassInstance>()->SetField("x"s, ObjectHolder::Own(Number(1)));
+    warmup = {};
+    const size_t chunk_count = Pool::GetChunkCount();
+    for (int i = 0; i < 100'000; ++i) {
+        ObjectHolder instance = ObjectHolder::Own(ClassInstance(cls));
+        instance.TryAs<ClassInstance>()->SetField("x"s, ObjectHolder::Own(Number(i)));
+    }
+    ASSERT_EQUAL(Pool::GetChunkCount(), chunk_count);
+
+    // Крупные блоки выделяются вне пула
+    void* large = Pool::Allocate(Pool::MAX_SIZE + 1);
+    Pool::Deallocate(large, Pool::MAX_SIZE + 1);
+    ASSERT_EQUAL(Pool::GetChunkCount(), chunk_count);
+}
+
+void TestCycleCollector() {
+    Class cls("Node"s, {}, nullptr);
+    const Symbol parent = "parent"s;
+    const Symbol child = "child"s;
+    auto make_node = [&cls] {
+        return ObjectHolder::Own(ClassInstance(cls));
+    };
+    auto as_instance = [](const ObjectHolder& holder) {
+        return holder.TryAs<ClassInstance>();
+    };
+
+    CycleCollector collector(CycleCollector::Options{0, 0.25});
+    ObjectHolder root;
+    {
+        CycleCollector::Scope scope(collector);
+        ASSERT_EQUAL(CycleCollector::Current(), &collector);
+
+        // Узел и его потомок ссылаются друг на друга
+        ObjectHolder node = make_node();
+        ObjectHolder leaf = make_node();
+        as_instance(node)->SetField(child, leaf);
+        as_instance(leaf)->SetField(parent, node);
+        // Объект ссылается сам на себя и хранит поля в словаре
+        ObjectHolder self_ref = make_node();
+        as_instance(self_ref)->Fields()["self"s] = self_ref;
+        // Цикл, достижимый из переменной, и объект, на который ссылается только он
+        root = make_node();
+        ObjectHolder kept = make_node();
+        as_instance(root)->SetField(child, kept);
+        as_instance(kept)->SetField(parent, root);
+        as_instance(kept)->SetField("payload"s, make_node());
+        // Объект вне кучи не отслеживается, но удерживает объекты, на которые ссылается
+        ClassInstance on_stack(cls);
+        on_stack.SetField(child, make_node());
+        as_instance(*on_stack.FindField(child))->SetField(parent, *on_stack.FindField(child));
+        ASSERT_EQUAL(collector.GetTrackedCount(), 7U);
+        ASSERT_EQUAL(collector.Collect(), 0U);
+    }
+    ASSERT(CycleCollector::Current() == nullptr);
+    // Без сборщика циклы остаются в памяти
+    ASSERT_EQUAL(collector.GetTrackedCount(), 7U);
+
+    ASSERT_EQUAL(collector.Collect(), 4U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 3U);
+    ASSERT(as_instance(*as_instance(root)->FindField(child))->FindField("payload"s) != nullptr);
+
+    const GcStats& stats = collector.GetStats();
+    ASSERT_EQUAL(stats.collections, 2U);
+    ASSERT_EQUAL(stats.collected_objects, 4U);
+    ASSERT(stats.reclaimed_bytes >= 4 * sizeof(ClassInstance));
+    ASSERT(stats.max_pause >= stats.last_pause);
+    ASSERT(stats.total_pause >= stats.max_pause);
+
+    // Оставшиеся циклы собираются, когда на них перестают ссылаться
+    root = {};
+    ASSERT_EQUAL(collector.Collect(), 3U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 0U);
+}
+
+void TestCycleCollectorThreshold() {
+    Class cls("Node"s, {}, nullptr);
+    CycleCollector collector(CycleCollector::Options{100, 0.25});
+    CycleCollector::Scope scope(collector);
+
+    // Каждый объект ссылается сам на себя и без сборщика не освобождается
+    for (int i = 0; i < 1000; ++i) {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        node.TryAs<ClassInstance>()->SetField("self"s, node);
+    }
+    // Каждая сборка застаёт живым только создаваемый объект
+    ASSERT_EQUAL(collector.GetStats().collections, 10U);
+    ASSERT_EQUAL(collector.GetStats().collected_objects, 999U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 1U);
+
+    // Сборщик можно перенастроить, в том числе отключить автоматическую сборку
+    collector.SetOptions({0, 0.25});
+    for (int i = 0; i < 1000; ++i) {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        node.TryAs<ClassInstance>()->SetField("self"s, node);
+    }
+    ASSERT_EQUAL(collector.GetStats().collections, 10U);
+    ASSERT_EQUAL(collector.Collect(), 1001U);
+}
+
+void TestGenerationalCycleCollector() {
+    Class cls("Node"s, {}, nullptr);
+    const Symbol link = "link"s;
+    auto make_node = [&cls] {
+        return ObjectHolder::Own(ClassInstance(cls));
+    };
+    auto set_link = [&link](const ObjectHolder& from, const ObjectHolder& to) {
+        from.TryAs<ClassInstance>()->SetField(link, to);
+    };
+
+    CycleCollector::Options options;
+    options.threshold = 0;
+    options.generational = true;
+    CycleCollector collector(options);
+    CycleCollector::Scope scope(collector);
+
+    // Старый объект и старый цикл
+    ObjectHolder old = make_node();
+    {
+        ObjectHolder a = make_node();
+        ObjectHolder b = make_node();
+        set_link(a, b);
+        set_link(b, a);
+        ASSERT_EQUAL(collector.CollectYoung(), 0U);
+    }
+    ASSERT_EQUAL(collector.GetYoungCount(), 0U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 3U);
+
+    // Молодой объект, на который ссылается только старый, уцелевает: ссылка из старого
+    // поколения считается внешней
+    ObjectHolder young = make_node();
+    set_link(old, young);
+    set_link(young, old);
+    young = {};
+    {
+        ObjectHolder c = make_node();
+        ObjectHolder d = make_node();
+        set_link(c, d);
+        set_link(d, c);
+    }
+    ASSERT_EQUAL(collector.GetYoungCount(), 3U);
+
+    // Сборка молодого поколения удаляет только молодой цикл
+    ASSERT_EQUAL(collector.CollectYoung(), 2U);
+    ASSERT_EQUAL(collector.GetYoungCount(), 0U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 4U);
+    ASSERT(old.TryAs<ClassInstance>()->FindField(link)->TryAs<ClassInstance>() != nullptr);
+
+    // Полная сборка удаляет циклы старого поколения
+    ASSERT_EQUAL(collector.Collect(), 2U);
+    old = {};
+    ASSERT_EQUAL(collector.Collect(), 2U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 0U);
+    ASSERT_EQUAL(collector.GetStats().collections, 4U);
+    ASSERT_EQUAL(collector.GetStats().young_collections, 2U);
+}
+
+void TestGenerationalCycleCollectorThreshold() {
+    Class cls("Node"s, {}, nullptr);
+    CycleCollector::Options options;
+    options.threshold = 100;
+    options.generational = true;
+    options.full_collection_interval = 4;
+    CycleCollector collector(options);
+    CycleCollector::Scope scope(collector);
+
+    for (int i = 0; i < 1000; ++i) {
+        ObjectHolder node = ObjectHolder::Own(ClassInstance(cls));
+        node.TryAs<ClassInstance>()->SetField("self"s, node);
+    }
+    // Каждая четвёртая сборка полная. Циклы, перешедшие в старое поколение после
+    // последней полной сборки, остаются до следующей
+    ASSERT_EQUAL(collector.GetStats().collections, 10U);
+    ASSERT_EQUAL(collector.GetStats().young_collections, 8U);
+    ASSERT_EQUAL(collector.GetStats().collected_objects, 997U);
+    ASSERT_EQUAL(collector.GetTrackedCount(), 3U);
+    ASSERT_EQUAL(collector.GetYoungCount(), 0U);
+}
+
+void TestBufferedContext() {
+    {
+        ostringstream output;
+        BufferedContext context{output, 8};
+        context.GetOutputStream() << "abc\n"sv;
+        ASSERT(output.str().empty());
+        context.GetOutputStream() << "defgh"sv << 42;
+        ASSERT_EQUAL(output.str(), "abc\ndefg"s);
+        context.Flush();
+        ASSERT_EQUAL(output.str(), "abc\ndefgh42"s);
+    }
+    {
+        ostringstream output;
+        BufferedContext context{output, 4, OutputBuffering::Line};
+        context.GetOutputStream() << "ab"sv;
+        ASSERT(output.str().empty());
+        context.GetOutputStream() << 'c' << '\n';
+        ASSERT_EQUAL(output.str(), "abc\n"s);
+        context.GetOutputStream() << "long line\nx"sv;
+        ASSERT_EQUAL(output.str(), "abc\nlong line\nx"s);
+    }
+    // Накопленный вывод не теряется, если выполнение прервано исключением
+    ostringstream output;
+    try {
+        BufferedContext context{output};
+        context.GetOutputStream() << "partial"sv;
+        throw runtime_error("error"s);
+    } catch (const runtime_error&) {
+    }
+    ASSERT_EQUAL(output.str(), "partial"s);
+}
+
 }  // namespace
 
 void RunObjectsTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNumber);
     RUN_TEST(tr, runtime::TestString);
+    RUN_TEST(tr, runtime::TestStringConcatenation);
     RUN_TEST(tr, runtime::TestBool);
     RUN_TEST(tr, runtime::TestMethodInvocation);
     RUN_TEST(tr, runtime::TestIsTrue);
     RUN_TEST(tr, runtime::TestComparison);
     RUN_TEST(tr, runtime::TestClass);
+    RUN_TEST(tr, runtime::TestClassHierarchy);
     RUN_TEST(tr, runtime::TestClassInstance);
+    RUN_TEST(tr, runtime::TestSymbols);
+    RUN_TEST(tr, runtime::TestShapes);
+    RUN_TEST(tr, runtime::TestFieldCache);
+    RUN_TEST(tr, runtime::TestMethodCache);
+    RUN_TEST(tr, runtime::TestBufferedContext);
+    RUN_TEST(tr, runtime::TestPool);
+    RUN_TEST(tr, runtime::TestCycleCollector);
+    RUN_TEST(tr, runtime::TestCycleCollectorThreshold);
+    RUN_TEST(tr, runtime::TestGenerationalCycleCollector);
+    RUN_TEST(tr, runtime::TestGenerationalCycleCollectorThreshold);
 }
 
 void RunObjectHolderTests(TestRunner& tr) {
     RUN_TEST(tr, runtime::TestNonowning);
     RUN_TEST(tr, runtime::TestOwning);
     RUN_TEST(tr, runtime::TestMove);
+    RUN_TEST(tr, runtime::TestSharedOwnership);
+    RUN_TEST(tr, runtime::TestRefCountOverflow);
     RUN_TEST(tr, runtime::TestNullptr);
+    RUN_TEST(tr, runtime::TestKinds);
 }
 
 }  // namespace runtime
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "scan.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MYTHON_HAS_X86_SIMD 1
+#endif
+
+using namespace std;
+
+namespace parse {
+
+    namespace {
+
+        struct ScanFunctions {
+            ScanIsa isa;
+            size_t (*find_first_of)(std::string_view text, size_t pos, char a, char b, char c, char d);
+            size_t (*find_first_not)(std::string_view text, size_t pos, char ch);
+        };
+
+        size_t ScalarFindFirstOf(std::string_view text, size_t pos, char a, char b, char c, char d) {
+            for (; pos < text.size(); ++pos) {
+                const char ch = text[pos];
+                if (ch == a || ch == b || ch == c || ch == d) {
+                    return pos;
+                }
+            }
+            return text.size();
+        }
+
+        size_t ScalarFindFirstNot(std::string_view text, size_t pos, char ch) {
+            while (pos < text.size() && text[pos] == ch) {
+                ++pos;
+            }
+            return pos;
+        }
+
+        constexpr ScanFunctions SCALAR_FUNCTIONS{ScanIsa::Scalar, ScalarFindFirstOf, ScalarFindFirstNot};
+
+#ifdef MYTHON_HAS_X86_SIMD
+
+        // SSE2 входит в базовый набор инструкций x86-64, поэтому отдельная проверка не нужна.
+        // Блоки читаются только целиком внутри text, остаток досматривается посимвольно
+        size_t Sse2FindFirstOf(std::string_view text, size_t pos, char a, char b, char c, char d) {
+            const __m128i va = _mm_set1_epi8(a);
+            const __m128i vb = _mm_set1_epi8(b);
+            const __m128i vc = _mm_set1_epi8(c);
+            const __m128i vd = _mm_set1_epi8(d);
+            for (; pos + 16 <= text.size(); pos += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+                const __m128i found = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)),
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, vc), _mm_cmpeq_epi8(chunk, vd)));
+                if (const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(found))) {
+                    return pos + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return ScalarFindFirstOf(text, pos, a, b, c, d);
+        }
+
+        size_t Sse2FindFirstNot(std::string_view text, size_t pos, char ch) {
+            const __m128i vch = _mm_set1_epi8(ch);
+            for (; pos + 16 <= text.size(); pos += 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + pos));
+                const unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, vch))) & 0xFFFFu;
+                if (mask != 0) {
+                    return pos + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return ScalarFindFirstNot(text, pos, ch);
+        }
+
+        // Функции с атрибутом target компилируются с AVX2 независимо от флагов сборки
+        // и вызываются, только если процессор его поддерживает
+        __attribute__((target("avx2")))
+        size_t Avx2FindFirstOf(std::string_view text, size_t pos, char a, char b, char c, char d) {
+            const __m256i va = _mm256_set1_epi8(a);
+            const __m256i vb = _mm256_set1_epi8(b);
+            const __m256i vc = _mm256_set1_epi8(c);
+            const __m256i vd = _mm256_set1_epi8(d);
+            for (; pos + 32 <= text.size(); pos += 32) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + pos));
+                const __m256i found = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, va), _mm256_cmpeq_epi8(chunk, vb)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, vc), _mm256_cmpeq_epi8(chunk, vd)));
+                if (const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(found))) {
+                    return pos + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return Sse2FindFirstOf(text, pos, a, b, c, d);
+        }
+
+        __attribute__((target("avx2")))
+        size_t Avx2FindFirstNot(std::string_view text, size_t pos, char ch) {
+            const __m256i vch = _mm256_set1_epi8(ch);
+            for (; pos + 32 <= text.size(); pos += 32) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + pos));
+                const unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, vch)));
+                if (mask != 0) {
+                    return pos + static_cast<size_t>(__builtin_ctz(mask));
+                }
+            }
+            return Sse2FindFirstNot(text, pos, ch);
+        }
+
+        constexpr ScanFunctions SSE2_FUNCTIONS{ScanIsa::Sse2, Sse2FindFirstOf, Sse2FindFirstNot};
+        constexpr ScanFunctions AVX2_FUNCTIONS{ScanIsa::Avx2, Avx2FindFirstOf, Avx2FindFirstNot};
+
+#endif
+
+        const ScanFunctions* GetFunctions(ScanIsa isa) {
+            switch (isa) {
+#ifdef MYTHON_HAS_X86_SIMD
+                case ScanIsa::Avx2:
+                    // Функция может вызываться до конструкторов libgcc, заполняющих сведения о процессоре
+                    __builtin_cpu_init();
+                    return __builtin_cpu_supports("avx2") ? &AVX2_FUNCTIONS : nullptr;
+                case ScanIsa::Sse2:
+                    return &SSE2_FUNCTIONS;
+#endif
+                case ScanIsa::Scalar:
+                    return &SCALAR_FUNCTIONS;
+                default:
+                    return nullptr;
+            }
+        }
+
+        const ScanFunctions* DetectFunctions() {
+            for (ScanIsa isa : {ScanIsa::Avx2, ScanIsa::Sse2}) {
+                if (const ScanFunctions* functions = GetFunctions(isa)) {
+                    return functions;
+                }
+            }
+            return &SCALAR_FUNCTIONS;
+        }
+
+        // Реализация выбирается при первом обращении, так что искать можно и при инициализации
+        // глобальных объектов
+        std::atomic<const ScanFunctions*>& CurrentFunctions() {
+            static std::atomic<const ScanFunctions*> functions{DetectFunctions()};
+            return functions;
+        }
+
+        const ScanFunctions& Current() {
+            return *CurrentFunctions().load(std::memory_order_relaxed);
+        }
+
+    }  // namespace
+
+    size_t FindFirstOf(std::string_view text, size_t pos, char a, char b, char c, char d) {
+        return Current().find_first_of(text, pos, a, b, c, d);
+    }
+
+    size_t FindFirstNot(std::string_view text, size_t pos, char ch) {
+        return Current().find_first_not(text, pos, ch);
+    }
+
+    ScanIsa GetScanIsa() {
+        return Current().isa;
+    }
+
+    bool IsScanIsaSupported(ScanIsa isa) {
+        return GetFunctions(isa) != nullptr;
+    }
+
+    void SetScanIsa(ScanIsa isa) {
+        const ScanFunctions* functions = GetFunctions(isa);
+        if (functions == nullptr) {
+            throw std::invalid_argument("Instruction set "s + GetScanIsaName(isa) + " is not supported"s);
+        }
+        CurrentFunctions().store(functions, std::memory_order_relaxed);
+    }
+
+    const char* GetScanIsaName(ScanIsa isa) {
+        switch (isa) {
+            case ScanIsa::Scalar:
+                return "scalar";
+            case ScanIsa::Sse2:
+                return "SSE2";
+            case ScanIsa::Avx2:
+                return "AVX2";
+        }
+        return "unknown";
+    }
+
+}  // namespace parse
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace parse {
+
+    /*
+     * Поиск символов в тексте программы блоками по 16 (SSE2) или 32 (AVX2) байта.
+     * Реализация выбирается при запуске по возможностям процессора. На платформах без этих
+     * наборов инструкций используется посимвольный поиск
+     */
+    enum class ScanIsa {
+        Scalar,
+        Sse2,
+        Avx2,
+    };
+
+    // Возвращает позицию первого символа text, начиная с pos, который равен одному из символов
+    // a, b, c, d, либо text.size(). Чтобы искать меньше четырёх символов, их можно повторить
+    size_t FindFirstOf(std::string_view text, size_t pos, char a, char b, char c, char d);
+
+    // Возвращает позицию первого символа text, начиная с pos, отличного от ch, либо text.size()
+    size_t FindFirstNot(std::string_view text, size_t pos, char ch);
+
+    // Возвращает набор инструкций, которым пользуются функции поиска
+    ScanIsa GetScanIsa();
+
+    // Возвращает true, если процессор поддерживает набор инструкций isa
+    bool IsScanIsaSupported(ScanIsa isa);
+
+    // Переключает функции поиска на набор инструкций isa, например чтобы сравнить реализации.
+    // Выбрасывает std::invalid_argument, если процессор его не поддерживает
+    void SetScanIsa(ScanIsa isa);
+
+    const char* GetScanIsaName(ScanIsa isa);
+
+}  // namespace parse
@@ -12,54 +12,95 @@ using runtime::Context;
 using runtime::ObjectHolder;
 
 namespace {
-const string ADD_METHOD = "__add__"s;
-const string INIT_METHOD = "__init__"s;
+const runtime::Symbol INIT_METHOD{"__init__"sv};
+
+// Заголовок перед каждым узлом. Его размер сохраняет выравнивание, которое гарантирует operator new
+struct alignas(std::max_align_t) NodeHeader {
+    bool in_arena;
+};
+
 }  // namespace
 
+void* Statement::operator new(size_t size) {
+    Arena* arena = Arena::Current();
+    void* block = arena != nullptr ? arena->Allocate(sizeof(NodeHeader) + size)
+                                   : ::operator new(sizeof(NodeHeader) + size);
+    auto* header = new (block) NodeHeader{arena != nullptr};
+    return header + 1;
+}
+
+void Statement::operator delete(void* ptr) noexcept {
+    if (ptr == nullptr) {
+        return;
+    }
+    auto* header = static_cast<NodeHeader*>(ptr) - 1;
+    if (!header->in_arena) {
+        ::operator delete(header);
+    }
+}
+
+void DestroyTree(unique_ptr<Statement> root) {
+    vector<unique_ptr<Statement>> pending;
+    const Statement::ChildVisitor release = [&pending](unique_ptr<Statement>& child) {
+        if (child) {
+            pending.push_back(std::move(child));
+        }
+    };
+    release(root);
+    while (!pending.empty()) {
+        unique_ptr<Statement> node = std::move(pending.back());
+        pending.pop_back();
+        node->ForEachChild(release);
+    }
+}
+
 ObjectHolder Assignment::Execute(Closure& closure, Context& context) {
     closure[var_] = rv_.get()->Execute(closure, context);
     return closure[var_];
 }
 
-Assignment::Assignment(string var, unique_ptr<Statement> rv) : var_(move(var)), rv_(move(rv)) {
+Assignment::Assignment(runtime::Symbol var, unique_ptr<Statement> rv) : var_(var), rv_(move(rv)) {
 }
 
-VariableValue::VariableValue(const string& var_name) : var_name_(var_name) {
+VariableValue::VariableValue(runtime::Symbol var_name) : var_name_(var_name) {
 }
 
-VariableValue::VariableValue(vector<string> dotted_ids) : dotted_ids_(move(dotted_ids)) {
+VariableValue::VariableValue(const vector<string>& dotted_ids)
+    : VariableValue(vector<runtime::Symbol>(dotted_ids.begin(), dotted_ids.end())) {
 }
 
-ObjectHolder VariableValue::Execute(Closure& closure, Context&) {
-    
-    if (!dotted_ids_.empty()) {
-
-        Closure closure_for_search = closure;
-        ObjectHolder result;
+VariableValue::VariableValue(vector<runtime::Symbol> dotted_ids) : dotted_ids_(move(dotted_ids)) {
+    if (dotted_ids_.size() > 1) {
+        field_caches_.resize(dotted_ids_.size() - 1);
+    }
+}
 
-        for (const string& id : dotted_ids_) {
-            if (closure_for_search.count(id) == 0) {
-                throw std::runtime_error("Unable to evaluate a variable with the given name"s);
-            }
-            ObjectHolder& field = closure_for_search.at(id);
-            result = field;
-            runtime::ClassInstance* field_value_ptr = field.TryAs<runtime::ClassInstance>();
-            if (!field_value_ptr) {
-                break;
-            }
-            closure_for_search = field_value_ptr->Fields();
-            
-        }
-        return result;
+vector<runtime::Symbol> VariableValue::GetDottedIds() const {
+    if (!dotted_ids_.empty()) {
+        return dotted_ids_;
     }
+    return {var_name_};
+}
 
-    std::string var_name = std::string{ var_name_ };
-    
-    if (closure.count(var_name) == 0) {
+ObjectHolder VariableValue::Execute(Closure& closure, Context&) {
+    const auto it = closure.find(dotted_ids_.empty() ? var_name_ : dotted_ids_.front());
+    if (it == closure.end()) {
         throw std::runtime_error("Unable to evaluate a variable with the given name"s);
     }
 
-    return closure.at(var_name);
+    // Спускаемся по полям объектов, не копируя их: found указывает на последнее найденное значение
+    const ObjectHolder* found = &it->second;
+    for (size_t i = 1; i < dotted_ids_.size(); ++i) {
+        const runtime::ClassInstance* instance = found->TryAs<runtime::ClassInstance>();
+        if (!instance) {
+            break;
+        }
+        found = field_caches_[i - 1].Load(*instance, dotted_ids_[i]);
+        if (!found) {
+            throw std::runtime_error("Unable to evaluate a variable with the given name"s);
+        }
+    }
+    return *found;
 }
 
 unique_ptr<Print> Print::Variable(const string& name) {
@@ -72,18 +113,29 @@ Print::Print(unique_ptr<Statement> argument) : argument_(move(argument)) {
 Print::Print(vector<unique_ptr<Statement>> args) : args_(move(args)) {
 }
 
+vector<const Statement*> Print::GetArgs() const {
+    vector<const Statement*> result;
+    if (argument_) {
+        result.push_back(argument_.get());
+    }
+    for (const auto& arg : args_) {
+        result.push_back(arg.get());
+    }
+    return result;
+}
+
 ObjectHolder Print::Execute(Closure& closure, Context& context) {
 
     std::ostream& os = context.GetOutputStream();
 
     if (!args_.empty()) {
         PrintArgs(os, closure, context);
-        os << std::endl;
+        os << '\n';
         return {};
     }
 
     PrintArgument(os, argument_, closure, context);
-    os << std::endl;
+    os << '\n';
     return {};
 }
 
@@ -111,41 +163,40 @@ void Print::PrintArgs(std::ostream& os, Closure& closure, Context& context) cons
     return;
 }
 
-void Print::PrintObj(ostream& os, ObjectHolder obj, Closure& closure, Context& context) const {
+void Print::PrintObj(ostream& os, const ObjectHolder& obj, Closure& closure, Context& context) const {
 
-    if (runtime::String* rv = obj.TryAs<runtime::String>(); rv) {
-        const string& rv_value = rv->GetValue();
-        if (closure.count(rv_value) != 0) {
-            const auto& value_obj = closure.at(rv_value);
-            PrintObj(os, value_obj, closure, context);
-            return;
-        }
-        os << rv->GetValue();
-    }
-    else if (runtime::Number* rv = obj.TryAs<runtime::Number>(); rv) {
-        os << rv->GetValue();
-    }
-    else if (runtime::Bool* rv = obj.TryAs<runtime::Bool>(); rv) {
-        bool value = rv->GetValue();
-        if (value) {
-            os << "True"s;
-        }
-        else {
-            os << "False"s;
+    switch (obj.GetKind()) {
+        case runtime::Kind::String: {
+            const string& rv_value = obj.TryAs<runtime::String>()->GetValue();
+            // Имя переменной уже интернировано, поэтому строку, не ставшую символом, не ищем
+            // и не добавляем в таблицу символов
+            if (auto name = runtime::Symbol::TryFind(rv_value)) {
+                if (auto it = closure.find(*name); it != closure.end()) {
+                    PrintObj(os, it->second, closure, context);
+                    return;
+                }
+            }
+            os << rv_value;
+            break;
         }
+        case runtime::Kind::Number:
+            os << obj.TryAs<runtime::Number>()->GetValue();
+            break;
+        case runtime::Kind::Bool:
+            os << (obj.TryAs<runtime::Bool>()->GetValue() ? "True"sv : "False"sv);
+            break;
+        case runtime::Kind::ClassInstance:
+            obj.TryAs<runtime::ClassInstance>()->Print(os, context);
+            break;
+        default:
+            os << "None"sv;
+            break;
     }
-    else if (runtime::ClassInstance* rv = obj.TryAs<runtime::ClassInstance>(); rv) {
-        rv->Print(os, context);
-    }
-    else {
-        os << "None"s;
-    }
-    return;
 
 }
 
-MethodCall::MethodCall(std::unique_ptr<Statement> object, std::string method,
-                       std::vector<std::unique_ptr<Statement>> args) : object_(move(object)), method_(move(method)), args_(move(args)) {
+MethodCall::MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
+                       std::vector<std::unique_ptr<Statement>> args) : object_(move(object)), method_(method), args_(move(args)) {
 }
 
 ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
@@ -160,8 +211,10 @@ ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
             args_holders.push_back(move(arg_holder));
         }
         try {
-            auto result = inst_ptr->Call(method_, args_holders, context);
-            return result;
+            const runtime::Method* method = call_cache_.Find(inst_ptr->GetClass(), method_);
+            if (method != nullptr) {
+                return inst_ptr->Call(*method, args_holders, context);
+            }
         }
         catch (...) {
 
@@ -174,197 +227,55 @@ ObjectHolder MethodCall::Execute(Closure& closure, Context& context) {
 
 
 ObjectHolder Stringify::Execute(Closure& closure, Context& context) {
-
     auto arg_obj = arg_.get()->Execute(closure, context);
-
-    if (runtime::String* var = arg_obj.TryAs<runtime::String>(); var) {
-        std::string value = var->GetValue();
-        return ObjectHolder::Own(runtime::String(move(value)));
-    }
-    else if (runtime::Number* var = arg_obj.TryAs<runtime::Number>(); var) {
-        int value = var->GetValue();
-        ObjectHolder result = ObjectHolder::Own(runtime::String(to_string(value)));
-        return ObjectHolder::Own(runtime::String(to_string(value)));
-    }
-    else if (runtime::Bool* var = arg_obj.TryAs<runtime::Bool>(); var) {
-        bool value = var->GetValue();
-        if (value) {
-            return ObjectHolder::Own(runtime::String("True"s));
-        }
-        return ObjectHolder::Own(runtime::String("False"s));;
-    }
-    else if (runtime::ClassInstance* var = arg_obj.TryAs<runtime::ClassInstance>(); var) {
-        runtime::DummyContext context;
-        try {
-            auto result_of_str = var->Call("__str__"s, {}, context);
-            return ConverResultStrToObjectHolder(result_of_str);
-        }
-        catch (...) {
-
-        }
-        std::ostringstream os;
-        os << var;
-        std::string class_ptr = os.str();
-
-        return ObjectHolder::Own(runtime::String(move(class_ptr)));
-    }
-
-    return ObjectHolder::Own(runtime::String("None"s));
-}
-
-ObjectHolder Stringify::ConverResultStrToObjectHolder(ObjectHolder& result_str) {
-
-    if (runtime::String* var = result_str.TryAs<runtime::String>(); var) {
-        std::string value = var->GetValue();
-        return ObjectHolder::Own(runtime::String(move(value)));
-    }
-    else if (runtime::Number* var = result_str.TryAs<runtime::Number>(); var) {
-        int value = var->GetValue();
-        return ObjectHolder::Own(runtime::String(to_string(value)));
-    }
-    else if (runtime::Bool* var = result_str.TryAs<runtime::Bool>(); var) {
-        bool value = var->GetValue();
-        if (value) {
-            return ObjectHolder::Own(runtime::String("True"s));
-        }
-        return ObjectHolder::Own(runtime::String("False"s));;
-    }
-    else if (runtime::ClassInstance* var = result_str.TryAs<runtime::ClassInstance>(); var) {
-        runtime::DummyContext context;
-        try {
-            auto result_of_str = var->Call("__str__"s, {}, context);
-            return ConverResultStrToObjectHolder(result_of_str);
-        }
-        catch (...) {
-
-        }
-        std::ostringstream os;
-        os << var;
-        std::string class_ptr = os.str();
-        return ObjectHolder::Own(runtime::String(move(class_ptr)));
-    }
-
-    return ObjectHolder::Own(runtime::String("None"s));
+    return runtime::Stringify(arg_obj);
 }
 
-
 ObjectHolder Add::Execute(Closure& closure, Context& context) {
     auto lhs_holder = lhs_.get()->Execute(closure, context);
     auto rhs_holder = rhs_.get()->Execute(closure, context);
-
-    ValueType lhs_type = GetValueTypeOfObjHolder(lhs_holder);
-    ValueType rhs_type = GetValueTypeOfObjHolder(rhs_holder);
-
-    if (lhs_type == ValueType::Number && rhs_type == ValueType::Number) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::Number>();
-        int lhs_value = lhs_ptr->GetValue();
-        auto rhs_ptr = rhs_holder.TryAs<runtime::Number>();
-        int rhs_value = rhs_ptr->GetValue();
-        int result_sum = lhs_value + rhs_value;
-        return ObjectHolder::Own(runtime::Number(result_sum));
-    }
-    else if (lhs_type == ValueType::String && rhs_type == ValueType::String) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::String>();
-        string lhs_value = lhs_ptr->GetValue();
-        auto rhs_ptr = rhs_holder.TryAs<runtime::String>();
-        string rhs_value = rhs_ptr->GetValue();
-        string result_str = lhs_value + rhs_value;
-        return ObjectHolder::Own(runtime::String(result_str));
-
-    }
-    else if (lhs_type == ValueType::ClassInstance) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::ClassInstance>();
-        if (lhs_ptr->HasMethod(ADD_METHOD, 1)) {
-            return lhs_ptr->Call(ADD_METHOD, { rhs_holder }, context);
-        }
-        throw std::runtime_error("lhs does not have method __add__"s);
-    }
-
-    throw std::runtime_error("Can't add arguments with given types"s);
-
-    return {};
+    return runtime::Add(lhs_holder, rhs_holder, context);
 }
 
 ObjectHolder Sub::Execute(Closure& closure, Context& context) {
-
     auto lhs_holder = lhs_.get()->Execute(closure, context);
     auto rhs_holder = rhs_.get()->Execute(closure, context);
-
-    ValueType lhs_type = GetValueTypeOfObjHolder(lhs_holder);
-    ValueType rhs_type = GetValueTypeOfObjHolder(rhs_holder);
-
-    if (lhs_type == ValueType::Number && rhs_type == ValueType::Number) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::Number>();
-        int lhs_value = lhs_ptr->GetValue();
-        auto rhs_ptr = rhs_holder.TryAs<runtime::Number>();
-        int rhs_value = rhs_ptr->GetValue();
-        int result = lhs_value - rhs_value;
-        return ObjectHolder::Own(runtime::Number(result));
-    }
-
-    throw std::runtime_error("Can't sub given types"s);
-    return {};
+    return runtime::Sub(lhs_holder, rhs_holder);
 }
 
 ObjectHolder Mult::Execute(Closure& closure, Context& context) {
-    
     auto lhs_holder = lhs_.get()->Execute(closure, context);
     auto rhs_holder = rhs_.get()->Execute(closure, context);
-
-    ValueType lhs_type = GetValueTypeOfObjHolder(lhs_holder);
-    ValueType rhs_type = GetValueTypeOfObjHolder(rhs_holder);
-
-    if (lhs_type == ValueType::Number && rhs_type == ValueType::Number) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::Number>();
-        int lhs_value = lhs_ptr->GetValue();
-        auto rhs_ptr = rhs_holder.TryAs<runtime::Number>();
-        int rhs_value = rhs_ptr->GetValue();
-        int result = lhs_value * rhs_value;
-        return ObjectHolder::Own(runtime::Number(result));
-    }
-
-    throw std::runtime_error("Can't multiply given types"s);
-
-    return {};
+    return runtime::Mult(lhs_holder, rhs_holder);
 }
 
 ObjectHolder Div::Execute(Closure& closure, Context& context) {
-    
     auto lhs_holder = lhs_.get()->Execute(closure, context);
     auto rhs_holder = rhs_.get()->Execute(closure, context);
-
-    ValueType lhs_type = GetValueTypeOfObjHolder(lhs_holder);
-    ValueType rhs_type = GetValueTypeOfObjHolder(rhs_holder);
-
-    if (lhs_type == ValueType::Number && rhs_type == ValueType::Number) {
-        auto lhs_ptr = lhs_holder.TryAs<runtime::Number>();
-        int lhs_value = lhs_ptr->GetValue();
-        auto rhs_ptr = rhs_holder.TryAs<runtime::Number>();
-        int rhs_value = rhs_ptr->GetValue();
-        if (rhs_value == 0) {
-            throw std::runtime_error("Can't divide by 0"s);
-        }
-        int result = lhs_value / rhs_value;
-        return ObjectHolder::Own(runtime::Number(result));
-    }
-
-    throw std::runtime_error("Can't divide given types"s);
-
-    return {};
+    return runtime::Div(lhs_holder, rhs_holder);
 }
 
 ObjectHolder Compound::Execute(Closure& closure, Context& context) {
+    ExecuteCompletion(closure, context);
+    return {};
+}
 
+Completion Compound::ExecuteCompletion(Closure& closure, Context& context) {
     for (const auto& command : commands_) {
-        command.get()->Execute(closure, context);
+        Completion completion = command->ExecuteCompletion(closure, context);
+        if (completion.is_return) {
+            return completion;
+        }
     }
-
     return {};
 }
 
 ObjectHolder Return::Execute(Closure& closure, Context& context) {
-    throw return_except(statement_.get()->Execute(closure, context));
-    return {};
+    return statement_->Execute(closure, context);
+}
+
+Completion Return::ExecuteCompletion(Closure& closure, Context& context) {
+    return {statement_->Execute(closure, context), true};
 }
 
 ClassDefinition::ClassDefinition(ObjectHolder cls) : cls_(move(cls)) {
@@ -378,8 +289,8 @@ ObjectHolder ClassDefinition::Execute(Closure& closure, Context&) {
     return cls_;
 }
 
-FieldAssignment::FieldAssignment(VariableValue object, std::string field_name,
-                                 std::unique_ptr<Statement> rv) : object_(std::move(object)), assign_var_(move(field_name), move(rv)) {
+FieldAssignment::FieldAssignment(VariableValue object, runtime::Symbol field_name,
+                                 std::unique_ptr<Statement> rv) : object_(std::move(object)), assign_var_(field_name, move(rv)) {
 
 }
 
@@ -387,7 +298,10 @@ ObjectHolder FieldAssignment::Execute(Closure& closure, Context& context) {
     auto rv = assign_var_.Execute(closure, context);
     auto obj_holder = object_.Execute(closure, context);
     auto instance = obj_holder.TryAs<runtime::ClassInstance>();
-    instance->Fields()[assign_var_.GetVarName()] = rv;
+    if (!instance) {
+        throw std::runtime_error("Can't assign a field of non-object value"s);
+    }
+    field_cache_.Store(*instance, assign_var_.GetVarName(), rv);
     return rv;
 }
 
@@ -397,9 +311,7 @@ IfElse::IfElse(std::unique_ptr<Statement> condition, std::unique_ptr<Statement>
 
 ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
 
-    auto condit_obj = condition_.get()->Execute(closure, context);
-
-    if (runtime::IsTrue(condit_obj)) {
+    if (condition_->ExecuteCondition(closure, context)) {
         return if_body_.get()->Execute(closure, context);
     }
     if (else_body_.get()) {
@@ -408,33 +320,38 @@ ObjectHolder IfElse::Execute(Closure& closure, Context& context) {
     return {};
 }
 
-ObjectHolder Or::Execute(Closure& closure, Context& context) {
-
-    auto lhs_holder = lhs_.get()->Execute(closure, context);
-    bool lhs_result = runtime::IsTrue(lhs_holder);
-
-    if (!lhs_result) {
-        auto rhs_holder = rhs_.get()->Execute(closure, context);
-        bool rhs_result = runtime::IsTrue(rhs_holder);
-        return ObjectHolder::Own(runtime::Bool(rhs_result));
+Completion IfElse::ExecuteCompletion(Closure& closure, Context& context) {
+    if (condition_->ExecuteCondition(closure, context)) {
+        return if_body_->ExecuteCompletion(closure, context);
+    }
+    if (else_body_) {
+        return else_body_->ExecuteCompletion(closure, context);
     }
+    return {};
+}
 
-    return ObjectHolder::Own(runtime::Bool(lhs_result));
+ObjectHolder Or::Execute(Closure& closure, Context& context) {
+    return ObjectHolder::Own(runtime::Bool(ExecuteCondition(closure, context)));
 }
 
-ObjectHolder And::Execute(Closure& closure, Context& context) {
+bool Or::ExecuteCondition(Closure& closure, Context& context) {
+    return lhs_->ExecuteCondition(closure, context) || rhs_->ExecuteCondition(closure, context);
+}
 
-    auto lhs_holder = lhs_.get()->Execute(closure, context);
-    auto rhs_holder = rhs_.get()->Execute(closure, context);
-    bool lhs_result = runtime::IsTrue(lhs_holder);
-    bool rhs_result = runtime::IsTrue(rhs_holder);
+ObjectHolder And::Execute(Closure& closure, Context& context) {
+    return ObjectHolder::Own(runtime::Bool(ExecuteCondition(closure, context)));
+}
 
-    return ObjectHolder::Own(runtime::Bool(lhs_result && rhs_result));
+bool And::ExecuteCondition(Closure& closure, Context& context) {
+    return lhs_->ExecuteCondition(closure, context) && rhs_->ExecuteCondition(closure, context);
 }
 
 ObjectHolder Not::Execute(Closure& closure, Context& context) {
-    auto arg_holder = arg_.get()->Execute(closure, context);
-    return ObjectHolder::Own(runtime::Bool(!runtime::IsTrue(arg_holder)));
+    return ObjectHolder::Own(runtime::Bool(ExecuteCondition(closure, context)));
+}
+
+bool Not::ExecuteCondition(Closure& closure, Context& context) {
+    return !arg_->ExecuteCondition(closure, context);
 }
 
 Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Statement> rhs)
@@ -443,63 +360,142 @@ Comparison::Comparison(Comparator cmp, unique_ptr<Statement> lhs, unique_ptr<Sta
 }
 
 ObjectHolder Comparison::Execute(Closure& closure, Context& context) {
+    return ObjectHolder::Own(runtime::Bool(ExecuteCondition(closure, context)));
+}
+
+bool Comparison::ExecuteCondition(Closure& closure, Context& context) {
     auto lhs_holder = lhs_.get()->Execute(closure, context);
     auto rhs_holder = rhs_.get()->Execute(closure, context);
-    return ObjectHolder::Own(runtime::Bool(cmp_(lhs_holder, rhs_holder, context)));
+    return cmp_(lhs_holder, rhs_holder, context);
 }
 
-NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args) : inst_(class_), args_(move(args)) {
+NewInstance::NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args) : cls_(&class_), args_(move(args)) {
 }
 
-NewInstance::NewInstance(const runtime::Class& class_) : inst_(class_) {
+NewInstance::NewInstance(const runtime::Class& class_) : cls_(&class_) {
     
 }
 
 ObjectHolder NewInstance::Execute(Closure& closure, Context& context) {
-    if (inst_.HasMethod(INIT_METHOD, args_.size())) {
+    ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(*cls_));
+    if (const runtime::Method* init = cls_->GetMethod(INIT_METHOD, args_.size())) {
         vector<ObjectHolder> arg_holders;
         arg_holders.reserve(args_.size());
         for (const auto& arg : args_) {
-            auto arg_holder = arg.get()->Execute(closure, context);
-            arg_holders.push_back(arg_holder);
+            arg_holders.push_back(arg.get()->Execute(closure, context));
         }
-        inst_.Call(INIT_METHOD, arg_holders, context);
+        instance.TryAs<runtime::ClassInstance>()->Call(*init, arg_holders, context);
     }
     
-    return ObjectHolder::Share(inst_);
+    return instance;
+
+}
 
+MethodBody::MethodBody(std::unique_ptr<Statement>&& body, std::shared_ptr<Arena> arena)
+    : arena_(move(arena)), body_(move(body)) {
 }
 
-MethodBody::MethodBody(std::unique_ptr<Statement>&& body) : body_(move(body)) {
+MethodBody::~MethodBody() {
+    DestroyTree(move(body_));
 }
 
 ObjectHolder MethodBody::Execute(Closure& closure, Context& context) {
 
-    try {
-        body_.get()->Execute(closure, context);
+    Completion completion = body_->ExecuteCompletion(closure, context);
+    return completion.is_return ? std::move(completion.value) : ObjectHolder::None();
+}
+
+Program::Program(std::unique_ptr<Statement> body, std::shared_ptr<Arena> arena)
+    : arena_(move(arena)), body_(move(body)) {
+}
+
+Program::~Program() {
+    DestroyTree(move(body_));
+}
+
+ObjectHolder Program::Execute(Closure& closure, Context& context) {
+    return body_->Execute(closure, context);
+}
+
+void Program::ForEachChild(const ChildVisitor& visit) {
+    visit(body_);
+}
+
+void MethodBody::ForEachChild(const ChildVisitor& visit) {
+    visit(body_);
+}
+
+void Assignment::ForEachChild(const ChildVisitor& visit) {
+    visit(rv_);
+}
+
+void FieldAssignment::ForEachChild(const ChildVisitor& visit) {
+    assign_var_.ForEachChild(visit);
+}
+
+void Print::ForEachChild(const ChildVisitor& visit) {
+    if (argument_) {
+        visit(argument_);
     }
-    catch (return_except& except) {
-        return except.GetInfo();
+    for (auto& arg : args_) {
+        visit(arg);
     }
-
-    return {};
 }
 
-ValueType GetValueTypeOfObjHolder(ObjectHolder& holder) {
+void MethodCall::ForEachChild(const ChildVisitor& visit) {
+    visit(object_);
+    for (auto& arg : args_) {
+        visit(arg);
+    }
+}
 
-    if (runtime::String* var = holder.TryAs<runtime::String>(); var) {
-        return ValueType::String;
+void NewInstance::ForEachChild(const ChildVisitor& visit) {
+    for (auto& arg : args_) {
+        visit(arg);
     }
-    else if (runtime::Number* var = holder.TryAs<runtime::Number>(); var) {
-        return ValueType::Number;
+}
+
+void UnaryOperation::ForEachChild(const ChildVisitor& visit) {
+    visit(arg_);
+}
+
+void BinaryOperation::ForEachChild(const ChildVisitor& visit) {
+    visit(lhs_);
+    visit(rhs_);
+}
+
+void Compound::ForEachChild(const ChildVisitor& visit) {
+    for (auto& command : commands_) {
+        visit(command);
     }
-    else if (runtime::Bool* var = holder.TryAs<runtime::Bool>(); var) {
-        return ValueType::Bool;
+}
+
+void Return::ForEachChild(const ChildVisitor& visit) {
+    visit(statement_);
+}
+
+void IfElse::ForEachChild(const ChildVisitor& visit) {
+    visit(condition_);
+    visit(if_body_);
+    if (else_body_) {
+        visit(else_body_);
     }
-    else if (runtime::ClassInstance* var = holder.TryAs<runtime::ClassInstance>(); var) {
-        return ValueType::ClassInstance;
+}
+
+ValueType GetValueTypeOfObjHolder(ObjectHolder& holder) {
+
+    switch (holder.GetKind()) {
+        case runtime::Kind::String:
+            return ValueType::String;
+        case runtime::Kind::Number:
+            return ValueType::Number;
+        case runtime::Kind::Bool:
+            return ValueType::Bool;
+        case runtime::Kind::ClassInstance:
+            return ValueType::ClassInstance;
+        default:
+            return ValueType::None;
     }
-    return ValueType::None;
 }
 
 }  // namespace ast
\ No newline at end of file
@@ -1,13 +1,62 @@
 #pragma once
 
+#include "arena.h"
 #include "runtime.h"
 
 #include <functional>
 #include <string_view>
+#include <type_traits>
 
 namespace ast {
 
-using Statement = runtime::Executable;
+// Результат выполнения инструкции (completion record): значение инструкции
+// и признак того, что при её выполнении сработала команда return
+struct Completion {
+    runtime::ObjectHolder value;
+    bool is_return = false;
+};
+
+// Инструкция Mython
+class Statement : public runtime::Executable {
+public:
+    /*
+     * Узлы, созданные при действующем Arena::Scope, размещаются в арене, остальные - в куче.
+     * Перед узлом хранится заголовок, отмечающий узлы из арены: их память освобождается
+     * не при удалении узла, а вместе с ареной
+     */
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr) noexcept;
+
+    /*
+     * Выполняет инструкцию и сообщает, была ли выполнена команда return.
+     * Через этот метод return доходит до тела метода (MethodBody) без исключений:
+     * составные инструкции прекращают выполнение, получив Completion с is_return.
+     * Инструкции, которые не могут содержать return, переопределять его не должны
+     */
+    virtual Completion ExecuteCompletion(runtime::Closure& closure, runtime::Context& context) {
+        return {Execute(closure, context), false};
+    }
+
+    /*
+     * Вычисляет инструкцию как условие и возвращает её логическое значение. Логические
+     * операции и сравнения переопределяют метод, чтобы условие if вычислялось без создания
+     * промежуточных объектов Bool
+     */
+    virtual bool ExecuteCondition(runtime::Closure& closure, runtime::Context& context) {
+        return runtime::IsTrue(Execute(closure, context));
+    }
+
+    using ChildVisitor = std::function<void(std::unique_ptr<Statement>&)>;
+
+    // Передаёт visit дочерние узлы, которыми владеет инструкция. Посетитель может заменить
+    // узел или забрать его себе (см. DestroyTree и FoldConstants)
+    virtual void ForEachChild(const ChildVisitor& /*visit*/) {
+    }
+};
+
+// Разрушает дерево с корнем root, не углубляясь в рекурсию: каждый узел удаляется
+// после того, как его дочерние узлы перенесены в список ожидающих удаления
+void DestroyTree(std::unique_ptr<Statement> root);
 
 // Выражение, возвращающее значение типа T,
 // используется как основа для создания констант
@@ -20,7 +69,16 @@ public:
 
     runtime::ObjectHolder Execute(runtime::Closure& /*closure*/,
                                   runtime::Context& /*context*/) override {
-        return runtime::ObjectHolder::Share(value_);
+        // Числа и логические значения хранятся в ObjectHolder непосредственно
+        if constexpr (std::is_same_v<T, runtime::Number> || std::is_same_v<T, runtime::Bool>) {
+            return runtime::ObjectHolder::Own(value_);
+        } else {
+            return runtime::ObjectHolder::Share(value_);
+        }
+    }
+
+    const T& GetValue() const {
+        return value_;
     }
 
 private:
@@ -38,39 +96,61 @@ x = circle.center.x
 */
 class VariableValue : public Statement {
 public:
-    explicit VariableValue(const std::string& var_name);
-    explicit VariableValue(std::vector<std::string> dotted_ids);
+    explicit VariableValue(runtime::Symbol var_name);
+    explicit VariableValue(const std::vector<std::string>& dotted_ids);
+    explicit VariableValue(std::vector<runtime::Symbol> dotted_ids);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Возвращает цепочку имён id1.id2.id3 (для простой переменной - из одного элемента)
+    std::vector<runtime::Symbol> GetDottedIds() const;
 private:
-    std::string var_name_;
-    std::vector<std::string> dotted_ids_;
+    runtime::Symbol var_name_;
+    std::vector<runtime::Symbol> dotted_ids_;
+    // Кэши обращений к полям id2, id3, ...
+    std::vector<runtime::FieldCache> field_caches_;
 };
 
 // Присваивает переменной, имя которой задано в параметре var, значение выражения rv
 class Assignment : public Statement {
 public:
-    Assignment(std::string var, std::unique_ptr<Statement> rv);
+    Assignment(runtime::Symbol var, std::unique_ptr<Statement> rv);
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-    const std::string& GetVarName() const {
+    runtime::Symbol GetVarName() const {
         return var_;
     }
+    const Statement& GetValue() const {
+        return *rv_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
 
 private:
-    std::string var_;
+    runtime::Symbol var_;
     std::unique_ptr<Statement> rv_;
 };
 
 // Присваивает полю object.field_name значение выражения rv
 class FieldAssignment : public Statement {
 public:
-    FieldAssignment(VariableValue object, std::string field_name, std::unique_ptr<Statement> rv);
+    FieldAssignment(VariableValue object, runtime::Symbol field_name, std::unique_ptr<Statement> rv);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    const VariableValue& GetObject() const {
+        return object_;
+    }
+    runtime::Symbol GetFieldName() const {
+        return assign_var_.GetVarName();
+    }
+    const Statement& GetValue() const {
+        return assign_var_.GetValue();
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 private:
     VariableValue object_;
     Assignment assign_var_;
+    runtime::FieldCache field_cache_;
 };
 
 // Значение None
@@ -97,27 +177,47 @@ public:
     // context.GetOutputStream()
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    // Возвращает выражения для вывода. Аргумент, заданный отдельно, идёт первым
+    std::vector<const Statement*> GetArgs() const;
+    void ForEachChild(const ChildVisitor& visit) override;
+
 private:
     std::unique_ptr<Statement> argument_;
     std::vector<std::unique_ptr<Statement>> args_;
 
     void PrintArgument(std::ostream& os, const std::unique_ptr<Statement>& arg, runtime::Closure& closure, runtime::Context& context) const;
     void PrintArgs(std::ostream& os, runtime::Closure& closure, runtime::Context& context) const;
-    void PrintObj(std::ostream& os, runtime::ObjectHolder obj, runtime::Closure& closure, runtime::Context& context) const;
+    void PrintObj(std::ostream& os, const runtime::ObjectHolder& obj, runtime::Closure& closure, runtime::Context& context) const;
 };
 
 // Вызывает метод object.method со списком параметров args
 class MethodCall : public Statement {
 public:
-    MethodCall(std::unique_ptr<Statement> object, std::string method,
+    MethodCall(std::unique_ptr<Statement> object, runtime::Symbol method,
                std::vector<std::unique_ptr<Statement>> args);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    const Statement& GetObject() const {
+        return *object_;
+    }
+    runtime::Symbol GetMethodName() const {
+        return method_;
+    }
+    const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+    // Кэш вызова: позволяет проверить, что место вызова осталось мономорфным
+    const runtime::MethodCache& GetCallCache() const {
+        return call_cache_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 private:
     std::unique_ptr<Statement> object_;
-    std::string method_;
+    runtime::Symbol method_;
     std::vector<std::unique_ptr<Statement>> args_;
+    runtime::MethodCache call_cache_;
 
 };
 
@@ -138,11 +238,19 @@ class NewInstance : public Statement {
 public:
     explicit NewInstance(const runtime::Class& class_);
     NewInstance(const runtime::Class& class_, std::vector<std::unique_ptr<Statement>> args);
-    // Возвращает объект, содержащий значение типа ClassInstance
+    // Возвращает новый объект типа ClassInstance, созданный при этом выполнении
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    const runtime::Class& GetClass() const {
+        return *cls_;
+    }
+    const std::vector<std::unique_ptr<Statement>>& GetArgs() const {
+        return args_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 private:
-    runtime::ClassInstance inst_;
+    const runtime::Class* cls_;
     std::vector<std::unique_ptr<Statement>> args_;
 };
 
@@ -153,6 +261,11 @@ public:
         
     }
 
+    const Statement& GetArgument() const {
+        return *arg_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 protected:
     std::unique_ptr<Statement> arg_;
 };
@@ -162,8 +275,6 @@ class Stringify : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
-private:
-    runtime::ObjectHolder ConverResultStrToObjectHolder(runtime::ObjectHolder& result_str);
 };
 
 // Родительский класс Бинарная операция с аргументами lhs и rhs
@@ -173,6 +284,14 @@ public:
         // Реализуйте метод самостоятельно
     }
 
+    const Statement& GetLhs() const {
+        return *lhs_;
+    }
+    const Statement& GetRhs() const {
+        return *rhs_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 protected:
     std::unique_ptr<Statement> lhs_;
     std::unique_ptr<Statement> rhs_;
@@ -232,6 +351,7 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно False
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool ExecuteCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции and над lhs и rhs
@@ -241,6 +361,7 @@ public:
     // Значение аргумента rhs вычисляется, только если значение lhs
     // после приведения к Bool равно True
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool ExecuteCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Возвращает результат вычисления логической операции not над единственным аргументом операции
@@ -248,6 +369,7 @@ class Not : public UnaryOperation {
 public:
     using UnaryOperation::UnaryOperation;
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool ExecuteCondition(runtime::Closure& closure, runtime::Context& context) override;
 };
 
 // Составная инструкция (например: тело метода, содержимое ветки if, либо else)
@@ -266,6 +388,13 @@ public:
 
     // Последовательно выполняет добавленные инструкции. Возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    // Останавливается на первой инструкции, выполнившей return
+    Completion ExecuteCompletion(runtime::Closure& closure, runtime::Context& context) override;
+
+    const std::vector<std::unique_ptr<Statement>>& GetStatements() const {
+        return commands_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
 
 private:
     std::vector<std::unique_ptr<Statement>> commands_;
@@ -276,17 +405,75 @@ private:
     }
 };
 
-// Тело метода. Как правило, содержит составную инструкцию
+/*
+ * Тело метода. Как правило, содержит составную инструкцию.
+ * Тело, построенное парсером, владеет ареной своих узлов: класс с методом может пережить
+ * дерево программы. Поэтому сам MethodBody всегда размещается в куче
+ */
 class MethodBody : public Statement {
 public:
-    explicit MethodBody(std::unique_ptr<Statement>&& body);
+    explicit MethodBody(std::unique_ptr<Statement>&& body, std::shared_ptr<Arena> arena = nullptr);
+    MethodBody(const MethodBody&) = delete;
+    MethodBody& operator=(const MethodBody&) = delete;
+    ~MethodBody() override;
+
+    static void* operator new(size_t size) {
+        return ::operator new(size);
+    }
+    static void operator delete(void* ptr) noexcept {
+        ::operator delete(ptr);
+    }
 
     // Вычисляет инструкцию, переданную в качестве body.
     // Если внутри body была выполнена инструкция return, возвращает результат return
     // В противном случае возвращает None
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    const Statement& GetBody() const {
+        return *body_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
+private:
+    // Арена объявлена первой, чтобы освободиться после узлов тела
+    std::shared_ptr<Arena> arena_;
+    std::unique_ptr<Statement> body_;
+};
+
+/*
+ * Корень дерева, которое возвращает ParseProgram. Владеет ареной с узлами программы
+ * и разрушает дерево без рекурсии. Сам размещается в куче
+ */
+class Program : public Statement {
+public:
+    Program(std::unique_ptr<Statement> body, std::shared_ptr<Arena> arena);
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+    ~Program() override;
+
+    static void* operator new(size_t size) {
+        return ::operator new(size);
+    }
+    static void operator delete(void* ptr) noexcept {
+        ::operator delete(ptr);
+    }
+
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    const Statement& GetBody() const {
+        return *body_;
+    }
+
+    const Arena& GetArena() const {
+        return *arena_;
+    }
+    Arena& GetArena() {
+        return *arena_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
+
 private:
+    std::shared_ptr<Arena> arena_;
     std::unique_ptr<Statement> body_;
 };
 
@@ -296,9 +483,16 @@ public:
     explicit Return(std::unique_ptr<Statement> statement) : statement_(std::move(statement)) {
     }
 
+    // Возвращает результат вычисления выражения statement
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
     // Останавливает выполнение текущего метода. После выполнения инструкции return метод,
     // внутри которого она была исполнена, должен вернуть результат вычисления выражения statement.
-    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion ExecuteCompletion(runtime::Closure& closure, runtime::Context& context) override;
+
+    const Statement& GetStatement() const {
+        return *statement_;
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
 private:
     std::unique_ptr<Statement> statement_;
 };
@@ -313,6 +507,10 @@ public:
     // конструктор
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
 
+    const runtime::ObjectHolder& GetClass() const {
+        return cls_;
+    }
+
 private:
     runtime::ObjectHolder cls_;
 };
@@ -325,6 +523,19 @@ public:
            std::unique_ptr<Statement> else_body);
 
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    Completion ExecuteCompletion(runtime::Closure& closure, runtime::Context& context) override;
+
+    const Statement& GetCondition() const {
+        return *condition_;
+    }
+    const Statement& GetIfBody() const {
+        return *if_body_;
+    }
+    // Возвращает nullptr, если ветка else отсутствует
+    const Statement* GetElseBody() const {
+        return else_body_.get();
+    }
+    void ForEachChild(const ChildVisitor& visit) override;
 private:
     std::unique_ptr<Statement> condition_;
     std::unique_ptr<Statement> if_body_;
@@ -343,6 +554,11 @@ public:
     // Вычисляет значение выражений lhs и rhs и возвращает результат работы comparator,
     // приведённый к типу runtime::Bool
     runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+    bool ExecuteCondition(runtime::Closure& closure, runtime::Context& context) override;
+
+    const Comparator& GetComparator() const {
+        return cmp_;
+    }
 private:
     Comparator cmp_;
 };
@@ -357,16 +573,4 @@ enum class ValueType {
 
 ValueType GetValueTypeOfObjHolder(runtime::ObjectHolder& holder);
 
-struct return_except : public std::exception {
-    runtime::ObjectHolder return_info;
-
-    explicit return_except(runtime::ObjectHolder info) : return_info(info) {
-
-    }
-
-    runtime::ObjectHolder GetInfo() const {
-        return return_info;
-    }
-};
-
 }  // namespace ast
\ No newline at end of file
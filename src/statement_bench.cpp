@@ -0,0 +1,347 @@
+#include "bench_runner_p.h"
+#include "bytecode_cache.h"
+#include "compiler.h"
+#include "fold.h"
+#include "lexer.h"
+#include "mython.h"
+#include "parse.h"
+#include "statement.h"
+#include "vm.h"
+
+#include <future>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace ast {
+
+using runtime::Closure;
+using runtime::ObjectHolder;
+
+namespace {
+
+// Заполняет closure count переменными с именами prefix0, prefix1, ...
+void FillClosure(Closure& closure, const string& prefix, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        closure[prefix + to_string(i)] = ObjectHolder::Own(runtime::Number(static_cast<int>(i)));
+    }
+}
+
+// Время чтения переменной и цепочки полей не должно зависеть от числа имён в области видимости
+void BenchVariableValue(BenchRunner& br) {
+    runtime::DummyContext context;
+    runtime::Class cls("Node"s, {}, nullptr);
+
+    for (size_t scope_size : {1, 16, 256, 4096}) {
+        runtime::ClassInstance inner(cls);
+        FillClosure(inner.Fields(), "field"s, scope_size);
+        inner.Fields()["x"s] = ObjectHolder::Own(runtime::Number(1));
+
+        runtime::ClassInstance outer(cls);
+        FillClosure(outer.Fields(), "field"s, scope_size);
+        outer.Fields()["inner"s] = ObjectHolder::Share(inner);
+
+        Closure closure;
+        FillClosure(closure, "var"s, scope_size);
+        closure["self"s] = ObjectHolder::Share(outer);
+        closure["x"s] = ObjectHolder::Own(runtime::Number(2));
+
+        const string suffix = ", "s + to_string(scope_size) + " names in scope"s;
+        const size_t iterations = 200'000;
+
+        VariableValue var("x"s);
+        br.Run("x"s + suffix, iterations, [&] {
+            DoNotOptimize(var.Execute(closure, context));
+        });
+
+        VariableValue field(vector{"self"s, "inner"s});
+        br.Run("self.inner"s + suffix, iterations, [&] {
+            DoNotOptimize(field.Execute(closure, context));
+        });
+
+        VariableValue chain(vector{"self"s, "inner"s, "x"s});
+        br.Run("self.inner.x"s + suffix, iterations, [&] {
+            DoNotOptimize(chain.Execute(closure, context));
+        });
+    }
+}
+
+// Программы, время работы которых определяется вызовами методов и возвратом из них
+const string FIB_PROGRAM = R"(
+class Fib:
+  def calc(n):
+    if n < 2:
+      return n
+    return self.calc(n - 1) + self.calc(n - 2)
+
+f = Fib()
+result = f.calc(15)
+)"s;
+
+const string NESTED_RETURN_PROGRAM = R"(
+class Walker:
+  def depth(n):
+    if n > 0:
+      if n > 1:
+        return self.depth(n - 1) + 1
+      else:
+        return 1
+    return 0
+
+w = Walker()
+result = w.depth(400)
+)"s;
+
+void BenchCallHeavyPrograms(BenchRunner& br) {
+    for (const auto& [name, text] : {pair{"fib(15)"s, FIB_PROGRAM},
+                                     pair{"400 nested returns"s, NESTED_RETURN_PROGRAM}}) {
+        istringstream input(text);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        runtime::DummyContext context;
+
+        br.Run("tree walker, "s + name, 50, [&] {
+            Closure closure;
+            program->Execute(closure, context);
+            DoNotOptimize(closure);
+        });
+    }
+}
+
+// Программы, время работы которых определяется проверками типов значений
+const string COMPARISON_PROGRAM = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+  def __eq__(other):
+    return self.x == other.x
+
+  def __lt__(other):
+    return self.x < other.x
+
+class Comparer:
+  def run(n, p, q):
+    if n > 0:
+      a = 'abc' < 'abd'
+      b = n == n
+      c = True != False
+      d = n >= 3
+      e = p == q
+      f = p < q
+      g = None == None
+      if a and b or c and d or e:
+        return self.run(n - 1, p, q)
+      return self.run(n - 1, q, p)
+    return 0
+
+p = Point(1)
+q = Point(2)
+comparer = Comparer()
+result = comparer.run(300, p, q)
+)"s;
+
+const string PRINT_PROGRAM = R"(
+class Named:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return self.name
+
+class Printer:
+  def run(n, named):
+    if n > 0:
+      print n, 'value', True, None, named
+      print str(n), str(False), str(named)
+      return self.run(n - 1, named)
+    return 0
+
+printer = Printer()
+result = printer.run(300, Named('item'))
+)"s;
+
+void BenchTypeDispatchPrograms(BenchRunner& br) {
+    for (const auto& [name, text] : {pair{"comparisons"s, COMPARISON_PROGRAM},
+                                     pair{"prints"s, PRINT_PROGRAM}}) {
+        istringstream input(text);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        const bytecode::Program compiled = bytecode::Compile(*program);
+
+        ostringstream output;
+        runtime::SimpleContext context{output};
+
+        br.Run("tree walker, "s + name, 50, [&] {
+            output.str({});
+            Closure closure;
+            program->Execute(closure, context);
+            DoNotOptimize(closure);
+        });
+        br.Run("vm, "s + name, 50, [&] {
+            output.str({});
+            Closure closure;
+            vm::Run(compiled, closure, context);
+            DoNotOptimize(closure);
+        });
+    }
+}
+
+// Программа из многих методов и выражений, чтобы дерево состояло из сотен тысяч узлов
+string MakeLargeProgram(size_t class_count) {
+    string program;
+    for (size_t i = 0; i < class_count; ++i) {
+        const string index = to_string(i);
+        program += "class C"s + index + ":\n"s
+                 + "  def run(n):\n"s
+                 + "    x = n * 2 + 1 - n / 3\n"s
+                 + "    if x > 10 and not n < 3:\n"s
+                 + "      print x, 'big', n + 1\n"s
+                 + "    else:\n"s
+                 + "      x = x + self.run(n - 1)\n"s
+                 + "    return x\n\n"s
+                 + "c"s + index + " = C"s + index + "()\n"s;
+    }
+    return program;
+}
+
+// Разбор программы, обход её дерева и уничтожение дерева, узлы которого лежат в арене
+void BenchArenaTree(BenchRunner& br) {
+    const string program = MakeLargeProgram(5'000);
+    unique_ptr<Statement> tree;
+
+    const double parse_ns = br.Run("parse 5000 classes"s, 5, [&] {
+        istringstream input(program);
+        parse::Lexer lexer(input);
+        auto parsed = ParseProgram(lexer);
+        DoNotOptimize(parsed);
+    });
+    const size_t bytes = MeasureAllocatedBytes([&] {
+        istringstream input(program);
+        parse::Lexer lexer(input);
+        tree = ParseProgram(lexer);
+    });
+    const auto& arena = dynamic_cast<const Program&>(*tree).GetArena();
+    cout << "  parse+destroy "s << parse_ns / 1e6 << " ms; heap "s << bytes << " bytes, arena "s
+         << arena.GetAllocatedBytes() << " bytes in "s << arena.GetBlockCount() << " blocks"s << endl;
+
+    runtime::DummyContext context;
+    br.Run("tree walker, 5000 class definitions"s, 5, [&] {
+        Closure closure;
+        tree->Execute(closure, context);
+        DoNotOptimize(closure);
+    });
+}
+
+// Константные выражения в теле рекурсивного метода вычисляются при каждом вызове
+const string CONSTANT_PROGRAM = R"(
+class Calc:
+  def run(n, acc):
+    if n > 0:
+      seconds = 60 * 60 * 24 * 7
+      shift = -5 + 2 * (3 - 1) / 2
+      label = 'week' + ' ' + str(7)
+      return self.run(n - 1, acc + seconds / (60 * 60) + shift)
+    return acc
+
+calc = Calc()
+result = calc.run(300, 0)
+)"s;
+
+void BenchConstantFolding(BenchRunner& br) {
+    for (bool fold : {false, true}) {
+        istringstream input(CONSTANT_PROGRAM);
+        parse::Lexer lexer(input);
+        auto program = ParseProgram(lexer);
+        const string suffix = fold ? ", folded"s : ""s;
+        if (fold) {
+            const FoldStats stats = FoldConstants(program);
+            cout << "  folded "s << stats.folded << " expressions"s << endl;
+        }
+        const bytecode::Program compiled = bytecode::Compile(*program);
+        runtime::DummyContext context;
+
+        br.Run("tree walker, constant expressions"s + suffix, 50, [&] {
+            Closure closure;
+            program->Execute(closure, context);
+            DoNotOptimize(closure);
+        });
+        br.Run("vm, constant expressions"s + suffix, 50, [&] {
+            Closure closure;
+            vm::Run(compiled, closure, context);
+            DoNotOptimize(closure);
+        });
+    }
+}
+
+// Запуск программы из кэша байт-кода вместо лексического анализа, разбора и компиляции
+void BenchProgramCache(BenchRunner& br) {
+    const string program = MakeLargeProgram(5'000);
+    const bytecode::SourceStamp stamp{program.size(), 0};
+
+    const double compile_ns = br.Run("parse and compile 5000 classes"s, 5, [&] {
+        parse::Lexer lexer{string_view(program)};
+        auto tree = ParseProgram(lexer);
+        FoldConstants(tree);
+        DoNotOptimize(bytecode::Compile(*tree));
+    });
+
+    parse::Lexer lexer{string_view(program)};
+    ostringstream cache;
+    bytecode::SaveProgram(cache, bytecode::Compile(*ParseProgram(lexer)), stamp);
+    const string data = cache.str();
+
+    const double load_ns = br.Run("load 5000 classes from cache"s, 5, [&] {
+        DoNotOptimize(bytecode::LoadProgram(data, stamp));
+    });
+    const double copy_ns = br.Run("copy cache contents"s, 5, [&] {
+        string copy = data;
+        DoNotOptimize(copy);
+    });
+    cout << "  source "s << program.size() << " bytes, cache "s << data.size() << " bytes; load is "s
+         << compile_ns / load_ns << "x faster than compilation, "s << load_ns / copy_ns
+         << "x slower than copying"s << endl;
+}
+
+// Пропускная способность пула потоков, выполняющих одну скомпилированную программу.
+// Счётчики памяти бенчмарка атомарны и сами немного мешают масштабированию
+void BenchThreadPool(BenchRunner& br) {
+    const auto script = mython::Script::Compile(FIB_PROGRAM);
+    constexpr size_t RUNS = 64;
+    cout << "  hardware threads: "s << thread::hardware_concurrency() << endl;
+
+    double single_thread_ns = 0;
+    for (size_t thread_count : {1, 2, 4, 8}) {
+        mython::ThreadPool pool(thread_count);
+        const double ns = br.Run(to_string(RUNS) + " runs of fib on "s + to_string(thread_count) + " threads"s, 5, [&] {
+            vector<future<mython::RunResult>> results;
+            results.reserve(RUNS);
+            for (size_t i = 0; i < RUNS; ++i) {
+                results.push_back(pool.Submit(script));
+            }
+            for (auto& result : results) {
+                DoNotOptimize(result.get());
+            }
+        });
+        if (thread_count == 1) {
+            single_thread_ns = ns;
+        }
+        cout << "  speedup over 1 thread: "s << single_thread_ns / ns << endl;
+    }
+}
+
+}  // namespace
+
+void RunBenchmarks(BenchRunner& br) {
+    RUN_BENCH(br, ast::BenchVariableValue);
+    RUN_BENCH(br, ast::BenchCallHeavyPrograms);
+    RUN_BENCH(br, ast::BenchTypeDispatchPrograms);
+    RUN_BENCH(br, ast::BenchArenaTree);
+    RUN_BENCH(br, ast::BenchConstantFolding);
+    RUN_BENCH(br, ast::BenchProgramCache);
+    RUN_BENCH(br, ast::BenchThreadPool);
+}
+
+}  // namespace ast
@@ -79,6 +79,29 @@ void TestVariable() {
     ASSERT(context.output.str().empty());
 }
 
+void TestDottedVariable() {
+    runtime::DummyContext context;
+
+    runtime::Class cls("Node"s, {}, nullptr);
+    runtime::ClassInstance inner(cls);
+    runtime::ClassInstance outer(cls);
+    runtime::Number num(42);
+    inner.Fields()["value"s] = ObjectHolder::Share(num);
+    outer.Fields()["inner"s] = ObjectHolder::Share(inner);
+
+    Closure closure = {{"self"s, ObjectHolder::Share(outer)}};
+    ASSERT(VariableValue(vector{"self"s, "inner"s}).Execute(closure, context).Get() == &inner);
+    ASSERT(VariableValue(vector{"self"s, "inner"s, "value"s}).Execute(closure, context).Get()
+           == &num);
+    ASSERT_THROWS(VariableValue(vector{"self"s, "missing"s}).Execute(closure, context),
+                  std::runtime_error);
+    // Поиск не должен изменять поля объектов
+    ASSERT_EQUAL(outer.Fields().size(), 1U);
+    ASSERT_EQUAL(inner.Fields().size(), 1U);
+
+    ASSERT(context.output.str().empty());
+}
+
 void TestAssignment() {
     runtime::DummyContext context;
 
@@ -138,8 +161,10 @@ void TestFieldAssignment() {
 
     ASSERT(object.Fields().find("y"s) != object.Fields().end());
     const auto* subobject = object.Fields().at("y"s).TryAs<runtime::ClassInstance>();
-    ASSERT(subobject != nullptr && subobject->Fields().find("z"s) != subobject->Fields().end());
-    ASSERT_OBJECT_VALUE_EQUAL(subobject->Fields().at("z"s), "Hello, world! Hooray! Yes-yes!!!"s);
+    ASSERT(subobject != nullptr);
+    const Closure subobject_fields = subobject->Fields();
+    ASSERT(subobject_fields.find("z"s) != subobject_fields.end());
+    ASSERT_OBJECT_VALUE_EQUAL(subobject_fields.at("z"s), "Hello, world! Hooray! Yes-yes!!!"s);
 
     ASSERT(context.output.str().empty());
 }
@@ -170,6 +195,11 @@ void TestPrintMultipleStatements() {
     Print(std::move(args)).Execute(closure, context);
 
     ASSERT_EQUAL(context.output.str(), "hello 57 Python None\n"s);
+
+    // Выводимые строки ищутся среди имён переменных, но не интернируются
+    const size_t symbol_count = runtime::GetInternedSymbolCount();
+    Print(make_unique<StringConst>("a string printed only once"s)).Execute(closure, context);
+    ASSERT_EQUAL(runtime::GetInternedSymbolCount(), symbol_count);
 }
 
 void TestStringify() {
@@ -344,6 +374,42 @@ void TestFields() {
     ASSERT(context.output.str().empty());
 }
 
+void TestNewInstance() {
+    runtime::DummyContext context;
+
+    vector<runtime::Method> methods;
+    methods.push_back({"__init__"s,
+                       {"value"s},
+                       {make_unique<FieldAssignment>(VariableValue{"self"s}, "value"s,
+                                                     make_unique<VariableValue>("value"s))}});
+    runtime::Class cls("BoxedValue"s, std::move(methods), nullptr);
+
+    vector<unique_ptr<Statement>> args;
+    args.push_back(make_unique<VariableValue>("x"s));
+    NewInstance new_instance(cls, std::move(args));
+
+    // Каждое выполнение создаёт отдельный объект со своими полями
+    Closure closure{{"x"s, ObjectHolder::Own(runtime::Number(1))}};
+    ObjectHolder first = new_instance.Execute(closure, context);
+    closure["x"s] = ObjectHolder::Own(runtime::Number(2));
+    ObjectHolder second = new_instance.Execute(closure, context);
+
+    ASSERT(first.Get() != second.Get());
+    ASSERT_OBJECT_VALUE_EQUAL(*first.TryAs<runtime::ClassInstance>()->FindField("value"s), 1);
+    ASSERT_OBJECT_VALUE_EQUAL(*second.TryAs<runtime::ClassInstance>()->FindField("value"s), 2);
+
+    // Объект переживает узел, который его создал
+    ObjectHolder survivor;
+    {
+        NewInstance temporary(cls);
+        survivor = temporary.Execute(closure, context);
+    }
+    ASSERT(survivor.TryAs<runtime::ClassInstance>());
+    ASSERT_EQUAL(&survivor.TryAs<runtime::ClassInstance>()->GetClass(), &cls);
+
+    ASSERT(context.output.str().empty());
+}
+
 void TestBaseClass() {
     vector<runtime::Method> methods;
     methods.push_back({"GetValue"s, {}, make_unique<VariableValue>(vector{"self"s, "value"s})});
@@ -437,6 +503,44 @@ void TestAnd() {
     test_and(true, false);
     test_and(false, true);
     test_and(false, false);
+
+    // Правый операнд не вычисляется, если левый ложен
+    Closure closure;
+    runtime::DummyContext context;
+    And short_circuit{make_unique<BoolConst>(false), make_unique<Print>(make_unique<StringConst>("rhs"s))};
+    ASSERT(!runtime::IsTrue(short_circuit.Execute(closure, context)));
+    ASSERT(!short_circuit.ExecuteCondition(closure, context));
+    ASSERT(context.output.str().empty());
+}
+
+void TestConditions() {
+    runtime::DummyContext context;
+    Closure closure{{"a"s, ObjectHolder::Own(runtime::Number(1))},
+                    {"b"s, ObjectHolder::Own(runtime::Number(2))},
+                    {"c"s, ObjectHolder::Own(runtime::String("c"s))}};
+
+    // a < b and c, not (a < b and not c) or b < a
+    auto less = [](const string& lhs, const string& rhs) {
+        return make_unique<Comparison>(runtime::Less, make_unique<VariableValue>(lhs),
+                                       make_unique<VariableValue>(rhs));
+    };
+    And first(less("a"s, "b"s), make_unique<VariableValue>("c"s));
+    ASSERT(first.ExecuteCondition(closure, context));
+    Or second(make_unique<Not>(make_unique<And>(less("a"s, "b"s),
+                                                make_unique<Not>(make_unique<VariableValue>("c"s)))),
+              less("b"s, "a"s));
+    ASSERT(second.ExecuteCondition(closure, context));
+    ASSERT(!Not(less("a"s, "b"s)).ExecuteCondition(closure, context));
+
+    // Условие остальных инструкций - логическое значение их результата
+    ASSERT(VariableValue("c"s).ExecuteCondition(closure, context));
+    ASSERT(!None().ExecuteCondition(closure, context));
+
+    IfElse if_else(make_unique<And>(less("a"s, "b"s), make_unique<VariableValue>("c"s)),
+                   make_unique<Print>(make_unique<StringConst>("then"s)),
+                   make_unique<Print>(make_unique<StringConst>("else"s)));
+    if_else.Execute(closure, context);
+    ASSERT_EQUAL(context.output.str(), "then\n"s);
 }
 
 void TestNot() {
@@ -453,12 +557,48 @@ void TestNot() {
     test_not(false);
 }
 
+void TestReturn() {
+    runtime::DummyContext context;
+
+    // if flag: return 'then' / x = 1 / return 'end' / x = 2
+    auto make_body = [] {
+        auto if_body = make_unique<Compound>(make_unique<Return>(make_unique<StringConst>("then"s)));
+        return make_unique<MethodBody>(make_unique<Compound>(
+            make_unique<IfElse>(make_unique<VariableValue>("flag"s), move(if_body), nullptr),
+            make_unique<Assignment>("x"s, make_unique<NumericConst>(1)),
+            make_unique<Return>(make_unique<StringConst>("end"s)),
+            make_unique<Assignment>("x"s, make_unique<NumericConst>(2))));
+    };
+
+    auto body = make_body();
+    Closure closure = {{"flag"s, ObjectHolder::Own(runtime::Bool(true))}};
+    ASSERT_OBJECT_VALUE_EQUAL(body->Execute(closure, context), "then"s);
+    ASSERT_EQUAL(closure.count("x"s), 0U);
+
+    closure["flag"s] = ObjectHolder::Own(runtime::Bool(false));
+    ASSERT_OBJECT_VALUE_EQUAL(body->Execute(closure, context), "end"s);
+    ASSERT_OBJECT_VALUE_EQUAL(closure.at("x"s), 1);
+
+    // Return сообщает о выполнении через Completion, не выбрасывая исключений
+    Return ret(make_unique<NumericConst>(42));
+    Completion completion = ret.ExecuteCompletion(closure, context);
+    ASSERT(completion.is_return);
+    ASSERT_OBJECT_VALUE_EQUAL(completion.value, 42);
+
+    // Тело без return возвращает None
+    MethodBody empty(make_unique<Compound>());
+    ASSERT(!empty.Execute(closure, context));
+
+    ASSERT(context.output.str().empty());
+}
+
 }  // namespace
 
 void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestNumericConst);
     RUN_TEST(tr, ast::TestStringConst);
     RUN_TEST(tr, ast::TestVariable);
+    RUN_TEST(tr, ast::TestDottedVariable);
     RUN_TEST(tr, ast::TestAssignment);
     RUN_TEST(tr, ast::TestFieldAssignment);
     RUN_TEST(tr, ast::TestPrintVariable);
@@ -470,11 +610,14 @@ void RunUnitTests(TestRunner& tr) {
     RUN_TEST(tr, ast::TestSuccessfulClassInstanceAdd);
     RUN_TEST(tr, ast::TestClassInstanceAddWithoutMethod);
     RUN_TEST(tr, ast::TestCompound);
+    RUN_TEST(tr, ast::TestReturn);
     RUN_TEST(tr, ast::TestFields);
+    RUN_TEST(tr, ast::TestNewInstance);
     RUN_TEST(tr, ast::TestBaseClass);
     RUN_TEST(tr, ast::TestInheritance);
     RUN_TEST(tr, ast::TestOr);
     RUN_TEST(tr, ast::TestAnd);
+    RUN_TEST(tr, ast::TestConditions);
     RUN_TEST(tr, ast::TestNot);
 }
 
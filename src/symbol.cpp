@@ -0,0 +1,86 @@
+#include "symbol.h"
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+using namespace std;
+
+namespace runtime {
+
+    namespace {
+
+        class SymbolTable {
+        public:
+            const std::string* Intern(std::string_view name) {
+                std::lock_guard guard(mutex_);
+                if (auto it = index_.find(name); it != index_.end()) {
+                    return it->second;
+                }
+                // deque не перемещает элементы при добавлении, так что адреса имён постоянны
+                const std::string& stored = names_.emplace_back(name);
+                index_.emplace(stored, &stored);
+                return &stored;
+            }
+
+            const std::string* Find(std::string_view name) {
+                std::lock_guard guard(mutex_);
+                auto it = index_.find(name);
+                return it == index_.end() ? nullptr : it->second;
+            }
+
+            size_t GetSize() {
+                std::lock_guard guard(mutex_);
+                return names_.size();
+            }
+
+        private:
+            std::mutex mutex_;
+            std::deque<std::string> names_;
+            // Ключи ссылаются на строки из names_
+            std::unordered_map<std::string_view, const std::string*> index_;
+        };
+
+        // Таблица создаётся при первом обращении, поэтому символы можно заводить
+        // в глобальных константах любой единицы трансляции
+        SymbolTable& GetSymbolTable() {
+            static SymbolTable table;
+            return table;
+        }
+
+    }  // namespace
+
+    Symbol::Symbol() {
+        static const std::string* const empty = GetSymbolTable().Intern({});
+        name_ = empty;
+    }
+
+    Symbol::Symbol(std::string_view name)
+        : name_(GetSymbolTable().Intern(name)) {
+    }
+
+    Symbol::Symbol(const std::string& name)
+        : Symbol(std::string_view(name)) {
+    }
+
+    Symbol::Symbol(const char* name)
+        : Symbol(std::string_view(name)) {
+    }
+
+    std::optional<Symbol> Symbol::TryFind(std::string_view name) {
+        if (const std::string* stored = GetSymbolTable().Find(name)) {
+            return Symbol(stored);
+        }
+        return std::nullopt;
+    }
+
+    std::ostream& operator<<(std::ostream& os, Symbol symbol) {
+        return os << symbol.GetName();
+    }
+
+    size_t GetInternedSymbolCount() {
+        return GetSymbolTable().GetSize();
+    }
+
+}  // namespace runtime
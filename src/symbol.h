@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace runtime {
+
+    /*
+     * Интернированное имя: идентификатор переменной, имя поля или метода.
+     * Каждое различное имя хранится в глобальной таблице ровно один раз, а символ ссылается на эту
+     * запись, поэтому символы сравниваются и хешируются по указателю, не читая саму строку.
+     * Записи таблицы живут до завершения программы.
+     *
+     * Символ неявно создаётся из строки, чтобы код со строковыми именами оставался прежним,
+     * но такое создание ищет имя в таблице под блокировкой. Поэтому имена, с которыми
+     * программа работает часто, интернируются заранее: при разборе программы и при компиляции
+     */
+    class Symbol {
+    public:
+        // Пустое имя
+        Symbol();
+        Symbol(std::string_view name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const std::string& name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+        Symbol(const char* name);  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+
+        // Возвращает символ для уже интернированного имени, не добавляя в таблицу новых.
+        // Подходит для поиска по строкам, полученным при выполнении программы
+        [[nodiscard]] static std::optional<Symbol> TryFind(std::string_view name);
+
+        [[nodiscard]] const std::string& GetName() const {
+            return *name_;
+        }
+
+        operator const std::string&() const {  // NOLINT(google-explicit-constructor,hicpp-explicit-conversions)
+            return *name_;
+        }
+
+        [[nodiscard]] bool operator==(Symbol other) const {
+            return name_ == other.name_;
+        }
+
+        [[nodiscard]] bool operator!=(Symbol other) const {
+            return name_ != other.name_;
+        }
+
+    private:
+        friend struct std::hash<Symbol>;
+
+        explicit Symbol(const std::string* name)
+            : name_(name) {
+        }
+
+        const std::string* name_;
+    };
+
+    std::ostream& operator<<(std::ostream& os, Symbol symbol);
+
+    // Возвращает число различных имён в таблице интернирования
+    size_t GetInternedSymbolCount();
+
+}  // namespace runtime
+
+namespace std {
+
+    template <>
+    struct hash<runtime::Symbol> {
+        size_t operator()(runtime::Symbol symbol) const noexcept {
+            // Младшие биты адреса у выровненных строк нулевые, их отбрасываем
+            return reinterpret_cast<size_t>(symbol.name_) >> 4;
+        }
+    };
+
+}  // namespace std
@@ -0,0 +1,501 @@
+#include "vm.h"
+
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace vm {
+
+using bytecode::Code;
+using bytecode::Instruction;
+using bytecode::OpCode;
+using runtime::Closure;
+using runtime::Context;
+using runtime::ObjectHolder;
+
+namespace {
+const runtime::Symbol INIT_METHOD{"__init__"sv};
+
+// Значение слота локальной переменной, которой ещё ничего не присвоено
+class UnboundValue : public runtime::Object {
+public:
+    void Print(std::ostream& /*os*/, Context& /*context*/) override {
+    }
+};
+
+UnboundValue unbound_value;
+const ObjectHolder UNBOUND = ObjectHolder::Share(unbound_value);
+
+// Состояние выполнения, начатого vm::Run в этом потоке. Методы вызываются через
+// runtime::Executable, поэтому состояние не передаётся им явно
+thread_local ExecutionState* current_state = nullptr;
+
+// Делает state текущим состоянием выполнения потока до конца области видимости
+class StateScope {
+public:
+    explicit StateScope(ExecutionState& state)
+        : previous_(current_state) {
+        current_state = &state;
+    }
+
+    StateScope(const StateScope&) = delete;
+    StateScope& operator=(const StateScope&) = delete;
+
+    ~StateScope() {
+        current_state = previous_;
+    }
+
+private:
+    ExecutionState* previous_;
+};
+
+void ResizeCaches(const Code& code, CodeCaches& caches) {
+    caches.field_caches.resize(code.field_cache_count);
+    caches.method_caches.resize(code.method_cache_count);
+}
+
+// Кадр вызова: слоты локальных переменных, за которыми следует стек операндов
+class Frame {
+public:
+    explicit Frame(const Code& code)
+        : slots_(code.locals.size() + code.max_stack) {
+        for (uint32_t slot : code.checked_locals) {
+            slots_[slot] = UNBOUND;
+        }
+    }
+
+    ObjectHolder* Locals() {
+        return slots_.data();
+    }
+
+private:
+    vector<ObjectHolder> slots_;
+};
+
+void PrintValue(ostream& os, const ObjectHolder& value, Context& context) {
+    if (value) {
+        value->Print(os, context);
+    } else {
+        os << "None"sv;
+    }
+}
+
+// Выводит аргумент print так же, как ast::Print: строка, совпадающая с именем присвоенной
+// локальной переменной, выводится как значение этой переменной
+void PrintArgument(ostream& os, const Code& code, const ObjectHolder* locals, const ObjectHolder& value,
+                   Context& context) {
+    const ObjectHolder* printed = &value;
+    while (const auto* str = printed->TryAs<runtime::String>()) {
+        const string& name = str->GetValue();
+        const ObjectHolder* variable = nullptr;
+        for (size_t slot = 0; slot < code.locals.size(); ++slot) {
+            if (code.locals[slot].GetName() == name && locals[slot].Get() != &unbound_value) {
+                variable = &locals[slot];
+                break;
+            }
+        }
+        if (variable == nullptr) {
+            break;
+        }
+        printed = variable;
+    }
+    PrintValue(os, *printed, context);
+}
+
+ObjectHolder Run(const Code& code, Frame& frame, Context& context);
+
+// Сравнивает lhs и rhs операцией сравнения op (от OpCode::Equal до OpCode::GreaterOrEqual)
+bool Compare(OpCode op, const ObjectHolder& lhs, const ObjectHolder& rhs, Context& context) {
+    switch (op) {
+        case OpCode::Equal:
+            return runtime::Equal(lhs, rhs, context);
+        case OpCode::NotEqual:
+            return runtime::NotEqual(lhs, rhs, context);
+        case OpCode::Less:
+            return runtime::Less(lhs, rhs, context);
+        case OpCode::Greater:
+            return runtime::Greater(lhs, rhs, context);
+        case OpCode::LessOrEqual:
+            return runtime::LessOrEqual(lhs, rhs, context);
+        default:
+            return runtime::GreaterOrEqual(lhs, rhs, context);
+    }
+}
+
+// Вызывает у объекта self метод method, принимающий arg_count параметров.
+// Скомпилированные методы вызываются напрямую, остальные - через ClassInstance::Call
+ObjectHolder InvokeMethod(const ObjectHolder& self, const runtime::Method& method,
+                          ObjectHolder* args, size_t arg_count, Context& context) {
+    if (const auto* function = dynamic_cast<const Function*>(method.body.get())) {
+        return function->Call(self, args, context);
+    }
+    vector<ObjectHolder> actual_args(args, args + arg_count);
+    return static_cast<runtime::ClassInstance&>(*self).Call(method, actual_args, context);
+}
+
+// Вызывает метод name у объекта self, находя его через кэш места вызова.
+// Если подходящего метода нет, выбрасывает runtime_error
+ObjectHolder CallMethod(const ObjectHolder& self, runtime::MethodCache& cache, runtime::Symbol name,
+                        ObjectHolder* args, size_t arg_count, Context& context) {
+    auto& instance = static_cast<runtime::ClassInstance&>(*self);
+    const runtime::Method* method = cache.Find(instance.GetClass(), name);
+    if (method == nullptr || method->formal_params.size() != arg_count) {
+        throw std::runtime_error("Incorrect call"s);
+    }
+    return InvokeMethod(self, *method, args, arg_count, context);
+}
+
+ObjectHolder Run(const Code& code, Frame& frame, Context& context) {
+    // Код, выполняемый вне vm::Run либо не принадлежащий программе текущего выполнения,
+    // получает кэши на время вызова
+    CodeCaches* caches = current_state == nullptr ? nullptr : current_state->FindCaches(code);
+    CodeCaches local_caches;
+    if (caches == nullptr) {
+        ResizeCaches(code, local_caches);
+        caches = &local_caches;
+    }
+    runtime::FieldCache* const field_caches = caches->field_caches.data();
+    runtime::MethodCache* const method_caches = caches->method_caches.data();
+
+    ObjectHolder* const locals = frame.Locals();
+    // Указывает на первую свободную ячейку стека операндов
+    ObjectHolder* sp = locals + code.locals.size();
+    const Instruction* const begin = code.instructions.data();
+    const Instruction* ip = begin;
+
+    for (;;) {
+        const Instruction& instr = *ip++;
+
+        switch (instr.op) {
+            case OpCode::LoadConst:
+                *sp++ = code.constants[instr.arg].Borrow();
+                break;
+
+            case OpCode::LoadNone:
+                *sp++ = ObjectHolder::None();
+                break;
+
+            case OpCode::LoadLocal:
+                *sp++ = locals[instr.arg];
+                break;
+
+            case OpCode::LoadLocalChecked: {
+                const ObjectHolder& value = locals[instr.arg];
+                if (value.Get() == &unbound_value) {
+                    throw std::runtime_error("Unable to evaluate a variable with the given name"s);
+                }
+                *sp++ = value;
+                break;
+            }
+
+            case OpCode::StoreLocal:
+                locals[instr.arg] = std::move(*--sp);
+                break;
+
+            case OpCode::LoadField: {
+                // Как и VariableValue, поле значения, не являющегося объектом, - само значение
+                ObjectHolder& top = sp[-1];
+                if (auto* instance = top.TryAs<runtime::ClassInstance>()) {
+                    runtime::FieldCache& cache = field_caches[instr.cache];
+                    const ObjectHolder* field = cache.Load(*instance, code.names[instr.arg]);
+                    if (field == nullptr) {
+                        throw std::runtime_error("Unable to evaluate a variable with the given name"s);
+                    }
+                    top = *field;
+                }
+                break;
+            }
+
+            case OpCode::StoreField: {
+                ObjectHolder object = std::move(*--sp);
+                ObjectHolder value = std::move(*--sp);
+                auto* instance = object.TryAs<runtime::ClassInstance>();
+                if (!instance) {
+                    throw std::runtime_error("Can't assign a field of non-object value"s);
+                }
+                runtime::FieldCache& cache = field_caches[instr.cache];
+                cache.Store(*instance, code.names[instr.arg], std::move(value));
+                break;
+            }
+
+#define MYTHON_VM_BINARY_OP(op, expr)              \
+            case OpCode::op: {                     \
+                ObjectHolder rhs = std::move(*--sp); \
+                ObjectHolder& lhs = sp[-1];        \
+                lhs = (expr);                      \
+                break;                             \
+            }
+
+            MYTHON_VM_BINARY_OP(Add, runtime::Add(lhs, rhs, context))
+            MYTHON_VM_BINARY_OP(Sub, runtime::Sub(lhs, rhs))
+            MYTHON_VM_BINARY_OP(Mult, runtime::Mult(lhs, rhs))
+            MYTHON_VM_BINARY_OP(Div, runtime::Div(lhs, rhs))
+            MYTHON_VM_BINARY_OP(Equal, ObjectHolder::Own(runtime::Bool(runtime::Equal(lhs, rhs, context))))
+            MYTHON_VM_BINARY_OP(NotEqual, ObjectHolder::Own(runtime::Bool(runtime::NotEqual(lhs, rhs, context))))
+            MYTHON_VM_BINARY_OP(Less, ObjectHolder::Own(runtime::Bool(runtime::Less(lhs, rhs, context))))
+            MYTHON_VM_BINARY_OP(Greater, ObjectHolder::Own(runtime::Bool(runtime::Greater(lhs, rhs, context))))
+            MYTHON_VM_BINARY_OP(LessOrEqual, ObjectHolder::Own(runtime::Bool(runtime::LessOrEqual(lhs, rhs, context))))
+            MYTHON_VM_BINARY_OP(GreaterOrEqual, ObjectHolder::Own(runtime::Bool(runtime::GreaterOrEqual(lhs, rhs, context))))
+
+#undef MYTHON_VM_BINARY_OP
+
+            case OpCode::Not:
+                sp[-1] = ObjectHolder::Own(runtime::Bool(!runtime::IsTrue(sp[-1])));
+                break;
+
+            case OpCode::ToBool:
+                sp[-1] = ObjectHolder::Own(runtime::Bool(runtime::IsTrue(sp[-1])));
+                break;
+
+            case OpCode::Jump:
+                ip = begin + instr.arg;
+                break;
+
+            case OpCode::JumpIfFalse:
+                if (!runtime::IsTrue(*--sp)) {
+                    ip = begin + instr.arg;
+                }
+                *sp = {};
+                break;
+
+            case OpCode::JumpIfTrue:
+                if (runtime::IsTrue(*--sp)) {
+                    ip = begin + instr.arg;
+                }
+                *sp = {};
+                break;
+
+            case OpCode::JumpIfTrueOrPop:
+                if (runtime::IsTrue(sp[-1])) {
+                    ip = begin + instr.arg;
+                } else {
+                    *--sp = {};
+                }
+                break;
+
+            case OpCode::JumpIfFalseOrPop:
+                if (!runtime::IsTrue(sp[-1])) {
+                    ip = begin + instr.arg;
+                } else {
+                    *--sp = {};
+                }
+                break;
+
+            case OpCode::CompareJumpIfFalse:
+            case OpCode::CompareJumpIfTrue: {
+                sp -= 2;
+                const bool result = Compare(static_cast<OpCode>(instr.count), sp[0], sp[1], context);
+                sp[0] = {};
+                sp[1] = {};
+                if (result == (instr.op == OpCode::CompareJumpIfTrue)) {
+                    ip = begin + instr.arg;
+                }
+                break;
+            }
+
+            case OpCode::Pop:
+                *--sp = {};
+                break;
+
+            case OpCode::Print: {
+                ostream& os = context.GetOutputStream();
+                PrintArgument(os, code, locals, *--sp, context);
+                *sp = {};
+                if (instr.count != 0) {
+                    os << ' ';
+                }
+                break;
+            }
+
+            case OpCode::PrintNewline:
+                context.GetOutputStream() << '\n';
+                break;
+
+            case OpCode::CallMethod: {
+                ObjectHolder* args = sp - instr.count;
+                ObjectHolder& object = args[-1];
+                ObjectHolder result;
+                // Как и ast::MethodCall, вызов отсутствующего метода возвращает None
+                if (object.TryAs<runtime::ClassInstance>()) {
+                    try {
+                        result = CallMethod(object, method_caches[instr.cache],
+                                            code.names[instr.arg], args, instr.count, context);
+                    }
+                    catch (...) {
+
+                    }
+                }
+                for (ObjectHolder* arg = args; arg != sp; ++arg) {
+                    *arg = {};
+                }
+                sp = args;
+                object = std::move(result);
+                break;
+            }
+
+            case OpCode::NewInstance: {
+                const auto& cls = static_cast<const runtime::Class&>(*code.constants[instr.arg]);
+                ObjectHolder* args = sp - instr.count;
+                ObjectHolder instance = ObjectHolder::Own(runtime::ClassInstance(cls));
+                const runtime::Method* init = method_caches[instr.cache].Find(cls, INIT_METHOD);
+                if (init != nullptr && init->formal_params.size() == instr.count) {
+                    InvokeMethod(instance, *init, args, instr.count, context);
+                }
+                for (ObjectHolder* arg = args; arg != sp; ++arg) {
+                    *arg = {};
+                }
+                sp = args;
+                *sp++ = std::move(instance);
+                break;
+            }
+
+            case OpCode::Stringify:
+                sp[-1] = runtime::Stringify(sp[-1]);
+                break;
+
+            case OpCode::Return:
+                return std::move(*--sp);
+        }
+    }
+}
+
+// Заполняет слоты кадра значениями одноимённых переменных из closure
+void LoadLocals(const Code& code, const Closure& closure, Frame& frame) {
+    ObjectHolder* locals = frame.Locals();
+    for (size_t slot = 0; slot < code.locals.size(); ++slot) {
+        if (auto it = closure.find(code.locals[slot]); it != closure.end()) {
+            locals[slot] = it->second;
+        }
+    }
+}
+
+}  // namespace
+
+ObjectHolder Execute(const Code& code, Closure& closure, Context& context) {
+    Frame frame(code);
+    ObjectHolder* locals = frame.Locals();
+    // Переменные, не найденные в closure, не должны попасть в неё после выполнения
+    for (size_t slot = 0; slot < code.locals.size(); ++slot) {
+        locals[slot] = UNBOUND;
+    }
+    LoadLocals(code, closure, frame);
+
+    ObjectHolder result = Run(code, frame, context);
+
+    for (size_t slot = 0; slot < code.locals.size(); ++slot) {
+        if (locals[slot].Get() != &unbound_value) {
+            closure[code.locals[slot]] = std::move(locals[slot]);
+        }
+    }
+    return result;
+}
+
+ExecutionState::ExecutionState(const bytecode::Program& program)
+    : caches_(program.code_count) {
+}
+
+CodeCaches* ExecutionState::FindCaches(const Code& code) {
+    if (code.id >= caches_.size()) {
+        return nullptr;
+    }
+    CodeCaches& caches = caches_[code.id];
+    if (caches.code == nullptr) {
+        caches.code = &code;
+        ResizeCaches(code, caches);
+    }
+    // Код другой программы может иметь тот же номер
+    return caches.code == &code ? &caches : nullptr;
+}
+
+const CodeCaches* ExecutionState::FindCaches(const Code& code) const {
+    if (code.id >= caches_.size()) {
+        return nullptr;
+    }
+    const CodeCaches& caches = caches_[code.id];
+    return caches.code == &code ? &caches : nullptr;
+}
+
+void Run(const bytecode::Program& program, Closure& closure, Context& context) {
+    ExecutionState state(program);
+    Run(program, closure, context, state);
+}
+
+void Run(const bytecode::Program& program, Closure& closure, Context& context, ExecutionState& state) {
+    StateScope scope(state);
+    Execute(program.main, closure, context);
+}
+
+namespace {
+
+void PrintCodeCallSiteStats(ostream& os, const string& code_name, const Code& code,
+                            const ExecutionState& state) {
+    const CodeCaches* caches = state.FindCaches(code);
+    const runtime::MethodCache not_executed;
+    for (size_t i = 0; i < code.instructions.size(); ++i) {
+        const Instruction& instr = code.instructions[i];
+        if (instr.op != OpCode::CallMethod && instr.op != OpCode::NewInstance) {
+            continue;
+        }
+        const runtime::MethodCache& cache = caches == nullptr ? not_executed : caches->method_caches[instr.cache];
+        const runtime::CallCacheStats& stats = cache.GetStats();
+
+        os << code_name << ':' << i << ' ';
+        if (instr.op == OpCode::CallMethod) {
+            os << code.names[instr.arg];
+        } else {
+            os << static_cast<const runtime::Class&>(*code.constants[instr.arg]).GetName() << "()"sv;
+        }
+        os << ": "sv;
+        if (cache.IsMegamorphic()) {
+            os << "megamorphic"sv;
+        } else if (cache.GetEntryCount() > 1) {
+            os << "polymorphic("sv << cache.GetEntryCount() << ')';
+        } else if (cache.GetEntryCount() == 1) {
+            os << "monomorphic"sv;
+        } else {
+            os << "not executed"sv;
+        }
+        os << ", hits "sv << stats.monomorphic_hits << ", polymorphic hits "sv
+           << stats.polymorphic_hits << ", misses "sv << stats.misses << '\n';
+    }
+}
+
+}  // namespace
+
+void PrintCallSiteStats(ostream& os, const bytecode::Program& program, const ExecutionState& state) {
+    PrintCodeCallSiteStats(os, "<main>"s, program.main, state);
+    for (const ObjectHolder& holder : program.classes) {
+        const auto& cls = static_cast<const runtime::Class&>(*holder);
+        for (const runtime::Method& method : cls.GetMethods()) {
+            if (const auto* function = dynamic_cast<const Function*>(method.body.get())) {
+                PrintCodeCallSiteStats(os, cls.GetName() + '.' + method.name.GetName(), function->GetCode(),
+                                       state);
+            }
+        }
+    }
+}
+
+Function::Function(bytecode::Code code)
+    : code_(std::move(code)) {
+}
+
+ObjectHolder Function::Execute(Closure& closure, Context& context) {
+    Frame frame(code_);
+    LoadLocals(code_, closure, frame);
+    return Run(code_, frame, context);
+}
+
+ObjectHolder Function::Call(const ObjectHolder& self, ObjectHolder* args,
+                            Context& context) const {
+    Frame frame(code_);
+    ObjectHolder* locals = frame.Locals();
+    for (size_t i = 0; i < code_.param_slots.size(); ++i) {
+        locals[code_.param_slots[i]] = std::move(args[i]);
+    }
+    // Как и в ClassInstance::Call, self перекрывает одноимённый параметр
+    locals[0] = self;
+    return Run(code_, frame, context);
+}
+
+}  // namespace vm
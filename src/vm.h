@@ -0,0 +1,79 @@
+#pragma once
+
+#include "bytecode.h"
+#include "runtime.h"
+
+#include <iosfwd>
+#include <vector>
+
+namespace vm {
+
+// Кэши мест обращения к полям и вызова методов одного фрагмента кода
+struct CodeCaches {
+    // Код, для которого созданы кэши, либо nullptr, пока код не выполнялся
+    const bytecode::Code* code = nullptr;
+    std::vector<runtime::FieldCache> field_caches;
+    std::vector<runtime::MethodCache> method_caches;
+};
+
+/*
+ * Изменяемое состояние одного выполнения программы: кэши мест вызова её кода.
+ * Сама программа при выполнении не изменяется, поэтому одну программу можно выполнять
+ * одновременно в нескольких потоках, если у каждого выполнения свои ExecutionState,
+ * Closure и Context
+ */
+class ExecutionState {
+public:
+    explicit ExecutionState(const bytecode::Program& program);
+
+    // Возвращает кэши кода code, создавая их при первом обращении.
+    // Возвращает nullptr, если code не принадлежит программе
+    CodeCaches* FindCaches(const bytecode::Code& code);
+    // Возвращает кэши кода code либо nullptr, если код ещё не выполнялся
+    const CodeCaches* FindCaches(const bytecode::Code& code) const;
+
+private:
+    std::vector<CodeCaches> caches_;
+};
+
+// Выполняет code на виртуальной машине.
+// Локальные переменные кода размещаются в слотах кадра: перед выполнением они заполняются
+// значениями одноимённых переменных из closure, после выполнения записываются обратно.
+// Вне vm::Run кэши мест вызова создаются на время выполнения кода.
+// Возвращает значение, переданное инструкции Return
+runtime::ObjectHolder Execute(const bytecode::Code& code, runtime::Closure& closure,
+                              runtime::Context& context);
+
+// Выполняет программу верхнего уровня, объявляя классы и переменные в closure
+void Run(const bytecode::Program& program, runtime::Closure& closure, runtime::Context& context);
+// То же, но кэши мест вызова хранятся в state и остаются после выполнения.
+// state должен быть создан для program и не может одновременно использоваться другим выполнением
+void Run(const bytecode::Program& program, runtime::Closure& closure, runtime::Context& context,
+         ExecutionState& state);
+
+// Выводит в os состояние кэшей всех мест вызова методов и создания объектов программы
+// после выполнения с состоянием state: число запомненных классов, попадания и промахи
+void PrintCallSiteStats(std::ostream& os, const bytecode::Program& program, const ExecutionState& state);
+
+// Тело метода, скомпилированное в байт-код.
+// Позволяет вызывать скомпилированные методы через runtime::ClassInstance::Call
+class Function final : public runtime::Executable {
+public:
+    explicit Function(bytecode::Code code);
+
+    // Берёт self и параметры метода из closure
+    runtime::ObjectHolder Execute(runtime::Closure& closure, runtime::Context& context) override;
+
+    // Вызывает метод, минуя Closure: self и аргументы сразу помещаются в слоты кадра
+    runtime::ObjectHolder Call(const runtime::ObjectHolder& self, runtime::ObjectHolder* args,
+                               runtime::Context& context) const;
+
+    const bytecode::Code& GetCode() const {
+        return code_;
+    }
+
+private:
+    bytecode::Code code_;
+};
+
+}  // namespace vm
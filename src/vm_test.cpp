@@ -0,0 +1,729 @@
+#include "bytecode_cache.h"
+#include "compiler.h"
+#include "lexer.h"
+#include "mython.h"
+#include "parse.h"
+#include "pool.h"
+#include "test_runner_p.h"
+#include "vm.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace std;
+
+namespace vm {
+
+namespace {
+
+// Выполняет программу обходом дерева и возвращает её вывод
+string RunOnTree(const string& program) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto tree = ParseProgram(lexer);
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    tree->Execute(closure, context);
+    return context.output.str();
+}
+
+// Компилирует программу в байт-код, выполняет её на виртуальной машине и возвращает вывод
+string RunOnVm(const string& program) {
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto compiled = bytecode::Compile(*ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    Run(compiled, closure, context);
+    return context.output.str();
+}
+
+void AssertSameOutput(const string& program, const string& expected) {
+    ASSERT_EQUAL(RunOnTree(program), expected);
+    ASSERT_EQUAL(RunOnVm(program), expected);
+}
+
+void TestArithmetics() {
+    AssertSameOutput("print 1+2+3+4+5, 1*2*3*4*5, 1-2-3-4-5, 36/4/3, 2*5+10/2, -3\n"s,
+                     "15 120 -13 3 15 -3\n"s);
+    AssertSameOutput("x = 'hello, '\ny = x + 'world'\nprint y, str(17) + str(True)\n"s,
+                     "hello, world 17True\n"s);
+}
+
+void TestLogic() {
+    const string program = R"(
+a = 1
+b = 2
+print a < b, a > b, a == b, a != b, a <= b, a >= b
+print a < b and b < a, a < b or b < a, not a, not None
+if a < b:
+  print 'less'
+else:
+  print 'not less'
+if a > b:
+  print 'greater'
+print None
+)"s;
+    AssertSameOutput(program,
+                     "True False False True True False\nFalse True False True\nless\nNone\n"s);
+}
+
+void TestShortCircuit() {
+    const string program = R"(
+class Probe:
+  def check(name, value):
+    print 'check', name
+    return value
+
+p = Probe()
+print p.check('a', 0) and p.check('b', 1)
+print p.check('c', 1) or p.check('d', 1)
+if p.check('e', 1) < 2 and not p.check('f', 0) or p.check('g', 1):
+  print 'then'
+if p.check('h', 0) or p.check('i', 1) == 2:
+  print 'wrong'
+else:
+  print 'else'
+)"s;
+    AssertSameOutput(program,
+                     "check a\nFalse\ncheck c\nTrue\ncheck e\ncheck f\nthen\ncheck h\ncheck i\nelse\n"s);
+}
+
+void TestPrint() {
+    // Аргументы print выводятся по мере вычисления, а строка с именем переменной
+    // выводится как её значение
+    const string program = R"(
+class Reporter:
+  def early(flag):
+    if flag:
+      return 'yes'
+    print 'not returned'
+    return 'no'
+
+  def show(n):
+    print 'n', 'm', n
+    m = 2
+    print 'm'
+
+r = Reporter()
+print r.early(1), r.early(0)
+print 'x'
+x = 'y'
+y = 5
+print 'x', x, 'z'
+r.show(1)
+)"s;
+    AssertSameOutput(program, "yes not returned\nno\nx\n5 5 z\n1 m 1\n2\n"s);
+}
+
+void TestClasses() {
+    const string program = R"(
+class Shape:
+  def __str__():
+    return 'Shape'
+
+  def area():
+    return 'Not implemented'
+
+class Rect(Shape):
+  def __init__(w, h):
+    self.w = w
+    self.h = h
+
+  def __str__():
+    return 'Rect(' + str(self.w) + 'x' + str(self.h) + ')'
+
+  def area():
+    return self.w * self.h
+
+  def __eq__(other):
+    return self.area() == other.area()
+
+class Holder:
+  def __init__(value):
+    self.value = value
+
+r = Rect(2, 3)
+h = Holder(r)
+s = Shape()
+print r, r.area(), s, s.area()
+print h.value.w, h.value.area()
+h.value.w = 10
+print r
+print r == Rect(6, 5)
+)"s;
+    AssertSameOutput(program, "Rect(2x3) 6 Shape Not implemented\n2 6\nRect(10x3)\nTrue\n"s);
+}
+
+void TestDeepInheritance() {
+    AssertSameOutput(R"(
+class A:
+  def name():
+    return 'A'
+
+  def greet():
+    return 'hello from ' + self.name()
+
+class B(A):
+  def other():
+    return 0
+
+class C(B):
+  def name():
+    return 'C'
+
+class D(C):
+  def other():
+    return 1
+
+a = A()
+d = D()
+print a.greet(), d.greet(), d.other()
+)"s,
+                     "hello from A hello from C 1\n"s);
+}
+
+void TestRecursion() {
+    const string program = R"(
+class GCD:
+  def __init__():
+    self.call_count = 0
+
+  def calc(a, b):
+    self.call_count = self.call_count + 1
+    if a < b:
+      return self.calc(b, a)
+    if b == 0:
+      return a
+    return self.calc(a - b, b)
+
+x = GCD()
+print x.calc(510510, 18629977)
+print x.calc(22, 17)
+print x.call_count
+)"s;
+    AssertSameOutput(program, "17\n1\n115\n"s);
+}
+
+void TestFreshInstances() {
+    // Каждое вычисление Point() создаёт новый объект
+    const string program = R"(
+class Point:
+  def __init__(x):
+    self.x = x
+
+class Factory:
+  def make(x):
+    return Point(x)
+
+f = Factory()
+a = f.make(1)
+b = f.make(2)
+print a.x, b.x
+)"s;
+    AssertSameOutput(program, "1 2\n"s);
+}
+
+void TestStoredSelf() {
+    // self, сохранённый в поле другого объекта, удерживает экземпляр после того,
+    // как исчезли остальные ссылки на него
+    const string back_reference = R"(
+class Holder:
+  def __init__():
+    self.n = None
+
+class Node:
+  def __init__(v):
+    self.v = v
+
+  def attach(holder):
+    holder.n = self
+
+h = Holder()
+t = Node(5)
+t.attach(h)
+t = None
+x = Node(6)
+print h.n.v
+)"s;
+    AssertSameOutput(back_reference, "5\n"s);
+
+    const string parent_child = R"(
+class Child:
+  def __init__(parent):
+    self.parent = parent
+
+class Parent:
+  def __init__(v):
+    self.v = v
+    self.child = Child(self)
+
+p = Parent(5)
+c = p.child
+p = None
+x = Parent(6)
+print c.parent.v
+)"s;
+    AssertSameOutput(parent_child, "5\n"s);
+}
+
+void TestStoredOperands() {
+    // Методы операторов получают self и второй операнд во владение и могут их сохранить
+    const string program = R"(
+class Box:
+  def __init__(v):
+    self.v = v
+
+  def __add__(other):
+    other.last = self
+    return 0
+
+class Sink:
+  def __init__():
+    self.last = None
+
+  def __eq__(other):
+    self.last = other
+    return True
+
+  def __lt__(other):
+    self.last = other
+    return False
+
+s = Sink()
+b = Box(5)
+z = b + s
+b = None
+y = Box(6)
+print s.last.v
+w = s == Box(7)
+y = Box(8)
+print s.last.v
+w = s < Box(9)
+y = Box(10)
+print s.last.v
+)"s;
+    AssertSameOutput(program, "5\n7\n9\n"s);
+}
+
+void TestRuntimeErrors() {
+    ASSERT_THROWS(RunOnVm("print 1 / 0\n"s), std::runtime_error);
+    ASSERT_THROWS(RunOnVm("print x\n"s), std::runtime_error);
+    ASSERT_THROWS(RunOnVm("print 1 + 'a'\n"s), std::runtime_error);
+}
+
+void TestDisassemble() {
+    istringstream is("x = x + 1\n"s);
+    parse::Lexer lexer(is);
+    auto compiled = bytecode::Compile(*ParseProgram(lexer));
+
+    ostringstream os;
+    bytecode::Disassemble(os, compiled.main);
+    ASSERT_EQUAL(os.str(),
+                 "   0 LoadLocalChecked x\n"
+                 "   1 LoadConst #0\n"
+                 "   2 Add\n"
+                 "   3 StoreLocal x\n"
+                 "   4 LoadNone\n"
+                 "   5 Return\n"s);
+    ASSERT_EQUAL(compiled.main.max_stack, 2U);
+
+    // Условие if переходит по результату сравнения, не создавая Bool
+    istringstream condition("if x < 1 and not y:\n  print x\n"s);
+    parse::Lexer condition_lexer(condition);
+    auto compiled_condition = bytecode::Compile(*ParseProgram(condition_lexer));
+    ostringstream condition_os;
+    bytecode::Disassemble(condition_os, compiled_condition.main);
+    ASSERT_EQUAL(condition_os.str(),
+                 "   0 LoadLocalChecked x\n"
+                 "   1 LoadConst #0\n"
+                 "   2 CompareJumpIfFalse Less -> 8\n"
+                 "   3 LoadLocalChecked y\n"
+                 "   4 JumpIfTrue -> 8\n"
+                 "   5 LoadLocalChecked x\n"
+                 "   6 Print 0\n"
+                 "   7 PrintNewline\n"
+                 "   8 LoadNone\n"
+                 "   9 Return\n"s);
+}
+
+void TestLocalSlots() {
+    const string program = R"(
+class Counter:
+  def count(n, flag):
+    if flag:
+      result = n + 1
+    else:
+      result = n - 1
+    return result
+
+  def broken(flag):
+    if flag:
+      value = 1
+    return value
+
+c = Counter()
+print c.count(1, True), c.count(1, False)
+print c.broken(True), c.broken(False)
+)"s;
+    // Чтение неприсвоенной переменной - ошибка, которую MethodCall превращает в None
+    AssertSameOutput(program, "2 0\n1 None\n"s);
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto compiled = bytecode::Compile(*ParseProgram(lexer));
+    const auto& counter = *compiled.classes.front().TryAs<runtime::Class>();
+    const auto* count = dynamic_cast<const Function*>(counter.GetMethod("count"s)->body.get());
+    const auto* broken = dynamic_cast<const Function*>(counter.GetMethod("broken"s)->body.get());
+    ASSERT(count != nullptr && broken != nullptr);
+    ASSERT_EQUAL(count->GetCode().locals, (vector<runtime::Symbol>{"self"s, "n"s, "flag"s, "result"s}));
+    ASSERT(count->GetCode().checked_locals.empty());
+    ASSERT_EQUAL(broken->GetCode().checked_locals.size(), 1U);
+}
+
+void TestClosureExchange() {
+    istringstream is("y = x + 1\n"s);
+    parse::Lexer lexer(is);
+    auto compiled = bytecode::Compile(*ParseProgram(lexer));
+
+    runtime::DummyContext context;
+    runtime::Closure closure{{"x"s, runtime::ObjectHolder::Own(runtime::Number(41))}};
+    Run(compiled, closure, context);
+    ASSERT_EQUAL(closure.size(), 2U);
+    ASSERT_EQUAL(closure.at("y"s).TryAs<runtime::Number>()->GetValue(), 42);
+
+    runtime::Closure empty;
+    ASSERT_THROWS(Run(compiled, empty, context), std::runtime_error);
+}
+
+void TestCallSiteCaches() {
+    const string program = R"(
+class A:
+  def f():
+    return 1
+
+class B(A):
+  def g():
+    return 2
+
+class Caller:
+  def call(x):
+    return x.f()
+
+  def twice(x):
+    return x.f() + x.f()
+
+c = Caller()
+a = A()
+b = B()
+print c.twice(a), c.twice(a), c.call(a), c.call(b), c.call(a)
+)"s;
+    AssertSameOutput(program, "2 2 1 1 1\n"s);
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    auto compiled = bytecode::Compile(*ParseProgram(lexer));
+    runtime::DummyContext context;
+    runtime::Closure closure;
+    ExecutionState state(compiled);
+    Run(compiled, closure, context, state);
+
+    const auto& caller = *compiled.classes.back().TryAs<runtime::Class>();
+    const auto& call_code = static_cast<const Function&>(*caller.GetMethod("call"s)->body).GetCode();
+    const auto& twice_code = static_cast<const Function&>(*caller.GetMethod("twice"s)->body).GetCode();
+    ASSERT(state.FindCaches(call_code) != nullptr);
+    ASSERT(state.FindCaches(twice_code) != nullptr);
+    const CodeCaches& call = *state.FindCaches(call_code);
+    const CodeCaches& twice = *state.FindCaches(twice_code);
+
+    // Каждое место вызова имеет свой кэш
+    ASSERT_EQUAL(call.method_caches.size(), 1U);
+    ASSERT_EQUAL(twice.method_caches.size(), 2U);
+    for (const runtime::MethodCache& cache : twice.method_caches) {
+        ASSERT_EQUAL(cache.GetEntryCount(), 1U);
+        ASSERT_EQUAL(cache.GetStats().monomorphic_hits, 1U);
+        ASSERT_EQUAL(cache.GetStats().misses, 1U);
+    }
+    const runtime::CallCacheStats& stats = call.method_caches.front().GetStats();
+    ASSERT_EQUAL(call.method_caches.front().GetEntryCount(), 2U);
+    ASSERT_EQUAL(stats.monomorphic_hits, 1U);
+    ASSERT_EQUAL(stats.misses, 2U);
+
+    ostringstream report;
+    PrintCallSiteStats(report, compiled, state);
+    ASSERT(report.str().find("Caller.call:1 f: polymorphic(2), hits 1"s) != string::npos);
+}
+
+void TestProgramCache() {
+    const string program = R"(
+class Base:
+  def __init__(name):
+    self.name = name
+
+  def __str__():
+    return 'Base ' + self.name
+
+class Derived(Base):
+  def tag():
+    return 'derived'
+
+class Factory:
+  def make(name, n):
+    if n > 0 and True:
+      return self.make(name + '!', n - 1)
+    return Derived(name)
+
+factory = Factory()
+d = factory.make('x', 3)
+print d, d.tag(), -7, None, False
+)"s;
+    const string expected = "Base x!!! derived -7 None False\n"s;
+    const bytecode::SourceStamp stamp{program.size(), 12345};
+
+    istringstream is(program);
+    parse::Lexer lexer(is);
+    ostringstream os;
+    bytecode::SaveProgram(os, bytecode::Compile(*ParseProgram(lexer)), stamp);
+    const string data = os.str();
+
+    {
+        const bytecode::Program loaded = bytecode::LoadProgram(data, stamp);
+        ASSERT_EQUAL(loaded.classes.size(), 3U);
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        Run(loaded, closure, context);
+        ASSERT_EQUAL(context.output.str(), expected);
+    }
+
+    // Кэш, полученный из другой версии файла, и обрезанный кэш не загружаются
+    ASSERT_THROWS(bytecode::LoadProgram(data, {stamp.size + 1, stamp.modified}), bytecode::CacheError);
+    for (size_t size = 0; size < data.size(); ++size) {
+        ASSERT_THROWS(bytecode::LoadProgram(string_view(data).substr(0, size), stamp), bytecode::CacheError);
+    }
+    string other_version = data;
+    other_version[8] = static_cast<char>(bytecode::CACHE_FORMAT_VERSION + 1);
+    ASSERT_THROWS(bytecode::LoadProgram(other_version, stamp), bytecode::CacheError);
+}
+
+void TestCorruptedProgramCache() {
+    const bytecode::SourceStamp stamp{1, 1};
+    auto compile = [](const string& program) {
+        istringstream is(program);
+        parse::Lexer lexer(is);
+        return bytecode::Compile(*ParseProgram(lexer));
+    };
+    auto save = [&stamp](const bytecode::Program& program) {
+        ostringstream os;
+        bytecode::SaveProgram(os, program, stamp);
+        return os.str();
+    };
+
+    // Инструкция, снимающая значение с пустого стека, не загружается
+    bytecode::Program print_one = compile("print 1\n"s);
+    ASSERT(print_one.main.instructions[0].op == bytecode::OpCode::LoadConst);
+    print_one.main.instructions[0].op = bytecode::OpCode::Pop;
+    ASSERT_THROWS(bytecode::LoadProgram(save(print_one), stamp), bytecode::CacheError);
+
+    // Любая замена кода операции либо отвергается при загрузке, либо даёт программу, которую
+    // машина выполняет без нарушения памяти. Рекурсии в программе нет, поэтому она завершается
+    bytecode::Program program = compile(R"(
+class Point:
+  def __init__(x, y):
+    self.x = x
+    self.y = y
+
+  def __str__():
+    return str(self.x) + ':' + str(self.y)
+
+  def sum():
+    return self.x + self.y
+
+p = Point(1, 2)
+q = Point(3, 4)
+if p.sum() < q.sum() and not p.x == 2 or q.y > 3:
+  print p, q.sum(), 'x'
+else:
+  print 'else', None, True
+p.x = q.y - 1
+print str(p), p.x * 2 / 1
+)"s);
+    size_t rejected = 0;
+    for (bytecode::Instruction& instr : program.main.instructions) {
+        const bytecode::OpCode original = instr.op;
+        for (int op = 0; op <= static_cast<int>(bytecode::OpCode::Return) + 1; ++op) {
+            instr.op = static_cast<bytecode::OpCode>(op);
+            const string data = save(program);
+            try {
+                const bytecode::Program loaded = bytecode::LoadProgram(data, stamp);
+                runtime::DummyContext context;
+                runtime::Closure closure;
+                Run(loaded, closure, context);
+            } catch (const bytecode::CacheError&) {
+                ++rejected;
+            } catch (const std::runtime_error&) {
+            }
+        }
+        instr.op = original;
+    }
+    ASSERT(rejected > 0);
+}
+
+void TestProgramCacheFile() {
+    const auto dir = std::filesystem::temp_directory_path() / "mython_cache_test"s;
+    std::filesystem::create_directories(dir);
+    const string source_path = (dir / "program.my"s).string();
+    const string cache_path = bytecode::GetCachePath(source_path);
+    std::filesystem::remove(cache_path);
+
+    auto compile = [&](const string& text) {
+        ofstream(source_path) << text;
+        istringstream is(text);
+        parse::Lexer lexer(is);
+        return bytecode::Compile(*ParseProgram(lexer));
+    };
+    auto run_cached = [&]() -> optional<string> {
+        auto loaded = bytecode::LoadCacheFile(cache_path, bytecode::GetSourceStamp(source_path));
+        if (!loaded) {
+            return nullopt;
+        }
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        Run(*loaded, closure, context);
+        return context.output.str();
+    };
+
+    const auto first = compile("print 'first'\n"s);
+    ASSERT(!run_cached());
+    ASSERT(bytecode::SaveCacheFile(cache_path, first, bytecode::GetSourceStamp(source_path)));
+    ASSERT_EQUAL(run_cached().value_or(""s), "first\n"s);
+
+    // После изменения программы кэш устаревает
+    compile("print 'second one'\n"s);
+    ASSERT(!run_cached());
+
+    std::filesystem::remove_all(dir);
+}
+
+void TestConcurrentRuns() {
+    // Поля добавляются в разном порядке, а вызовы проходят через одни и те же места вызова,
+    // поэтому потоки одновременно создают формы и заполняют кэши
+    const auto script = mython::Script::Compile(R"(
+class Point:
+  def __init__(x, y):
+    if x < y:
+      self.x = x
+      self.y = y
+    else:
+      self.y = y
+      self.x = x
+
+  def sum():
+    return self.x + self.y
+
+class Scaled(Point):
+  def sum():
+    return 10 * (self.x + self.y)
+
+class Runner:
+  def run(i, total):
+    if i == 200:
+      return total
+    if i / 2 * 2 == i:
+      p = Point(i, 3)
+    else:
+      p = Scaled(3, i)
+    return self.run(i + 1, total + p.sum())
+
+runner = Runner()
+total = runner.run(0, 0)
+print total
+)"sv);
+    string expected;
+    {
+        runtime::DummyContext context;
+        runtime::Closure closure;
+        script->Run(closure, context);
+        expected = context.output.str();
+    }
+    ASSERT_EQUAL(expected, "113200\n"s);
+
+    mython::ThreadPool pool(4);
+    ASSERT_EQUAL(pool.GetThreadCount(), 4U);
+    vector<future<mython::RunResult>> results;
+    for (int i = 0; i < 32; ++i) {
+        results.push_back(pool.Submit(script));
+    }
+    for (auto& result : results) {
+        mython::RunResult run = result.get();
+        ASSERT_EQUAL(run.output, expected);
+        ASSERT_EQUAL(run.globals.at("total"s).TryAs<runtime::Number>()->GetValue(), 113200);
+    }
+
+    // Ошибка выполнения передаётся через future
+    auto failing = pool.Submit(mython::Script::Compile("print 1 / 0\n"sv));
+    ASSERT_THROWS(failing.get(), std::runtime_error);
+}
+
+void TestConcurrentRunsReusePool() {
+    // Объекты создают рабочие потоки, а удаляет поток, получивший результат. Освобождённые
+    // блоки должны возвращаться рабочим потокам, иначе каждый запуск нарезал бы новые участки
+    const auto script = mython::Script::Compile(R"(
+class Item:
+  def __init__(value, next):
+    self.value = value
+    self.next = next
+
+a = Item(1, None)
+b = Item(2, a)
+c = Item(3, b)
+d = Item(4, c)
+e = Item(5, d)
+f = Item(6, e)
+g = Item(7, f)
+h = Item(8, g)
+)"sv);
+    mython::ThreadPool pool(2);
+    auto run_rounds = [&pool, &script](int count) {
+        for (int i = 0; i < count; ++i) {
+            vector<future<mython::RunResult>> results;
+            results.push_back(pool.Submit(script));
+            results.push_back(pool.Submit(script));
+            for (auto& result : results) {
+                result.get();
+            }
+        }
+    };
+    run_rounds(500);
+    const size_t chunk_count = runtime::Pool::GetChunkCount();
+    run_rounds(2000);
+    ASSERT(runtime::Pool::GetChunkCount() <= chunk_count + 4);
+}
+
+}  // namespace
+
+void RunVmTests(TestRunner& tr) {
+    RUN_TEST(tr, vm::TestArithmetics);
+    RUN_TEST(tr, vm::TestLogic);
+    RUN_TEST(tr, vm::TestShortCircuit);
+    RUN_TEST(tr, vm::TestPrint);
+    RUN_TEST(tr, vm::TestClasses);
+    RUN_TEST(tr, vm::TestDeepInheritance);
+    RUN_TEST(tr, vm::TestRecursion);
+    RUN_TEST(tr, vm::TestFreshInstances);
+    RUN_TEST(tr, vm::TestStoredSelf);
+    RUN_TEST(tr, vm::TestStoredOperands);
+    RUN_TEST(tr, vm::TestRuntimeErrors);
+    RUN_TEST(tr, vm::TestDisassemble);
+    RUN_TEST(tr, vm::TestLocalSlots);
+    RUN_TEST(tr, vm::TestClosureExchange);
+    RUN_TEST(tr, vm::TestCallSiteCaches);
+    RUN_TEST(tr, vm::TestProgramCache);
+    RUN_TEST(tr, vm::TestCorruptedProgramCache);
+    RUN_TEST(tr, vm::TestProgramCacheFile);
+    RUN_TEST(tr, vm::TestConcurrentRuns);
+    RUN_TEST(tr, vm::TestConcurrentRunsReusePool);
+}
+
+}  // namespace vm